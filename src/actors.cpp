@@ -0,0 +1,265 @@
+#include "pch.h"
+
+ActorSet actors;
+
+// Actors per job. Large enough that a job amortizes its batch trace, small
+// enough that a few thousand actors still spread over every core.
+static const int ACTOR_GRAIN = 256;
+static const int MAX_TICKS_PER_FRAME = 4;
+
+static_assert(ACTOR_HUNT_STEPS <= FLOW_MAX_STEPS, "actors hunt farther than the flow field reaches");
+
+static float tickAccumulator = 0.0f;
+
+static inline uint32_t next_random(uint32_t& s)
+{
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+static inline float random_unit(uint32_t& s)
+{
+    return (next_random(s) >> 8) * (1.0f / 16777216.0f);
+}
+
+void clear_actors()
+{
+    actors = ActorSet();
+    tickAccumulator = 0.0f;
+}
+
+int spawn_actor(float x, float y)
+{
+    ActorSet& a = actors;
+    int index = a.count++;
+    uint32_t seed = (uint32_t)(index + 1) * 2654435761u;
+    if (!seed)
+        seed = 1;
+
+    a.x.push_back(x);
+    a.y.push_back(y);
+    a.headX.push_back(1.0f);
+    a.headY.push_back(0.0f);
+    a.turnTime.push_back(0.0f);
+    a.seed.push_back(seed);
+    a.mode.push_back(ACTOR_WANDER);
+    a.fireTime.push_back(ACTOR_FIRE_INTERVAL);
+    a.fire.push_back(0);
+
+    a.sightRays.resize(a.count);
+    a.sightHits.resize(a.count);
+    a.sightActor.resize(a.count);
+    return index;
+}
+
+// Moves the last actor into the freed slot.
+void remove_actor(int index)
+{
+    ActorSet& a = actors;
+    if (index < 0 || index >= a.count)
+        return;
+
+    int last = --a.count;
+    a.x[index] = a.x[last];
+    a.y[index] = a.y[last];
+    a.headX[index] = a.headX[last];
+    a.headY[index] = a.headY[last];
+    a.turnTime[index] = a.turnTime[last];
+    a.seed[index] = a.seed[last];
+    a.mode[index] = a.mode[last];
+    a.fireTime[index] = a.fireTime[last];
+    a.fire[index] = a.fire[last];
+
+    a.x.pop_back();
+    a.y.pop_back();
+    a.headX.pop_back();
+    a.headY.pop_back();
+    a.turnTime.pop_back();
+    a.seed.pop_back();
+    a.mode.pop_back();
+    a.fireTime.pop_back();
+    a.fire.pop_back();
+    a.sightRays.pop_back();
+    a.sightHits.pop_back();
+    a.sightActor.pop_back();
+}
+
+struct ActorTick {
+    float dt;
+    float playerX, playerY;
+};
+
+// Updates the actors at positions [begin, end) of the tick's order. Reads
+// only the map, the flow field, the player, the spatial grid filled before
+// the tick and the actors' own slots, so any split of the range gives the
+// same result.
+static void update_actor_range(int begin, int end, void* ctx)
+{
+    const ActorTick& t = *(const ActorTick*)ctx;
+    ActorSet& a = actors;
+
+    // Sight lines run from the player out to each actor in range. Sharing the
+    // origin lets neighbouring rays go down the packet path together.
+    Ray* rays = &a.sightRays[begin];
+    int* rayActor = &a.sightActor[begin];
+    int rayCount = 0;
+    for (int n = begin; n < end; n++) {
+        int i = a.order[n];
+        float dx = a.x[i] - t.playerX;
+        float dy = a.y[i] - t.playerY;
+        float distSq = dx * dx + dy * dy;
+        if (distSq > ACTOR_SIGHT * ACTOR_SIGHT || distSq == 0.0f)
+            continue;
+
+        float dist = sqrtf(distSq);
+        rays[rayCount] = { t.playerX, t.playerY, dx / dist, dy / dist, dist };
+        rayActor[rayCount] = i;
+        rayCount++;
+    }
+    RayHit* hits = &a.sightHits[begin];
+    trace_rays(rays, rayCount, RAY_STOP_WALLS, hits);
+
+    int next = 0;
+    for (int n = begin; n < end; n++) {
+        int i = a.order[n];
+        int sees = 0;
+        if (next < rayCount && rayActor[next] == i) {
+            sees = !hits[next].hit;
+            next++;
+        }
+
+        // Firing spawns into the shared projectile pool, so it is only
+        // flagged here and done after the parallel part.
+        a.fireTime[i] -= t.dt;
+        a.fire[i] = 0;
+        if (sees && a.fireTime[i] <= 0.0f) {
+            a.fire[i] = 1;
+            a.fireTime[i] = ACTOR_FIRE_INTERVAL * (0.5f + random_unit(a.seed[i]));
+        }
+
+        float step = ACTOR_SPEED * t.dt;
+        if (sees) {
+            float dx = t.playerX - a.x[i];
+            float dy = t.playerY - a.y[i];
+            float dist = sqrtf(dx * dx + dy * dy);
+            a.mode[i] = ACTOR_CHASE;
+            a.headX[i] = dx / dist;
+            a.headY[i] = dy / dist;
+            if (dist - step < ACTOR_REACH)
+                step = std::max(0.0f, dist - ACTOR_REACH);
+        }
+        else {
+            // Out of sight but close by path: follow the flow field toward the
+            // player, aiming for the centre of the next cell.
+            int cell = (int)a.y[i] * MAP_SIZE + (int)a.x[i];
+            int nextCell;
+            if (flow_distance(cell) <= ACTOR_HUNT_STEPS && flow_next(cell, &nextCell)) {
+                float dx = nextCell % MAP_SIZE + 0.5f - a.x[i];
+                float dy = nextCell / MAP_SIZE + 0.5f - a.y[i];
+                float dist = sqrtf(dx * dx + dy * dy);
+                a.mode[i] = ACTOR_HUNT;
+                if (dist > 0.0f) {
+                    a.headX[i] = dx / dist;
+                    a.headY[i] = dy / dist;
+                }
+            }
+            else {
+                a.mode[i] = ACTOR_WANDER;
+                a.turnTime[i] -= t.dt;
+                if (a.turnTime[i] <= 0.0f) {
+                    float angle = random_unit(a.seed[i]) * 2.0f * (float)M_PI;
+                    a.headX[i] = cosf(angle);
+                    a.headY[i] = sinf(angle);
+                    a.turnTime[i] = 1.0f + 2.0f * random_unit(a.seed[i]);
+                }
+            }
+        }
+
+        // Overlapping actors push each other apart. Their positions come
+        // from the grid, which was filled before the tick started. Centres
+        // closer than two radii overlap, so only the buckets that near are
+        // walked, one row run at a time, and only actors are looked at.
+        float pushX = 0.0f, pushY = 0.0f;
+        const float reach = 2.0f * ACTOR_RADIUS;
+        float x = a.x[i], y = a.y[i];
+        int x0 = std::max(0, (int)(x - reach)), x1 = std::min(MAP_SIZE - 1, (int)(x + reach));
+        int y0 = std::max(0, (int)(y - reach)), y1 = std::min(MAP_SIZE - 1, (int)(y + reach));
+        const int* cellStart = spatial.cellStart.data();
+        const SpatialEntry* entries = spatial.entries.data();
+        int found = 0;
+        for (int cy = y0; cy <= y1 && found < ACTOR_MAX_NEIGHBOURS; cy++) {
+            int first = cellStart[cy * MAP_SIZE + x0];
+            int last = cellStart[cy * MAP_SIZE + x1 + 1];
+            for (int k = first; k < last && found < ACTOR_MAX_NEIGHBOURS; k++) {
+                const SpatialEntry& e = entries[k];
+                float dx = x - e.x;
+                float dy = y - e.y;
+                float distSq = dx * dx + dy * dy;
+                if (distSq > reach * reach || e.kind != SPATIAL_ACTOR)
+                    continue;
+                found++;
+                if (e.id == i)
+                    continue;
+
+                float dist = sqrtf(distSq);
+                float overlap = reach - dist;
+                if (dist < 1e-4f) {
+                    // Exactly on top of each other: split along x by index.
+                    dx = (i < e.id) ? -1.0f : 1.0f;
+                    dy = 0.0f;
+                    dist = 1.0f;
+                }
+                pushX += dx / dist * overlap * 0.5f;
+                pushY += dy / dist * overlap * 0.5f;
+            }
+        }
+
+        int blocked = move_circle(&a.x[i], &a.y[i], a.headX[i] * step + pushX, a.headY[i] * step + pushY,
+                                  ACTOR_RADIUS, actor_blocks);
+        if (blocked && a.mode[i] == ACTOR_WANDER)
+            a.turnTime[i] = 0.0f;
+    }
+}
+
+void update_actors(float dt)
+{
+    update_flow_target(state.pos.x, state.pos.y);
+    rebuild_spatial();
+
+    ActorSet& a = actors;
+    a.order.clear();
+    for (const SpatialEntry& e : spatial.entries) {
+        if (e.kind == SPATIAL_ACTOR)
+            a.order.push_back(e.id);
+    }
+
+    ActorTick t = { dt, state.pos.x, state.pos.y };
+    parallel_for(actors.count, ACTOR_GRAIN, update_actor_range, &t);
+
+    for (int i = 0; i < a.count; i++) {
+        if (a.fire[i]) {
+            float dx = t.playerX - a.x[i];
+            float dy = t.playerY - a.y[i];
+            float dist = sqrtf(dx * dx + dy * dy);
+            if (dist > 0.0f)
+                spawn_projectile(PROJECTILE_BOLT, a.x[i] + dx / dist * ACTOR_RADIUS, a.y[i] + dy / dist * ACTOR_RADIUS,
+                                 dx / dist, dy / dist);
+        }
+    }
+}
+
+void tick_actors(float frameTime)
+{
+    tickAccumulator += frameTime;
+    int ticks = 0;
+    while (tickAccumulator >= ACTOR_TICK && ticks < MAX_TICKS_PER_FRAME) {
+        update_actors(ACTOR_TICK);
+        tickAccumulator -= ACTOR_TICK;
+        ticks++;
+    }
+    // Drop time we could not catch up on instead of spiralling.
+    if (ticks == MAX_TICKS_PER_FRAME)
+        tickAccumulator = 0.0f;
+}
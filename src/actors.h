@@ -0,0 +1,69 @@
+#ifndef ACTORS_H
+#define ACTORS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "raycast.h"
+
+// The simulation advances in fixed ticks, independent of the frame rate.
+constexpr int ACTOR_TICK_RATE = 30;
+constexpr float ACTOR_TICK = 1.0f / ACTOR_TICK_RATE;
+// Wall-clock time one tick of 5,000 actors may take (checked by --bench actors).
+constexpr float ACTOR_TICK_BUDGET_MS = 2.0f;
+
+constexpr float ACTOR_SIGHT = 12.0f;
+constexpr float ACTOR_SPEED = 2.0f;
+constexpr float ACTOR_RADIUS = 0.25f;
+// Chasing actors stop this close to the player.
+constexpr float ACTOR_REACH = 0.8f;
+// Chasing actors fire a bolt at the player about this often.
+constexpr float ACTOR_FIRE_INTERVAL = 2.5f;
+// Neighbours considered when pushing overlapping actors apart.
+constexpr int ACTOR_MAX_NEIGHBOURS = 16;
+// Actors this many steps or fewer from the player track it by path when it
+// is out of sight.
+constexpr int ACTOR_HUNT_STEPS = 40;
+
+enum ActorMode {
+    ACTOR_WANDER,
+    ACTOR_CHASE,
+    ACTOR_HUNT
+};
+
+// Structure-of-arrays actor state: index i of every array is actor i.
+struct ActorSet {
+    int count = 0;
+    std::vector<float> x, y;
+    std::vector<float> headX, headY;
+    // Seconds until a wandering actor picks a new heading.
+    std::vector<float> turnTime;
+    std::vector<uint32_t> seed;
+    std::vector<uint8_t> mode;
+    // Seconds until the actor may fire again, and whether it fires this tick.
+    std::vector<float> fireTime;
+    std::vector<uint8_t> fire;
+
+    // Per-tick line-of-sight scratch. Each job fills the slots of its own
+    // index range, so no two threads share an entry.
+    std::vector<Ray> sightRays;
+    std::vector<RayHit> sightHits;
+    std::vector<int> sightActor;
+    // Actor indices in the order of the grid's buckets, refilled every tick.
+    // Jobs walk the actors in this order, so consecutive actors read the same
+    // grid buckets, map cells and flow field entries.
+    std::vector<int> order;
+};
+
+extern ActorSet actors;
+
+void clear_actors();
+int spawn_actor(float x, float y);
+void remove_actor(int index);
+
+// Runs one simulation tick over every actor, split across the job pool.
+void update_actors(float dt);
+// Runs as many fixed ticks as frameTime covers (at most a few per frame).
+void tick_actors(float frameTime);
+
+#endif
\ No newline at end of file
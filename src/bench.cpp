@@ -0,0 +1,1652 @@
+#include "pch.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+#include "stb_image.h"
+
+struct CameraPose {
+    v3 pos, dir, plane;
+};
+
+static double now_ms()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Time the calling thread spent running. A single frame's wall time on a
+// shared machine swings by milliseconds from preemption alone.
+static double thread_cpu_ms()
+{
+#ifdef _WIN32
+    return now_ms();
+#else
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+#endif
+}
+
+static void set_pose(const CameraPose& pose)
+{
+    state.pos = pose.pos;
+    state.dir = pose.dir;
+    state.plane = pose.plane;
+}
+
+// Every open cell of the loaded map, looking in eight directions.
+static std::vector<CameraPose> collect_poses()
+{
+    std::vector<CameraPose> poses;
+    for (int y = 0; y < MAP_SIZE; y++) {
+        for (int x = 0; x < MAP_SIZE; x++) {
+            if (check_collision(x + 0.5f, y + 0.5f))
+                continue;
+
+            for (int a = 0; a < 8; a++) {
+                float angle = a * (float)M_PI_4 + 0.1f;
+                float dx = cosf(angle), dy = sinf(angle);
+                poses.push_back({ { x + 0.37f, y + 0.61f, 0 }, { dx, dy, 0 }, { -dy * 0.66f, dx * 0.66f, 0 } });
+            }
+        }
+    }
+    return poses;
+}
+
+static int same_hit(const WallHit& a, const WallHit& b)
+{
+    if (a.hit != b.hit)
+        return 0;
+    if (!a.hit)
+        return 1;
+    return a.mapX == b.mapX && a.mapY == b.mapY && a.side == b.side && a.perpWallDist == b.perpWallDist;
+}
+
+static CameraTable benchCamera;
+
+static double time_cast(const std::vector<CameraPose>& poses, int width, WallHit* hits, int usePacket, int useFixed,
+                        int reps)
+{
+    double start = now_ms();
+    for (int r = 0; r < reps; r++) {
+        for (const CameraPose& pose : poses) {
+            set_pose(pose);
+            setup_camera_table(benchCamera, width, width * 10 / 16);
+            cast_walls(benchCamera, hits, usePacket, useFixed);
+        }
+    }
+    return (now_ms() - start) / (reps * poses.size());
+}
+
+static int bench_raycast()
+{
+    const int widths[] = { 320, 640, 1280 };
+    std::vector<CameraPose> poses = collect_poses();
+    if (poses.empty()) {
+        std::cerr << "bench raycast: map has no open cells" << std::endl;
+        return 0;
+    }
+
+    CameraPose saved = { state.pos, state.dir, state.plane };
+    int ok = 1;
+
+    printf("raycast: %d poses, scalar DDA vs %d-ray packets (ms per frame)\n", (int)poses.size(), RAY_PACKET);
+    printf("%8s %10s %10s %8s %10s\n", "width", "scalar", "packet", "speedup", "mismatch");
+
+    for (int width : widths) {
+        std::vector<WallHit> scalar(width), packet(width);
+
+        int mismatches = 0;
+        for (const CameraPose& pose : poses) {
+            set_pose(pose);
+            setup_camera_table(benchCamera, width, width * 10 / 16);
+            cast_walls(benchCamera, scalar.data(), 0, 0);
+            cast_walls(benchCamera, packet.data(), 1, 0);
+            for (int x = 0; x < width; x++) {
+                if (!same_hit(scalar[x], packet[x]))
+                    mismatches++;
+            }
+        }
+
+        int reps = std::max(1, 20 * 320 / width);
+        double scalarMs = time_cast(poses, width, scalar.data(), 0, 0, reps);
+        double packetMs = time_cast(poses, width, packet.data(), 1, 0, reps);
+
+        printf("%8d %10.4f %10.4f %7.2fx %10d\n", width, scalarMs, packetMs, scalarMs / packetMs, mismatches);
+        if (mismatches)
+            ok = 0;
+    }
+
+    set_pose(saved);
+    return ok;
+}
+
+// Whether a ray from the camera position passes within eps of a grid corner
+// before maxDist. Which of the two cells at a corner the DDA steps into is
+// down to rounding there, in the float cast as much as the fixed one.
+static int grazes_corner(float rayDirX, float rayDirY, float maxDist, float eps)
+{
+    for (int axis = 0; axis < 2; axis++) {
+        float pos = axis ? state.pos.y : state.pos.x;
+        float dir = axis ? rayDirY : rayDirX;
+        float otherPos = axis ? state.pos.x : state.pos.y;
+        float otherDir = axis ? rayDirX : rayDirY;
+        if (dir == 0.0f)
+            continue;
+
+        int step = dir < 0 ? -1 : 1;
+        for (int line = (int)pos + (dir > 0); ; line += step) {
+            float t = (line - pos) / dir;
+            if (t > maxDist)
+                break;
+            float other = otherPos + t * otherDir;
+            if (fabsf(other - roundf(other)) < eps)
+                return 1;
+        }
+    }
+    return 0;
+}
+
+static int same_fixed_hit(const WallHit& a, const WallHit& b)
+{
+    return a.hit == b.hit && a.mapX == b.mapX && a.mapY == b.mapY && a.side == b.side &&
+           a.perpWallDistFixed == b.perpWallDistFixed;
+}
+
+// The 16.16 cast against the float one: the same cells and sides apart from
+// rays that graze a grid corner, and distances within the rounding of the
+// fixed ray directions.
+static int bench_fixed()
+{
+    const int widths[] = { 320, 640, 1280 };
+    std::vector<CameraPose> poses = collect_poses();
+    if (poses.empty()) {
+        std::cerr << "bench fixed: map has no open cells" << std::endl;
+        return 0;
+    }
+
+    CameraPose saved = { state.pos, state.dir, state.plane };
+    int ok = 1;
+
+    printf("fixed: %d poses, float vs 16.16 DDA (ms per frame)\n", (int)poses.size());
+    printf("%8s %10s %10s %10s %10s %10s %10s %10s %10s\n", "width", "float", "fixed", "fpacket", "fixpacket", "cells",
+           "corner", "packet", "maxerr");
+
+    for (int width : widths) {
+        std::vector<WallHit> reference(width), fixed(width), packet(width);
+
+        int cellMismatches = 0, cornerMismatches = 0, packetMismatches = 0;
+        float maxError = 0.0f;
+        for (const CameraPose& pose : poses) {
+            set_pose(pose);
+            setup_camera_table(benchCamera, width, width * 10 / 16);
+            cast_walls(benchCamera, reference.data(), 0, 0);
+            cast_walls(benchCamera, fixed.data(), 0, 1);
+            cast_walls(benchCamera, packet.data(), 1, 1);
+            for (int x = 0; x < width; x++) {
+                const WallHit& a = reference[x];
+                const WallHit& b = fixed[x];
+                packetMismatches += !same_fixed_hit(b, packet[x]);
+                if (a.hit != b.hit || a.mapX != b.mapX || a.mapY != b.mapY || a.side != b.side) {
+                    float reach = std::max(a.hit ? a.perpWallDist : 1e30f, b.hit ? b.perpWallDist : 1e30f);
+                    if (grazes_corner(a.rayDirX, a.rayDirY, std::min(reach, 2.0f * MAP_SIZE), 1e-3f))
+                        cornerMismatches++;
+                    else
+                        cellMismatches++;
+                    continue;
+                }
+                if (a.hit)
+                    maxError = std::max(maxError, fabsf(a.perpWallDist - b.perpWallDist) / a.perpWallDist);
+            }
+        }
+
+        int reps = std::max(1, 20 * 320 / width);
+        double ms[4];
+        for (int mode = 0; mode < 4; mode++)
+            ms[mode] = time_cast(poses, width, fixed.data(), mode & 1, mode >> 1, reps);
+
+        printf("%8d %10.4f %10.4f %10.4f %10.4f %10d %10d %10d %9.5f%%\n", width, ms[0], ms[2], ms[1], ms[3],
+               cellMismatches, cornerMismatches, packetMismatches, 100.0f * maxError);
+        if (cellMismatches || packetMismatches)
+            ok = 0;
+    }
+
+    set_pose(saved);
+    return ok;
+}
+
+static int same_ray_hit(const RayHit& a, const RayHit& b)
+{
+    return a.hit == b.hit && a.cellX == b.cellX && a.cellY == b.cellY && a.side == b.side
+        && a.distance == b.distance && a.tile == b.tile && a.entity == b.entity;
+}
+
+// Hitscan queries from every open cell: one batched trace_rays() call against
+// the same rays traced one at a time.
+static int bench_hitscan()
+{
+    std::vector<CameraPose> poses = collect_poses();
+    std::vector<Ray> rays;
+    for (const CameraPose& pose : poses) {
+        // A tight spread along the pose direction (a shotgun blast) followed
+        // by four rays in unrelated directions.
+        float base = atan2f(pose.dir.y, pose.dir.x);
+        for (int i = 0; i < 8; i++) {
+            float angle = (i < 4) ? base + (i - 1.5f) * 0.05f : base + i * 1.7f;
+            rays.push_back({ pose.pos.x, pose.pos.y, cosf(angle), sinf(angle), (i & 1) ? 1e30f : 4.0f });
+        }
+    }
+
+    std::vector<RayHit> batched(rays.size()), single(rays.size());
+    const int stopMask = RAY_STOP_WALLS | RAY_STOP_OBJECTS;
+    const int reps = 50;
+
+    double start = now_ms();
+    for (int r = 0; r < reps; r++) {
+        for (size_t i = 0; i < rays.size(); i++)
+            trace_rays(&rays[i], 1, stopMask, &single[i]);
+    }
+    double singleMs = (now_ms() - start) / reps;
+
+    start = now_ms();
+    for (int r = 0; r < reps; r++)
+        trace_rays(rays.data(), (int)rays.size(), stopMask, batched.data());
+    double batchedMs = (now_ms() - start) / reps;
+
+    int mismatches = 0;
+    for (size_t i = 0; i < rays.size(); i++) {
+        if (!same_ray_hit(single[i], batched[i]))
+            mismatches++;
+    }
+
+    printf("hitscan: %d rays, one at a time %.4f ms, batched %.4f ms (%.2fx), %d mismatches\n",
+           (int)rays.size(), singleMs, batchedMs, singleMs / batchedMs, mismatches);
+    return mismatches == 0;
+}
+
+// Replaces the loaded map with copies x copies tiles of it. Each copy keeps
+// its border wall; wherever open cells of two neighbouring copies face each
+// other across the double wall, a doorway is cut so the whole map connects.
+static void build_tiled_map(const std::vector<uint8_t>& src, int srcSize, int copies)
+{
+    int size = srcSize * copies;
+    delete[] MAPDATA;
+    MAP_SIZE = size;
+    MAPDATA = new uint8_t[size * size];
+
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++)
+            MAPDATA[y * size + x] = src[(y % srcSize) * srcSize + (x % srcSize)];
+    }
+
+    auto open = [&](int x, int y) { return !check_collision(x + 0.5f, y + 0.5f); };
+    for (int c = 1; c < copies; c++) {
+        int edge = c * srcSize;
+        for (int i = 0; i < size; i++) {
+            if (open(edge - 2, i) && open(edge + 1, i)) {
+                MAPDATA[i * size + edge - 1] = 0;
+                MAPDATA[i * size + edge] = 0;
+            }
+            if (open(i, edge - 2) && open(i, edge + 1)) {
+                MAPDATA[(edge - 1) * size + i] = 0;
+                MAPDATA[edge * size + i] = 0;
+            }
+        }
+    }
+}
+
+static void restore_map(const std::vector<uint8_t>& src, int srcSize)
+{
+    delete[] MAPDATA;
+    MAP_SIZE = srcSize;
+    MAPDATA = new uint8_t[srcSize * srcSize];
+    memcpy(MAPDATA, src.data(), src.size());
+}
+
+static uint64_t actor_checksum()
+{
+    uint64_t h = 1469598103934665603ull;
+    for (int i = 0; i < actors.count; i++) {
+        uint32_t bits[2];
+        memcpy(&bits[0], &actors.x[i], 4);
+        memcpy(&bits[1], &actors.y[i], 4);
+        h = (h ^ bits[0]) * 1099511628211ull;
+        h = (h ^ bits[1]) * 1099511628211ull;
+    }
+    return h;
+}
+
+// 5,000 actors on the demo map tiled 4x4, ticked with 1, 2, 4, ... threads.
+// Every thread count must end in exactly the same state, within the tick
+// budget.
+static int bench_actors()
+{
+    const int copies = 4;
+    const int actorCount = 5000;
+    const int ticks = 150;
+
+    int srcSize = MAP_SIZE;
+    std::vector<uint8_t> src(MAPDATA, MAPDATA + srcSize * srcSize);
+    v3 savedPos = state.pos;
+    build_tiled_map(src, srcSize, copies);
+
+    std::vector<int> openCells;
+    for (int i = 0; i < MAP_SIZE * MAP_SIZE; i++) {
+        if (!check_collision(i % MAP_SIZE + 0.5f, i / MAP_SIZE + 0.5f))
+            openCells.push_back(i);
+    }
+
+    // The player stands at the spawn point of one of the middle copies.
+    state.pos.x += srcSize;
+    state.pos.y += srcSize;
+
+    clear_actors();
+    clear_projectiles();
+    uint32_t rng = 12345;
+    for (int i = 0; i < actorCount; i++) {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        int cell = openCells[rng % openCells.size()];
+        spawn_actor(cell % MAP_SIZE + 0.5f, cell / MAP_SIZE + 0.5f);
+    }
+    ActorSet start = actors;
+
+    int hardware = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<int> threadCounts;
+    for (int n = 1; n < hardware; n *= 2)
+        threadCounts.push_back(n);
+    threadCounts.push_back(hardware);
+
+    printf("actors: %d actors on a %dx%d map, %d ticks, budget %.2f ms per tick\n",
+           actorCount, MAP_SIZE, MAP_SIZE, ticks, ACTOR_TICK_BUDGET_MS);
+    printf("%8s %10s %8s %8s %10s\n", "threads", "ms/tick", "speedup", "chasing", "state");
+
+    int ok = 1;
+    uint64_t reference = 0;
+    double singleMs = 0.0;
+    for (int threads : threadCounts) {
+        if (!jobs_init(threads)) {
+            ok = 0;
+            break;
+        }
+        actors = start;
+
+        double begin = now_ms();
+        for (int t = 0; t < ticks; t++)
+            update_actors(ACTOR_TICK);
+        double ms = (now_ms() - begin) / ticks;
+
+        int chasing = 0;
+        for (int i = 0; i < actors.count; i++)
+            chasing += actors.mode[i] == ACTOR_CHASE;
+
+        uint64_t sum = actor_checksum();
+        if (threads == 1) {
+            reference = sum;
+            singleMs = ms;
+        }
+        int same = sum == reference;
+        if (!same || ms > ACTOR_TICK_BUDGET_MS)
+            ok = 0;
+
+        printf("%8d %10.4f %7.2fx %8d %10s%s\n", threads, ms, singleMs / ms, chasing,
+               same ? "same" : "DIFFERENT", ms > ACTOR_TICK_BUDGET_MS ? "  over budget" : "");
+    }
+
+    jobs_init(0);
+    clear_actors();
+    clear_projectiles();
+    restore_map(src, srcSize);
+    state.pos = savedPos;
+    return ok;
+}
+
+static int flow_matches_rebuild()
+{
+    std::vector<int> dist = flowField.dist;
+    std::vector<int8_t> next = flowField.next;
+    build_flow_field(flowField.target);
+    return dist == flowField.dist && next == flowField.next;
+}
+
+// Full rebuild against following the player into another cell and the
+// incremental repair after a tile changes, over the demo map tiled up to
+// 16x16. Every updated field must equal a from-scratch build.
+static int bench_flowfield()
+{
+    const int copyCounts[] = { 1, 2, 4, 8, 16 };
+
+    int srcSize = MAP_SIZE;
+    std::vector<uint8_t> src(MAPDATA, MAPDATA + srcSize * srcSize);
+    int ok = 1;
+
+    printf("flowfield: rebuild vs incremental update (ms)\n");
+    printf("%8s %10s %12s %12s %12s %10s\n", "size", "rebuild", "move target", "destroy", "place wall", "mismatch");
+
+    for (int copies : copyCounts) {
+        build_tiled_map(src, srcSize, copies);
+        int target = (int)state.pos.y * MAP_SIZE + (int)state.pos.x;
+
+        int reps = std::max(1, 256 / (copies * copies));
+        double start = now_ms();
+        for (int r = 0; r < reps; r++)
+            build_flow_field(target);
+        double rebuildMs = (now_ms() - start) / reps;
+
+        std::vector<int> objects, open;
+        for (int i = 0; i < MAP_SIZE * MAP_SIZE; i++) {
+            if (MAPDATA[i] == 2)
+                objects.push_back(i);
+            else if (i != target && nav_open(i % MAP_SIZE, i / MAP_SIZE) && (i * 7919) % 97 == 0)
+                open.push_back(i);
+        }
+
+        // The player crossing into another cell, one of the open cells each
+        // time, and back.
+        int mismatches = 0;
+        double moveMs = 0.0;
+        for (int cell : open) {
+            start = now_ms();
+            update_flow_target(cell % MAP_SIZE + 0.5f, cell / MAP_SIZE + 0.5f);
+            moveMs += now_ms() - start;
+            mismatches += !flow_matches_rebuild();
+        }
+        update_flow_target(target % MAP_SIZE + 0.5f, target / MAP_SIZE + 0.5f);
+        mismatches += !flow_matches_rebuild();
+
+        // Shooting an object opens its cell; putting it back closes it again.
+        double destroyMs = 0.0;
+        for (int cell : objects) {
+            MAPDATA[cell] = 0;
+            start = now_ms();
+            flow_field_cell_changed(cell);
+            destroyMs += now_ms() - start;
+            mismatches += !flow_matches_rebuild();
+
+            MAPDATA[cell] = 2;
+            flow_field_cell_changed(cell);
+            mismatches += !flow_matches_rebuild();
+        }
+
+        // Walls placed on open floor, the case that has to raise distances.
+        double wallMs = 0.0;
+        for (int cell : open) {
+            MAPDATA[cell] = 1;
+            start = now_ms();
+            flow_field_cell_changed(cell);
+            wallMs += now_ms() - start;
+            mismatches += !flow_matches_rebuild();
+
+            MAPDATA[cell] = 0;
+            flow_field_cell_changed(cell);
+            mismatches += !flow_matches_rebuild();
+        }
+
+        printf("%8d %10.4f %12.5f %12.5f %12.5f %10d\n", MAP_SIZE, rebuildMs,
+               open.empty() ? 0.0 : moveMs / open.size(),
+               objects.empty() ? 0.0 : destroyMs / objects.size(),
+               open.empty() ? 0.0 : wallMs / open.size(), mismatches);
+        if (mismatches)
+            ok = 0;
+    }
+
+    restore_map(src, srcSize);
+    build_flow_field((int)state.pos.y * MAP_SIZE + (int)state.pos.x);
+    return ok;
+}
+
+// Radius and segment queries through the grid against a linear scan of the
+// same objects, for growing object counts on the 64x64 tiled map.
+static int bench_spatial()
+{
+    const int counts[] = { 1000, 5000, 20000 };
+    const int queries = 2000;
+    const float radius = 1.5f;
+
+    int srcSize = MAP_SIZE;
+    std::vector<uint8_t> src(MAPDATA, MAPDATA + srcSize * srcSize);
+    build_tiled_map(src, srcSize, 4);
+
+    printf("spatial: %d radius (r=%.1f) and %d segment queries (us per query)\n", queries, radius, queries);
+    printf("%8s %10s %10s %10s %10s %10s\n", "objects", "radius", "linear", "segment", "linear", "mismatch");
+
+    int ok = 1;
+    for (int count : counts) {
+        uint32_t rng = 777;
+        auto next = [&]() {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            return (rng >> 8) * (1.0f / 16777216.0f);
+        };
+
+        spatial_begin();
+        for (int i = 0; i < count; i++)
+            spatial_insert(SPATIAL_ACTOR, i, 1.0f + next() * (MAP_SIZE - 2), 1.0f + next() * (MAP_SIZE - 2), ACTOR_RADIUS);
+        spatial_build();
+
+        std::vector<Ray> rays(queries);
+        for (Ray& r : rays) {
+            float angle = next() * 2.0f * (float)M_PI;
+            r = { 1.0f + next() * (MAP_SIZE - 2), 1.0f + next() * (MAP_SIZE - 2), cosf(angle), sinf(angle), 8.0f };
+        }
+
+        // Linear reference: the same tests over every entry.
+        const std::vector<SpatialEntry>& all = spatial.entries;
+        std::vector<int> gridHits(queries), linearHits(queries);
+        std::vector<int> gridNearest(queries), linearNearest(queries);
+        std::vector<int> buf(count);
+
+        double start = now_ms();
+        for (int q = 0; q < queries; q++)
+            gridHits[q] = spatial_query_radius(rays[q].x, rays[q].y, radius, SPATIAL_MASK(SPATIAL_ACTOR), buf.data(), count);
+        double gridRadiusUs = (now_ms() - start) * 1000.0 / queries;
+
+        start = now_ms();
+        for (int q = 0; q < queries; q++) {
+            int n = 0;
+            for (const SpatialEntry& e : all) {
+                float dx = e.x - rays[q].x, dy = e.y - rays[q].y;
+                float reach = radius + e.radius;
+                n += dx * dx + dy * dy <= reach * reach;
+            }
+            linearHits[q] = n;
+        }
+        double linearRadiusUs = (now_ms() - start) * 1000.0 / queries;
+
+        start = now_ms();
+        for (int q = 0; q < queries; q++)
+            gridNearest[q] = spatial_raycast(rays[q], SPATIAL_MASK(SPATIAL_ACTOR), NULL);
+        double gridSegmentUs = (now_ms() - start) * 1000.0 / queries;
+
+        start = now_ms();
+        for (int q = 0; q < queries; q++) {
+            const Ray& r = rays[q];
+            int best = -1;
+            float bestDist = r.maxDist;
+            for (int i = 0; i < (int)all.size(); i++) {
+                float ox = all[i].x - r.x, oy = all[i].y - r.y;
+                float along = ox * r.dirX + oy * r.dirY;
+                float side = ox * r.dirY - oy * r.dirX;
+                float r2 = all[i].radius * all[i].radius;
+                if (side * side > r2)
+                    continue;
+                float half = sqrtf(r2 - side * side);
+                if (along + half < 0.0f)
+                    continue;
+                float t = std::max(along - half, 0.0f);
+                if (t < bestDist) {
+                    bestDist = t;
+                    best = i;
+                }
+            }
+            linearNearest[q] = best;
+        }
+        double linearSegmentUs = (now_ms() - start) * 1000.0 / queries;
+
+        int mismatches = 0;
+        for (int q = 0; q < queries; q++) {
+            if (gridHits[q] != linearHits[q] || gridNearest[q] != linearNearest[q])
+                mismatches++;
+        }
+
+        printf("%8d %10.3f %10.3f %10.3f %10.3f %10d\n", count, gridRadiusUs, linearRadiusUs,
+               gridSegmentUs, linearSegmentUs, mismatches);
+        if (mismatches)
+            ok = 0;
+    }
+
+    restore_map(src, srcSize);
+    rebuild_spatial();
+    return ok;
+}
+
+// Labels the 4-connected regions of cells the solid function leaves open.
+static std::vector<int> label_regions(SolidFunc solid)
+{
+    std::vector<int> region(MAP_SIZE * MAP_SIZE, -1);
+    std::vector<int> stack;
+    int next = 0;
+    for (int start = 0; start < MAP_SIZE * MAP_SIZE; start++) {
+        if (region[start] >= 0 || solid(start % MAP_SIZE, start / MAP_SIZE))
+            continue;
+
+        region[start] = next;
+        stack.push_back(start);
+        while (!stack.empty()) {
+            int c = stack.back();
+            stack.pop_back();
+            const int nx[4] = { 1, -1, 0, 0 }, ny[4] = { 0, 0, 1, -1 };
+            for (int n = 0; n < 4; n++) {
+                int x = c % MAP_SIZE + nx[n], y = c / MAP_SIZE + ny[n];
+                if (solid(x, y) || region[y * MAP_SIZE + x] >= 0)
+                    continue;
+                region[y * MAP_SIZE + x] = next;
+                stack.push_back(y * MAP_SIZE + x);
+            }
+        }
+        next++;
+    }
+    return region;
+}
+
+// Random moves from 0.05 to 20 cells long from every open cell. A move must
+// end clear of every wall and in the region it started in, or the circle
+// tunnelled. Also times the short steps actors take every tick, and checks
+// that a centre inside a wall is pushed clear and that an open map edge
+// still stops the player.
+static int bench_collision()
+{
+    int srcSize = MAP_SIZE;
+    std::vector<uint8_t> src(MAPDATA, MAPDATA + srcSize * srcSize);
+    build_tiled_map(src, srcSize, 4);
+
+    std::vector<int> region = label_regions(player_blocks);
+    std::vector<int> openCells;
+    for (int i = 0; i < MAP_SIZE * MAP_SIZE; i++) {
+        if (region[i] >= 0)
+            openCells.push_back(i);
+    }
+
+    uint32_t rng = 4242;
+    auto next = [&]() {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return (rng >> 8) * (1.0f / 16777216.0f);
+    };
+
+    const int moves = 200000;
+    int overlaps = 0, tunnels = 0, contacts = 0;
+    double start = now_ms();
+    for (int m = 0; m < moves; m++) {
+        int cell = openCells[m % openCells.size()];
+        float x = cell % MAP_SIZE + 0.25f + 0.5f * next();
+        float y = cell / MAP_SIZE + 0.25f + 0.5f * next();
+        float angle = next() * 2.0f * (float)M_PI;
+        float length = 0.05f * powf(400.0f, next());
+
+        contacts += move_circle(&x, &y, cosf(angle) * length, sinf(angle) * length, PLAYER_RADIUS, player_blocks);
+
+        if (circle_blocked(x, y, PLAYER_RADIUS, player_blocks))
+            overlaps++;
+        else if (region[(int)y * MAP_SIZE + (int)x] != region[cell])
+            tunnels++;
+    }
+    double moveUs = (now_ms() - start) * 1000.0 / moves;
+
+    // One tick of actor-sized steps.
+    const float step = ACTOR_SPEED * ACTOR_TICK;
+    start = now_ms();
+    for (int m = 0; m < moves; m++) {
+        int cell = openCells[m % openCells.size()];
+        float x = cell % MAP_SIZE + 0.5f, y = cell / MAP_SIZE + 0.5f;
+        float angle = m * 0.61803f;
+        move_circle(&x, &y, cosf(angle) * step, sinf(angle) * step, ACTOR_RADIUS, actor_blocks);
+    }
+    double stepUs = (now_ms() - start) * 1000.0 / moves;
+
+    // Centres dropped anywhere inside the walls next to open cells.
+    const int sideX[4] = { 1, -1, 0, 0 }, sideY[4] = { 0, 0, 1, -1 };
+    int embedded = 0, stuck = 0;
+    for (size_t c = 0; c < openCells.size(); c += 3) {
+        for (int n = 0; n < 4; n++) {
+            int wx = openCells[c] % MAP_SIZE + sideX[n], wy = openCells[c] / MAP_SIZE + sideY[n];
+            if (wx < 0 || wx >= MAP_SIZE || wy < 0 || wy >= MAP_SIZE || !player_blocks(wx, wy))
+                continue;
+
+            float x = wx + next(), y = wy + next();
+            move_circle(&x, &y, 0.0f, 0.0f, PLAYER_RADIUS, player_blocks);
+            embedded++;
+            stuck += circle_blocked(x, y, PLAYER_RADIUS, player_blocks);
+        }
+    }
+
+    // Short rows are padded with floor, so a map's edge cells can be open.
+    // Moves off every edge cell, straight out and at an angle.
+    for (int i = 0; i < MAP_SIZE; i++) {
+        MAPDATA[i] = MAPDATA[(MAP_SIZE - 1) * MAP_SIZE + i] = 0;
+        MAPDATA[i * MAP_SIZE] = MAPDATA[i * MAP_SIZE + MAP_SIZE - 1] = 0;
+    }
+    int edgeMoves = 0, escaped = 0;
+    for (int i = 0; i < MAP_SIZE; i++) {
+        const float from[4][2] = { { i + 0.5f, 0.5f }, { i + 0.5f, MAP_SIZE - 0.5f },
+                                   { 0.5f, i + 0.5f }, { MAP_SIZE - 0.5f, i + 0.5f } };
+        const float out[4][2] = { { 0.0f, -1.0f }, { 0.0f, 1.0f }, { -1.0f, 0.0f }, { 1.0f, 0.0f } };
+        for (int e = 0; e < 4; e++) {
+            for (float slant = -1.0f; slant <= 1.0f; slant += 1.0f) {
+                float x = from[e][0], y = from[e][1];
+                float dx = out[e][0] + slant * out[e][1], dy = out[e][1] + slant * out[e][0];
+                move_circle(&x, &y, dx * 3.0f, dy * 3.0f, PLAYER_RADIUS, player_blocks);
+                edgeMoves++;
+                escaped += x < PLAYER_RADIUS || x > MAP_SIZE - PLAYER_RADIUS ||
+                           y < PLAYER_RADIUS || y > MAP_SIZE - PLAYER_RADIUS;
+            }
+        }
+    }
+
+    printf("collision: %d long moves %.3f us each (%d touched walls), %d overlaps, %d tunnelled\n",
+           moves, moveUs, contacts, overlaps, tunnels);
+    printf("collision: actor steps %.3f us each\n", stepUs);
+    printf("collision: %d centres inside walls, %d left stuck; %d moves off an open edge, %d left the map\n",
+           embedded, stuck, edgeMoves, escaped);
+
+    restore_map(src, srcSize);
+    return overlaps == 0 && tunnels == 0 && stuck == 0 && escaped == 0;
+}
+
+// 10,000 live rockets and bolts on the tiled map at 60 Hz, topped up every
+// frame as they hit walls, objects and 1,000 actors. The light list must not
+// grow past its first-frame capacity.
+static int bench_projectiles()
+{
+    const int target = 10000;
+    const int frames = 600;
+    const float dt = 1.0f / 60.0f;
+    const double frameBudgetMs = 1000.0 / 60.0;
+    if (!load_textures())
+        return 0;
+    init_renderer();
+
+    int srcSize = MAP_SIZE;
+    std::vector<uint8_t> src(MAPDATA, MAPDATA + srcSize * srcSize);
+    v3 savedPos = state.pos;
+    build_tiled_map(src, srcSize, 4);
+    state.pos.x += srcSize;
+    state.pos.y += srcSize;
+
+    std::vector<int> openCells;
+    for (int i = 0; i < MAP_SIZE * MAP_SIZE; i++) {
+        if (!check_collision(i % MAP_SIZE + 0.5f, i / MAP_SIZE + 0.5f))
+            openCells.push_back(i);
+    }
+
+    uint32_t rng = 99;
+    auto next = [&]() {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng;
+    };
+
+    clear_actors();
+    clear_projectiles();
+    for (int i = 0; i < 1000; i++) {
+        int cell = openCells[next() % openCells.size()];
+        spawn_actor(cell % MAP_SIZE + 0.5f, cell / MAP_SIZE + 0.5f);
+    }
+
+    std::vector<DLight> savedLights;
+    savedLights.swap(dynamicLights);
+    dynamicLights.reserve(PROJECTILE_CAPACITY + 16);
+    size_t capacity = dynamicLights.capacity();
+
+    long spawned = 0;
+    int startActors = actors.count;
+    double updateMs = 0.0, lightMs = 0.0;
+    std::vector<double> renderMs;
+    v3 savedDir = state.dir, savedPlane = state.plane;
+    for (int f = 0; f < frames; f++) {
+        while (projectiles.liveCount < target) {
+            int cell = openCells[next() % openCells.size()];
+            float angle = (next() >> 8) * (2.0f * (float)M_PI / 16777216.0f);
+            spawn_projectile(next() & 1, cell % MAP_SIZE + 0.5f, cell / MAP_SIZE + 0.5f, cosf(angle), sinf(angle));
+            spawned++;
+        }
+
+        double start = now_ms();
+        update_projectiles(dt);
+        double mid = now_ms();
+        dynamicLights.clear();
+        add_projectile_lights();
+        double end = now_ms();
+
+        updateMs += mid - start;
+        lightMs += end - mid;
+
+        // The whole frame the lights are drawn into, turning so the view
+        // sweeps across the projectiles. CPU time, as the wall clock here
+        // jitters by more than a frame.
+        float turn = f * (2.0f * (float)M_PI / frames);
+        state.dir = { -cosf(turn), -sinf(turn), 0 };
+        state.plane = { -sinf(turn) * 0.66f, cosf(turn) * 0.66f, 0 };
+        rebuild_spatial();
+        double cpuStart = thread_cpu_ms();
+        render(0.0f);
+        renderMs.push_back(thread_cpu_ms() - cpuStart);
+    }
+
+    int grew = dynamicLights.capacity() != capacity;
+    printf("projectiles: %d live, %ld spawned over %d frames, %d actors hit\n",
+           target, spawned, frames, startActors - actors.count);
+    printf("projectiles: update %.4f ms, lights %.4f ms per frame (%.1f%% of a 60 Hz frame), light list %s\n",
+           updateMs / frames, lightMs / frames, (updateMs + lightMs) / frames * 6.0, grew ? "GREW" : "did not grow");
+    double simMs = (updateMs + lightMs) / frames;
+    double renderTotal = 0.0;
+    for (double ms : renderMs)
+        renderTotal += ms;
+    std::sort(renderMs.begin(), renderMs.end());
+    double worstMs = renderMs.back();
+    printf("projectiles: render %.3f ms avg, %.3f ms worst, %.3f ms with the update (%s the %.1f ms frame)\n",
+           renderTotal / frames, worstMs, worstMs + simMs, worstMs + simMs <= frameBudgetMs ? "within" : "OVER",
+           frameBudgetMs);
+
+    dynamicLights.swap(savedLights);
+    state.dir = savedDir;
+    state.plane = savedPlane;
+    clear_actors();
+    clear_projectiles();
+    restore_map(src, srcSize);
+    state.pos = savedPos;
+    rebuild_spatial();
+    return !grew && worstMs + simMs <= frameBudgetMs;
+}
+
+static int bench_capture()
+{
+    const int frames = 180;
+    const double frameMs = 1000.0 / 60.0;
+    static const char* names[] = { "raw", "png", "y4m" };
+    static const CaptureFormat formats[] = { CAPTURE_RAW, CAPTURE_PNG, CAPTURE_Y4M };
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "sq1_capture_bench";
+    std::filesystem::create_directories(dir);
+
+    printf("capture: %d frames at 60 Hz, %d buffer ring (render thread cost in us)\n", frames, CAPTURE_RING_FRAMES);
+    printf("%8s %10s %10s %10s %10s %10s\n", "format", "avg", "max", "written", "dropped", "max queue");
+
+    int ok = 1;
+    std::vector<uint32_t> saved(state.pixels, state.pixels + SCREEN_WIDTH * SCREEN_HEIGHT);
+    for (int f = 0; f < 3; f++) {
+        std::string path = (dir / (std::string("frames.") + names[f])).string();
+        if (!capture_start(path.c_str(), formats[f], CAPTURE_RING_FRAMES, CAPTURE_FPS)) {
+            ok = 0;
+            break;
+        }
+
+        double totalUs = 0.0, maxUs = 0.0;
+        double next = now_ms();
+        for (int i = 0; i < frames; i++) {
+            for (int p = 0; p < SCREEN_WIDTH * SCREEN_HEIGHT; p++)
+                state.pixels[p] = 0xff000000u | (uint32_t)(p * 2654435761u + i * 40503u) >> 8;
+
+            double start = now_ms();
+            capture_frame();
+            double us = (now_ms() - start) * 1000.0;
+            totalUs += us;
+            maxUs = std::max(maxUs, us);
+
+            next += frameMs;
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(next - now_ms()));
+        }
+
+        capture_stop();
+        CaptureStats cs = capture_stats();
+        printf("%8s %10.2f %10.2f %10llu %10llu %10d\n", names[f], totalUs / frames, maxUs,
+               (unsigned long long)cs.written, (unsigned long long)cs.dropped, cs.maxQueueDepth);
+        if (cs.written + cs.dropped != (uint64_t)frames)
+            ok = 0;
+    }
+
+    std::copy(saved.begin(), saved.end(), state.pixels);
+    std::filesystem::remove_all(dir);
+    return ok;
+}
+
+static int bench_interest()
+{
+    const int clients = 64;
+    const int ticks = 300;
+
+    int srcSize = MAP_SIZE;
+    std::vector<uint8_t> src(MAPDATA, MAPDATA + srcSize * srcSize);
+    v3 savedPos = state.pos, savedDir = state.dir, savedPlane = state.plane;
+    build_tiled_map(src, srcSize, 8);
+    // Clients spawn facing the way the game starts.
+    state.dir = { -1.0f, 0.0f, 0.0f };
+    state.plane = { 0.0f, 0.66f, 0.0f };
+    std::vector<uint8_t> tiled(MAPDATA, MAPDATA + MAP_SIZE * MAP_SIZE);
+
+    if (!net_init())
+        return 0;
+
+    printf("interest: %d loopback clients, %dx%d map, %d ticks\n", clients, MAP_SIZE, MAP_SIZE, ticks);
+    printf("%10s %10s %10s %12s %10s %10s\n", "mode", "tick ms", "entities", "bytes/snap", "kbit/s", "mismatch");
+
+    int ok = 1;
+    uint64_t everythingBytes = 0, interestBytes = 0;
+    for (int useInterest = 0; useInterest <= 1; useInterest++) {
+        memcpy(MAPDATA, tiled.data(), tiled.size());
+        if (!server_start(0)) {
+            ok = 0;
+            break;
+        }
+        server.useInterest = useInterest;
+        uint16_t port = server_port();
+
+        std::vector<ClientBot> bots(clients);
+        for (int i = 0; i < clients; i++) {
+            bots[i].seed = 0x9e3779b9u * (i + 1);
+            if (!client_connect(&bots[i].client, port, tiled.data(), MAP_SIZE))
+                ok = 0;
+        }
+
+        for (int t = 0; t < ticks; t++) {
+            for (ClientBot& b : bots) {
+                client_receive(&b.client);
+                client_send_input(&b.client, client_bot_input(&b, 1000 / SERVER_TICK_RATE));
+            }
+            server_tick();
+        }
+
+        uint64_t bytes = 0, entities = 0;
+        uint32_t snapshots = 0;
+        int mismatches = 0;
+        for (ClientBot& b : bots) {
+            client_receive(&b.client);
+            mismatches += server_check_client(&b.client);
+            if (b.client.id >= 0) {
+                const ServerClient& sc = server.clients[b.client.id];
+                bytes += sc.bytesSent;
+                entities += sc.entitiesSent;
+                snapshots += sc.snapshotsSent;
+            }
+            client_disconnect(&b.client);
+        }
+        (useInterest ? interestBytes : everythingBytes) = bytes;
+
+        double perSnapshot = (double)bytes / std::max(1u, snapshots);
+        printf("%10s %10.4f %10.1f %12.1f %10.2f %10d\n", useInterest ? "visible" : "everything",
+               server.totalTickMs / ticks, (double)entities / std::max(1u, snapshots), perSnapshot,
+               perSnapshot * SERVER_TICK_RATE * 8.0 / 1000.0, mismatches);
+        if (mismatches)
+            ok = 0;
+        server_stop();
+    }
+
+    if (interestBytes)
+        printf("interest: %.1fx less snapshot data\n", (double)everythingBytes / interestBytes);
+
+    net_shutdown();
+    clear_projectiles();
+    restore_map(src, srcSize);
+    state.pos = savedPos;
+    state.dir = savedDir;
+    state.plane = savedPlane;
+    build_flow_field((int)state.pos.y * MAP_SIZE + (int)state.pos.x);
+    rebuild_spatial();
+    return ok;
+}
+
+static int bench_pvs()
+{
+    int srcSize = MAP_SIZE;
+    std::vector<uint8_t> src(MAPDATA, MAPDATA + srcSize * srcSize);
+    build_tiled_map(src, srcSize, 4);
+
+    double start = now_ms();
+    build_pvs();
+    double buildMs = now_ms() - start;
+
+    std::string text = encode_pvs();
+    std::vector<uint64_t> built = pvs.bits;
+    int decoded = decode_pvs(text) && pvs.bits == built;
+    size_t rawBytes = (size_t)MAP_SIZE * MAP_SIZE * PVS_SIDE * PVS_SIDE / 8;
+    printf("pvs: %dx%d map, radius %d, built in %.1f ms\n", MAP_SIZE, MAP_SIZE, PVS_RADIUS, buildMs);
+    printf("pvs: %zu bytes in the map file for %zu bytes of bits (%.1fx), round trip %s\n",
+           text.size(), rawBytes, (double)rawBytes / text.size(), decoded ? "ok" : "FAILED");
+
+    std::vector<int> openCells;
+    for (int i = 0; i < MAP_SIZE * MAP_SIZE; i++) {
+        if (!check_collision(i % MAP_SIZE + 0.5f, i / MAP_SIZE + 0.5f))
+            openCells.push_back(i);
+    }
+
+    uint32_t rng = 777;
+    auto next = [&]() {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng;
+    };
+    auto unit = [&]() { return (next() >> 8) * (1.0f / 16777216.0f); };
+
+    // Point to point lines of sight against the cell sets, the way the
+    // renderer and the server use them.
+    const int samples = 200000;
+    std::vector<Ray> rays;
+    std::vector<int> pairs;
+    while ((int)rays.size() < samples) {
+        int a = openCells[next() % openCells.size()];
+        int b = openCells[next() % openCells.size()];
+        float ax = a % MAP_SIZE + unit(), ay = a / MAP_SIZE + unit();
+        float bx = b % MAP_SIZE + unit(), by = b / MAP_SIZE + unit();
+        if (abs(a % MAP_SIZE - b % MAP_SIZE) > 15 || abs(a / MAP_SIZE - b / MAP_SIZE) > 15 || a == b)
+            continue;
+        float dx = bx - ax, dy = by - ay, dist = sqrtf(dx * dx + dy * dy);
+        rays.push_back({ ax, ay, dx / dist, dy / dist, dist });
+        pairs.push_back(a);
+        pairs.push_back(b);
+    }
+    std::vector<RayHit> hits(rays.size());
+    start = now_ms();
+    trace_rays(rays.data(), (int)rays.size(), RAY_STOP_WALLS, hits.data());
+    double traceMs = now_ms() - start;
+
+    int clear = 0, missed = 0, extra = 0, inSet = 0;
+    start = now_ms();
+    for (size_t i = 0; i < rays.size(); i++)
+        inSet += pvs_visible(pairs[i * 2], pairs[i * 2 + 1]);
+    double lookupMs = now_ms() - start;
+    for (size_t i = 0; i < rays.size(); i++) {
+        int visible = pvs_visible(pairs[i * 2], pairs[i * 2 + 1]);
+        clear += !hits[i].hit;
+        missed += !hits[i].hit && !visible;
+        extra += hits[i].hit && visible;
+    }
+    printf("pvs: %d point pairs, %d clear; set misses %d, lets through %d blocked (%.1f%%)\n",
+           samples, clear, missed, extra, 100.0 * extra / std::max(1, samples - clear));
+    printf("pvs: %d pairs in the set; lookups %.4f us, traced lines %.4f us per pair\n",
+           inSet, lookupMs * 1000.0 / samples, traceMs * 1000.0 / samples);
+
+    // Knock walls out and put them back, repairing the set each time, then
+    // compare with a rebuild from scratch.
+    std::vector<int> walls;
+    for (int i = 0; i < MAP_SIZE * MAP_SIZE; i++) {
+        int x = i % MAP_SIZE, y = i / MAP_SIZE;
+        if (MAPDATA[i] == 1 && x > 0 && y > 0 && x < MAP_SIZE - 1 && y < MAP_SIZE - 1)
+            walls.push_back(i);
+    }
+    const int edits = 40;
+    double incrementalMs = 0.0;
+    for (int e = 0; e < edits; e++) {
+        int cell = (e & 1) ? openCells[next() % openCells.size()] : walls[next() % walls.size()];
+        uint8_t old = MAPDATA[cell];
+        MAPDATA[cell] = (e & 1) ? 1 : 0;
+        start = now_ms();
+        pvs_cell_changed(cell);
+        incrementalMs += now_ms() - start;
+        if (e % 4 == 3) {
+            MAPDATA[cell] = old;
+            pvs_cell_changed(cell);
+        }
+    }
+    std::vector<uint64_t> repaired = pvs.bits;
+    build_pvs();
+    long mismatches = 0;
+    for (size_t i = 0; i < repaired.size(); i++)
+        mismatches += __builtin_popcountll(repaired[i] ^ pvs.bits[i]);
+    printf("pvs: %d wall edits repaired in %.3f ms each (rebuild %.1f ms), %ld mismatched bits\n",
+           edits, incrementalMs / edits, buildMs, mismatches);
+
+    restore_map(src, srcSize);
+    build_pvs();
+    rebuild_spatial();
+    return decoded && missed == 0 && mismatches == 0;
+}
+
+// The loader as it was: one registered texture after another, each image
+// decoded and copied into a surface of its own.
+static double load_textures_serial(std::vector<SDL_Surface*>& out)
+{
+    double start = now_ms();
+    out.assign(texture_count(), NULL);
+    for (TextureHandle t = 0; t < texture_count(); t++) {
+        int w, h, channels;
+        uint8_t* pixels = stbi_load(texture_file(t), &w, &h, &channels, 4);
+        if (!pixels)
+            continue;
+        out[t] = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ABGR8888);
+        memcpy(out[t]->pixels, pixels, (size_t)w * h * 4);
+        stbi_image_free(pixels);
+    }
+    return now_ms() - start;
+}
+
+static int same_chain(const std::vector<TextureMip>& a, TextureHandle t)
+{
+    for (int l = 0; l < (int)a.size(); l++) {
+        const TextureMip* m = texture_mip(t, l);
+        size_t bytes = (size_t)m->width * m->height * 4;
+        if (m->width != a[l].width || m->height != a[l].height ||
+            memcmp(m->rows, a[l].rows, bytes) != 0 || memcmp(m->columns, a[l].columns, bytes) != 0)
+            return 0;
+    }
+    return texture_mip(t, (int)a.size()) == texture_mip(t, (int)a.size() - 1);
+}
+
+static int bench_textures()
+{
+    const int reps = 5;
+    if (!load_texture_manifest(TEXTURE_MANIFEST))
+        return 0;
+    int count = texture_count();
+
+    double serialMs = 1e30, decodeMs = 1e30, packMs = 1e30;
+    std::vector<SDL_Surface*> serial;
+    for (int r = 0; r < reps; r++) {
+        serialMs = std::min(serialMs, load_textures_serial(serial));
+        if (r + 1 < reps) {
+            for (SDL_Surface* s : serial)
+                SDL_FreeSurface(s);
+        }
+    }
+    for (int r = 0; r < reps; r++) {
+        double start = now_ms();
+        if (!load_texture_files())
+            return 0;
+        decodeMs = std::min(decodeMs, now_ms() - start);
+    }
+
+    int same = 1, aligned = 1;
+    for (TextureHandle t = 0; t < count; t++) {
+        const TextureMip* m = texture_mip(t, 0);
+        same &= serial[t] && serial[t]->w == m->width && serial[t]->h == m->height &&
+                memcmp(serial[t]->pixels, m->rows, (size_t)m->width * m->height * 4) == 0;
+        aligned &= ((uintptr_t)m->rows % TEXTURE_ALIGN) == 0;
+        SDL_FreeSurface(serial[t]);
+    }
+
+    // Keep copies of the decoded chains to compare the packed ones with.
+    std::vector<std::vector<uint32_t>> store;
+    std::vector<std::vector<TextureMip>> decoded(count);
+    for (TextureHandle t = 0; t < count; t++) {
+        for (int l = 0; l < texture_image(t)->levels; l++) {
+            const TextureMip* m = texture_mip(t, l);
+            size_t n = (size_t)m->width * m->height;
+            store.emplace_back(m->rows, m->rows + n);
+            store.emplace_back(m->columns, m->columns + n);
+            decoded[t].push_back({ NULL, NULL, m->width, m->height });
+        }
+    }
+    size_t next = 0;
+    for (TextureHandle t = 0; t < count; t++) {
+        for (TextureMip& m : decoded[t]) {
+            m.rows = store[next++].data();
+            m.columns = store[next++].data();
+        }
+    }
+
+    std::string path = (std::filesystem::temp_directory_path() / "sq1_bench.pak").string();
+    double packStart = now_ms();
+    int packed = pack_write(path.c_str(), texture_files(), { "map.txt", TEXTURE_MANIFEST });
+    double writeMs = now_ms() - packStart;
+
+    int packSame = packed;
+    for (int r = 0; r < reps && packSame; r++) {
+        double start = now_ms();
+        packSame = pack_open(path.c_str()) && load_texture_pack();
+        packMs = std::min(packMs, now_ms() - start);
+    }
+    for (TextureHandle t = 0; t < count && packSame; t++) {
+        packSame = same_chain(decoded[t], t) && ((uintptr_t)texture_mip(t, 0)->rows % TEXTURE_ALIGN) == 0;
+        aligned &= ((uintptr_t)texture_mip(t, 1)->columns % TEXTURE_ALIGN) == 0;
+    }
+
+    printf("textures: serial %.2f ms, parallel decode %.2f ms (%.2fx) on %d threads, pixels %s, %d-byte aligned %s\n",
+           serialMs, decodeMs, serialMs / decodeMs, jobs_thread_count(), same ? "match" : "DIFFER",
+           TEXTURE_ALIGN, aligned ? "yes" : "NO");
+    printf("textures: pack written in %.2f ms (%llu bytes), mapped and loaded in %.3f ms (%.0fx faster than decoding), mips and columns %s\n",
+           writeMs, packed ? (unsigned long long)std::filesystem::file_size(path) : 0ull, packMs,
+           decodeMs / packMs, packSame ? "match" : "DIFFER");
+
+    free_textures();
+    pack_close();
+    std::filesystem::remove(path);
+    return same && aligned && packSame;
+}
+
+static int bench_reload()
+{
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "sq1_reload_bench";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    if (!load_texture_manifest(TEXTURE_MANIFEST))
+        return 0;
+    for (const std::string& file : texture_files())
+        fs::copy_file(file, dir / file, fs::copy_options::overwrite_existing);
+    fs::copy_file("map.txt", dir / "map.txt", fs::copy_options::overwrite_existing);
+
+    // Frames run on this thread alone, so its CPU time is the whole cost of
+    // a frame.
+    if (!jobs_init(1) || !load_texture_files() || !load_map((dir / "map.txt").string()) ||
+        !reload_start(dir.string().c_str(), "map.txt"))
+        return 0;
+    init_renderer();
+    state.dir = { -1.0f, 0.0f, 0 };
+    state.plane = { 0.0f, 0.66f, 0 };
+    const TextureMip floor = *texture_mip(texture_handle("floor"), 0);
+    std::vector<uint32_t> floorPixels(floor.rows, floor.rows + floor.width * floor.height);
+
+    // Wall1 becomes the floor image, the sky the wall and the weapon the
+    // enemy, each written beside and renamed the way editors save. The sky
+    // panorama and the weapon mask are built from the images, so they have
+    // to follow. The map gains a wall, which leaves its #pvs line stale.
+    const char* swaps[][2] = { { "floor.png", "wall1.png" }, { "wall1.png", "sky.png" }, { "enemy.png", "weapon.png" } };
+    for (const auto& swap : swaps) {
+        fs::copy_file(swap[0], dir / "swap.tmp", fs::copy_options::overwrite_existing);
+        fs::rename(dir / "swap.tmp", dir / swap[1]);
+    }
+    std::ifstream in("map.txt");
+    std::string text, line;
+    int wallCell = -1;
+    for (int y = 0; std::getline(in, line); y++) {
+        size_t x = line.find("0000");
+        if (wallCell < 0 && y > 0 && x != std::string::npos) {
+            line[x + 1] = '1';
+            wallCell = y * MAP_SIZE + (int)x + 1;
+        }
+        text += line + "\n";
+    }
+    std::ofstream((dir / "map.txt").string()) << text;
+
+    // Whole frames, so the hitch includes what render() rebuilds after a
+    // swap as well as the swap itself. The budget is checked against CPU
+    // time; the wall clock is reported beside it.
+    double start = now_ms();
+    double detectMs = -1.0, swapFrameMs = 0.0, longestMs = 0.0, longestWallMs = 0.0;
+    int frames = 0, applied = 0;
+    while (now_ms() - start < 10000.0) {
+        double frameStart = now_ms();
+        double cpuStart = thread_cpu_ms();
+        reload_poll();
+        render(0.0f);
+        double frameMs = thread_cpu_ms() - cpuStart;
+        longestWallMs = std::max(longestWallMs, now_ms() - frameStart);
+        frames++;
+
+        longestMs = std::max(longestMs, frameMs);
+        ReloadStats rs = reload_stats();
+        if (rs.textures + rs.maps != applied) {
+            applied = rs.textures + rs.maps;
+            swapFrameMs = std::max(swapFrameMs, frameMs);
+        }
+        if (detectMs < 0.0 && rs.textures >= 3 && rs.maps > 0)
+            detectMs = now_ms() - start;
+        if (detectMs >= 0.0 && pvs.complete)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    ReloadStats rs = reload_stats();
+    reload_stop();
+
+    // The same frames with nothing left to reload.
+    std::vector<double> quietMs;
+    for (int i = 0; i < 21; i++) {
+        double cpuStart = thread_cpu_ms();
+        render(0.0f);
+        quietMs.push_back(thread_cpu_ms() - cpuStart);
+    }
+    std::sort(quietMs.begin(), quietMs.end());
+    double typicalMs = quietMs[quietMs.size() / 2];
+
+    // The frame after the swap has to be the one a renderer set up from
+    // scratch on the new images draws.
+    render(0.0f);
+    std::vector<Pixel> afterSwap(state.pixels, state.pixels + SCREEN_WIDTH * SCREEN_HEIGHT);
+    init_renderer();
+    render(0.0f);
+    int derivedSame = memcmp(afterSwap.data(), state.pixels, afterSwap.size() * sizeof(Pixel)) == 0;
+
+    const TextureMip* m = texture_mip(texture_handle("wall1"), 0);
+    int swapped = m->width == floor.width && m->height == floor.height &&
+                  memcmp(m->rows, floorPixels.data(), floorPixels.size() * 4) == 0 &&
+                  wallTextures[1] == texture_image(texture_handle("wall1"));
+    int mapSwapped = wallCell >= 0 && MAPDATA[wallCell] == 1;
+    std::vector<uint64_t> sliced = pvs.bits;
+    int slicedDone = pvs.complete;
+    build_pvs();
+    int pvsSame = slicedDone && sliced == pvs.bits;
+
+    printf("reload: %d textures and %d maps picked up in %.1f ms, %d frames to finish the visibility set\n",
+           rs.textures, rs.maps, detectMs, frames);
+    printf("reload: frame applying the swaps %.3f ms, longest while reloading %.3f ms (%.3f ms wall), "
+           "%.3f ms without reloads; hitch %.3f ms (budget %.1f ms)\n",
+           swapFrameMs, longestMs, longestWallMs, typicalMs, longestMs - typicalMs, RELOAD_BUDGET_MS);
+    std::string names;
+    for (const std::string& name : rs.names)
+        names += " " + name;
+    printf("reload: swapped in%s\n", names.c_str());
+    printf("reload: textures %s, map %s, sky and weapon %s, sliced visibility %s\n",
+           swapped ? "swapped" : "NOT SWAPPED", mapSwapped ? "swapped" : "NOT SWAPPED",
+           derivedSame ? "rebuilt" : "STALE", pvsSame ? "matches a full build" : "DIFFERS");
+
+    free_textures();
+    load_map("map.txt");
+    fs::remove_all(dir);
+    jobs_init(0);
+    return swapped && mapSwapped && derivedSame && pvsSame && longestMs - typicalMs <= RELOAD_BUDGET_MS;
+}
+
+// Draws the same views from the 32-bit textures and from the palette-indexed
+// copies, and compares the frames.
+static int bench_palette()
+{
+    const int reps = 3;
+    const int n = SCREEN_WIDTH * SCREEN_HEIGHT;
+    if (!load_textures())
+        return 0;
+    init_renderer();
+
+    std::vector<CameraPose> all = collect_poses();
+    std::vector<CameraPose> poses;
+    for (size_t i = 0; i < all.size(); i += 7)
+        poses.push_back(all[i]);
+
+    std::vector<uint32_t> reference(poses.size() * n);
+    double frameMs[2] = { 1e30, 1e30 };
+    double indexMs = 0.0;
+    uint64_t errorSum = 0;
+    int errorMax = 0;
+    for (int indexed = 0; indexed < 2; indexed++) {
+        double start = now_ms();
+        set_indexed_textures(indexed);
+        if (indexed)
+            indexMs = now_ms() - start;
+
+        for (int r = 0; r < reps; r++) {
+            start = now_ms();
+            for (size_t p = 0; p < poses.size(); p++) {
+                set_pose(poses[p]);
+                render(0.0f);
+                if (r > 0)
+                    continue;
+
+                uint32_t* ref = &reference[p * n];
+                if (!indexed) {
+                    std::copy(state.pixels, state.pixels + n, ref);
+                    continue;
+                }
+                for (int i = 0; i < n; i++) {
+                    for (int c = 0; c < 3; c++) {
+                        int d = abs((int)((state.pixels[i] >> (8 * c)) & 0xFF) - (int)((ref[i] >> (8 * c)) & 0xFF));
+                        errorSum += d;
+                        errorMax = std::max(errorMax, d);
+                    }
+                }
+            }
+            frameMs[indexed] = std::min(frameMs[indexed], (now_ms() - start) / poses.size());
+        }
+    }
+
+    // A reload while the indexed path is on: the frame that picks up the
+    // swap converts the new image against the palette already built.
+    double swapFrameMs = 0.0, quietFrameMs = 0.0;
+    int reindexed = 0;
+    TextureImage swapped = {};
+    if (decode_texture("floor.png", &swapped) && swap_texture("wall1.png", &swapped)) {
+        set_pose(poses[0]);
+        double start = now_ms();
+        render(0.0f);
+        swapFrameMs = now_ms() - start;
+        start = now_ms();
+        render(0.0f);
+        quietFrameMs = now_ms() - start;
+
+        const TextureMip& m = wallTextures[1]->mips[0];
+        const IndexedImage* copy = indexed_image(wallTextures[1]);
+        reindexed = copy && copy->width == m.width && copy->height == m.height;
+        for (int p = 0; reindexed && p < m.width * m.height; p++)
+            reindexed = copy->rows[p] == palette_index(m.rows[p]);
+    }
+    free_texture_image(&swapped);
+    set_indexed_textures(USE_INDEXED_TEXTURES);
+
+    // Memory the wall and floor images hold. The 32-bit images stay resident
+    // with the indexed path on, since switching the path off and re-indexing
+    // a reloaded texture both read them, so the indexed copies are extra.
+    // Each level holds rows and columns.
+    size_t levelZeroBytes = 0, chainBytes = 0;
+    std::vector<const TextureImage*> seen;
+    for (int tile = 0; tile < TEXTURE_TILES; tile++) {
+        if (wallTextures[tile])
+            seen.push_back(wallTextures[tile]);
+    }
+    seen.push_back(texture_image(texture_handle("floor")));
+    std::sort(seen.begin(), seen.end());
+    seen.erase(std::unique(seen.begin(), seen.end()), seen.end());
+    for (const TextureImage* image : seen) {
+        if (!image)
+            continue;
+        for (int l = 0; l < image->levels; l++) {
+            size_t bytes = (size_t)image->mips[l].width * image->mips[l].height * 4;
+            bytes = (bytes + TEXTURE_ALIGN - 1) & ~(size_t)(TEXTURE_ALIGN - 1);
+            if (l == 0)
+                levelZeroBytes += 2 * bytes;
+            chainBytes += 2 * bytes;
+        }
+    }
+    size_t indexedBytes = indexed_bytes();
+    double meanError = (double)errorSum / ((double)poses.size() * n * 3);
+
+    printf("palette: %zu views, palette and indexed copies built in %.2f ms\n", poses.size(), indexMs);
+    printf("palette: frame %.3f ms from 32-bit textures, %.3f ms indexed (%.2fx)\n",
+           frameMs[0], frameMs[1], frameMs[0] / frameMs[1]);
+    printf("palette: wall and floor level 0 %zu KB at 32 bits, %zu KB indexed, rows and columns; "
+           "channel error mean %.2f, max %d\n", levelZeroBytes / 1024, indexedBytes / 1024, meanError, errorMax);
+    printf("palette: resident wall and floor images %zu KB at 32 bits with mips, %zu KB with the indexed path on "
+           "(+%.0f%%)\n", chainBytes / 1024, (chainBytes + indexedBytes) / 1024, 100.0 * indexedBytes / chainBytes);
+    printf("palette: frame applying a texture swap %.3f ms, %.3f ms without; swapped copy %s\n",
+           swapFrameMs, quietFrameMs, reindexed ? "re-indexed" : "STALE");
+
+    free_palette();
+    free_textures();
+    return indexedBytes * 4 == levelZeroBytes && meanError < 2.0 && reindexed;
+}
+
+// Each post effect over a 640x400 frame, scalar reference against SSE2,
+// then the whole chain as render() runs it.
+static int bench_post()
+{
+    const int width = 640, height = 400, reps = 50;
+    const size_t n = (size_t)width * height;
+    const double budgetMs = 0.2;
+
+    std::vector<uint32_t> source(n), scalar(n), simd(n);
+    uint32_t seed = 12345;
+    for (uint32_t& p : source) {
+        seed = seed * 1664525u + 1013904223u;
+        p = seed >> 8;
+    }
+
+    printf("post: %dx%d frame, best of %d runs (ms)\n", width, height, reps);
+    printf("%8s %10s %10s %10s %10s %8s\n", "effect", "scalar", "simd", "speedup", "changed", "match");
+    static const char* names[POST_EFFECT_COUNT] = { "glitch", "dither" };
+    int ok = 1;
+    for (int e = 0; e < POST_EFFECT_COUNT; e++) {
+        double ms[2] = { 1e30, 1e30 };
+        for (int useSimd = 0; useSimd < 2; useSimd++) {
+            std::vector<uint32_t>& out = useSimd ? simd : scalar;
+            for (int r = 0; r < reps; r++) {
+                std::copy(source.begin(), source.end(), out.begin());
+                double start = now_ms();
+                if (e == POST_GLITCH)
+                    post_glitch(out.data(), width, height, 0x2545F491u, useSimd);
+                else
+                    post_dither(out.data(), width, height, useSimd);
+                ms[useSimd] = std::min(ms[useSimd], now_ms() - start);
+            }
+        }
+
+        size_t changed = 0;
+        for (size_t i = 0; i < n; i++)
+            changed += simd[i] != source[i];
+        int same = scalar == simd;
+        ok &= same && ms[1] < budgetMs;
+        printf("%8s %10.3f %10.3f %9.1fx %9.1f%% %8s\n", names[e], ms[0], ms[1], ms[0] / ms[1],
+               100.0 * changed / n, same ? "yes" : "NO");
+    }
+
+    // The whole chain, one sweep per effect against bands of rows, on this
+    // frame and on one four times larger.
+    static const int all[POST_EFFECT_COUNT] = { 1, 1 };
+    for (int scale = 1; scale <= 2; scale++) {
+        int w = width * scale, h = height * scale;
+        std::vector<uint32_t> frame((size_t)w * h), separate((size_t)w * h), fused((size_t)w * h);
+        for (size_t i = 0; i < frame.size(); i++)
+            frame[i] = source[i % n];
+
+        double sweepMs = 1e30, fusedMs = 1e30;
+        for (int r = 0; r < reps; r++) {
+            std::copy(frame.begin(), frame.end(), separate.begin());
+            double start = now_ms();
+            post_chain(separate.data(), w, h, all, 0x2545F491u, h);
+            sweepMs = std::min(sweepMs, now_ms() - start);
+
+            std::copy(frame.begin(), frame.end(), fused.begin());
+            start = now_ms();
+            post_chain(fused.data(), w, h, all, 0x2545F491u, post_tile_rows(w));
+            fusedMs = std::min(fusedMs, now_ms() - start);
+        }
+
+        // The chain has to agree with the effects run on their own.
+        post_glitch(frame.data(), w, h, 0x2545F491u, 0);
+        post_dither(frame.data(), w, h, 0);
+        int same = separate == frame && fused == frame;
+        ok &= same;
+        printf("post: glitch and dither at %dx%d, separate sweeps %.3f ms, fused %d-row bands %.3f ms (%.2fx), pixels %s\n",
+               w, h, sweepMs, post_tile_rows(w), fusedMs, sweepMs / fusedMs, same ? "match" : "DIFFER");
+    }
+    return ok;
+}
+
+// Reference forms of the pixel helpers that take a pixel apart into an RGBA
+// struct, work channel by channel and pack it again.
+static inline RGBA unpack_pixel(Pixel p)
+{
+    return { (uint8_t)pixel_r(p), (uint8_t)pixel_g(p), (uint8_t)pixel_b(p), (uint8_t)pixel_a(p) };
+}
+
+static inline Pixel pack_pixel(RGBA c)
+{
+    return pixel_rgba(c.r, c.g, c.b, c.a);
+}
+
+static inline Pixel struct_scale(Pixel p, int mul)
+{
+    RGBA c = unpack_pixel(p);
+    c.r = (uint8_t)(c.r * mul >> 8);
+    c.g = (uint8_t)(c.g * mul >> 8);
+    c.b = (uint8_t)(c.b * mul >> 8);
+    c.a = (uint8_t)(c.a * mul >> 8);
+    return pack_pixel(c);
+}
+
+static inline Pixel struct_lerp(Pixel a, Pixel b, int t)
+{
+    RGBA x = unpack_pixel(a), y = unpack_pixel(b);
+    x.r = (uint8_t)((x.r * (256 - t) + y.r * t) >> 8);
+    x.g = (uint8_t)((x.g * (256 - t) + y.g * t) >> 8);
+    x.b = (uint8_t)((x.b * (256 - t) + y.b * t) >> 8);
+    x.a = (uint8_t)((x.a * (256 - t) + y.a * t) >> 8);
+    return pack_pixel(x);
+}
+
+static inline Pixel struct_add_sat(Pixel a, Pixel b)
+{
+    RGBA x = unpack_pixel(a), y = unpack_pixel(b);
+    x.r = (uint8_t)std::min(x.r + y.r, 255);
+    x.g = (uint8_t)std::min(x.g + y.g, 255);
+    x.b = (uint8_t)std::min(x.b + y.b, 255);
+    x.a = (uint8_t)std::min(x.a + y.a, 255);
+    return pack_pixel(x);
+}
+
+static int bench_pixel()
+{
+    const int width = 640, height = 400, reps = 50, checks = 1 << 20;
+    const size_t n = (size_t)width * height;
+
+    uint32_t seed = 12345;
+    auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed;
+    };
+
+    // Every helper against its channel by channel form on random pixels and
+    // weights, the weights covering both ends of [0, 256].
+    int mismatches[3] = { 0, 0, 0 };
+    for (int i = 0; i < checks; i++) {
+        Pixel a = next(), b = next();
+        int t = (int)(next() >> 8) % 257;
+        mismatches[0] += pixel_scale(a, t) != struct_scale(a, t);
+        mismatches[1] += pixel_lerp(a, b, t) != struct_lerp(a, b, t);
+        mismatches[2] += pixel_add_sat(a, b) != struct_add_sat(a, b);
+    }
+    printf("pixel: %d random cases, mismatches scale %d, lerp %d, add_sat %d\n", checks, mismatches[0],
+           mismatches[1], mismatches[2]);
+
+    // A frame through the shading the renderer does per texel: tonemap
+    // blend, fog and an added light.
+    std::vector<Pixel> source(n), fog(n), light(n), packed(n), bytes(n);
+    for (size_t i = 0; i < n; i++) {
+        source[i] = next() & PIXEL_RGB_MASK;
+        fog[i] = (next() >> 8) % 257;
+        light[i] = next() & 0x003F3F3Fu;
+    }
+    const Pixel sky = pixel_rgb(200, 180, 255);
+    const int mix = 40;
+
+    double ms[2] = { 1e30, 1e30 };
+    for (int r = 0; r < reps; r++) {
+        double start = now_ms();
+        for (size_t i = 0; i < n; i++)
+            packed[i] = pixel_add_sat(pixel_scale(pixel_lerp(source[i], sky, mix), (int)fog[i]), light[i]);
+        ms[0] = std::min(ms[0], now_ms() - start);
+
+        start = now_ms();
+        for (size_t i = 0; i < n; i++)
+            bytes[i] = struct_add_sat(struct_scale(struct_lerp(source[i], sky, mix), (int)fog[i]), light[i]);
+        ms[1] = std::min(ms[1], now_ms() - start);
+    }
+    int same = packed == bytes;
+    printf("pixel: shade %dx%d, packed %.3f ms, byte struct %.3f ms (%.2fx), pixels %s\n", width, height, ms[0],
+           ms[1], ms[1] / ms[0], same ? "match" : "DIFFER");
+    return same && mismatches[0] == 0 && mismatches[1] == 0 && mismatches[2] == 0;
+}
+
+int run_bench(const char* name)
+{
+    if (strcmp(name, "raycast") == 0)
+        return bench_raycast();
+    if (strcmp(name, "fixed") == 0)
+        return bench_fixed();
+    if (strcmp(name, "hitscan") == 0)
+        return bench_hitscan();
+    if (strcmp(name, "actors") == 0)
+        return bench_actors();
+    if (strcmp(name, "flowfield") == 0)
+        return bench_flowfield();
+    if (strcmp(name, "spatial") == 0)
+        return bench_spatial();
+    if (strcmp(name, "collision") == 0)
+        return bench_collision();
+    if (strcmp(name, "projectiles") == 0)
+        return bench_projectiles();
+    if (strcmp(name, "capture") == 0)
+        return bench_capture();
+    if (strcmp(name, "interest") == 0)
+        return bench_interest();
+    if (strcmp(name, "pvs") == 0)
+        return bench_pvs();
+    if (strcmp(name, "textures") == 0)
+        return bench_textures();
+    if (strcmp(name, "reload") == 0)
+        return bench_reload();
+    if (strcmp(name, "palette") == 0)
+        return bench_palette();
+    if (strcmp(name, "post") == 0)
+        return bench_post();
+    if (strcmp(name, "pixel") == 0)
+        return bench_pixel();
+
+    std::cerr << "unknown benchmark: " << name << std::endl;
+    return 0;
+}
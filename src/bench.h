@@ -0,0 +1,6 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+int run_bench(const char* name);
+
+#endif
\ No newline at end of file
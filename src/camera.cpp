@@ -0,0 +1,65 @@
+#include "pch.h"
+
+static inline int fixed_delta_dist(int rayDir)
+{
+    if (rayDir == 0)
+        return FIXED_FAR;
+    int64_t delta = ((int64_t)1 << (2 * FIXED_SHIFT)) / std::abs(rayDir);
+    return (int)std::min(delta, (int64_t)FIXED_FAR);
+}
+
+void setup_camera_table(CameraTable& cam, int width, int height)
+{
+    cam.width = width;
+    cam.height = height;
+
+    int dirX = to_fixed(state.dir.x), dirY = to_fixed(state.dir.y);
+    int planeX = to_fixed(state.plane.x), planeY = to_fixed(state.plane.y);
+
+    for (int x = 0; x < width; x++) {
+        int cameraX_fixed = ((2 * x) << 16) / width - (1 << 16);
+
+        float rayDirX = state.dir.x + ((state.plane.x * cameraX_fixed) / 65536.0f);
+        float rayDirY = state.dir.y + ((state.plane.y * cameraX_fixed) / 65536.0f);
+
+        cam.rayDirX[x] = rayDirX;
+        cam.rayDirY[x] = rayDirY;
+        cam.deltaDistX[x] = (rayDirX == 0) ? 1e30f : fabsf(1.0f / rayDirX);
+        cam.deltaDistY[x] = (rayDirY == 0) ? 1e30f : fabsf(1.0f / rayDirY);
+        cam.stepX[x] = (rayDirX < 0) ? -1 : 1;
+        cam.stepY[x] = (rayDirY < 0) ? -1 : 1;
+
+        int rayDirXFixed = dirX + (int)(((int64_t)planeX * cameraX_fixed) >> FIXED_SHIFT);
+        int rayDirYFixed = dirY + (int)(((int64_t)planeY * cameraX_fixed) >> FIXED_SHIFT);
+        cam.rayDirXFixed[x] = rayDirXFixed;
+        cam.rayDirYFixed[x] = rayDirYFixed;
+        cam.deltaDistXFixed[x] = fixed_delta_dist(rayDirXFixed);
+        cam.deltaDistYFixed[x] = fixed_delta_dist(rayDirYFixed);
+    }
+
+    int horizon = height / 2 + state.pitch;
+    if (horizon < 0)
+        horizon = 0;
+    if (horizon > height)
+        horizon = height;
+    cam.horizon = horizon;
+
+    for (int y = 0; y < height; y++) {
+        int p = y - horizon;
+        if (p <= 0)
+            p = 1;
+        cam.rowDist[y] = (0.5f * height) / p;
+    }
+
+    cam.invDet = 1.0f / (state.plane.x * state.dir.y - state.dir.x * state.plane.y);
+
+    float yaw = atan2f(state.dir.y, state.dir.x);
+    cam.viewAngle = yaw / (2.0f * M_PI);
+    if (cam.viewAngle < 0.0f)
+        cam.viewAngle += 1.0f;
+}
+
+void setup_camera()
+{
+    setup_camera_table(camera, SCREEN_WIDTH, SCREEN_HEIGHT);
+}
@@ -0,0 +1,53 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+// Largest frame a CameraTable can describe (benchmarks cast up to 1280 wide).
+constexpr int CAMERA_MAX_COLUMNS = 1280;
+constexpr int CAMERA_MAX_ROWS = 800;
+
+// 16.16 fixed point for the integer DDA. FIXED_FAR stands in for the
+// distance between grid lines of a ray parallel to them; it is small enough
+// that a side distance can take one more step without overflowing.
+constexpr int FIXED_SHIFT = 16;
+constexpr int FIXED_ONE = 1 << FIXED_SHIFT;
+constexpr int FIXED_FAR = 1 << 30;
+
+inline int to_fixed(float v)
+{
+    return (int)(v * FIXED_ONE);
+}
+
+// Per-frame view setup shared by every pass. Column data is kept as separate
+// 16-byte aligned arrays so packets of adjacent columns load straight into
+// SIMD registers.
+struct CameraTable {
+    alignas(16) float rayDirX[CAMERA_MAX_COLUMNS];
+    alignas(16) float rayDirY[CAMERA_MAX_COLUMNS];
+    alignas(16) float deltaDistX[CAMERA_MAX_COLUMNS];
+    alignas(16) float deltaDistY[CAMERA_MAX_COLUMNS];
+    alignas(16) int stepX[CAMERA_MAX_COLUMNS];
+    alignas(16) int stepY[CAMERA_MAX_COLUMNS];
+    // The ray directions and grid line spacing again in 16.16, worked out
+    // from the fixed camera position of each column without going through
+    // the floats above.
+    alignas(16) int rayDirXFixed[CAMERA_MAX_COLUMNS];
+    alignas(16) int rayDirYFixed[CAMERA_MAX_COLUMNS];
+    alignas(16) int deltaDistXFixed[CAMERA_MAX_COLUMNS];
+    alignas(16) int deltaDistYFixed[CAMERA_MAX_COLUMNS];
+    int width;
+
+    // Floor distance of every scanline below the horizon.
+    float rowDist[CAMERA_MAX_ROWS];
+    int height;
+    int horizon;
+
+    // Inverse of the dir/plane determinant for sprite projection.
+    float invDet;
+    // Yaw as a fraction of a full turn, used to scroll the sky.
+    float viewAngle;
+};
+
+void setup_camera_table(CameraTable& cam, int width, int height);
+void setup_camera();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,338 @@
+#include "pch.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+static const int FRAME_PIXELS = SCREEN_WIDTH * SCREEN_HEIGHT;
+
+// Single producer (the render thread) and single consumer (the writer).
+// Frames [head, tail) are queued; the producer fills ring[tail % size] and
+// the writer only releases a slot by advancing head after it is on disk.
+static std::vector<std::vector<Pixel>> ring;
+// Game frame number of each slot, so PNG names show where frames dropped.
+static std::vector<uint64_t> ringFrame;
+static std::atomic<uint64_t> head(0);
+static std::atomic<uint64_t> tail(0);
+
+static std::thread writer;
+static std::mutex lock;
+static std::condition_variable wake;
+static std::atomic<int> stopping(0);
+static int active = 0;
+
+static CaptureFormat captureFormat;
+static std::string capturePath;
+static FILE* captureFile = NULL;
+static int captureFps = 60;
+
+static uint64_t captured = 0;
+static uint64_t dropped = 0;
+static std::atomic<uint64_t> written(0);
+static int maxQueueDepth = 0;
+
+// Scratch owned by the writer thread.
+static std::vector<uint8_t> encodeBuffer;
+
+static uint32_t crcTable[256];
+
+static void init_crc_table()
+{
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        crcTable[n] = c;
+    }
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void put_be32(std::vector<uint8_t>& out, uint32_t v)
+{
+    out.push_back((uint8_t)(v >> 24));
+    out.push_back((uint8_t)(v >> 16));
+    out.push_back((uint8_t)(v >> 8));
+    out.push_back((uint8_t)v);
+}
+
+static void put_png_chunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size)
+{
+    put_be32(out, (uint32_t)size);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    put_be32(out, crc32(0, &out[start], out.size() - start));
+}
+
+// RGB PNG with the image data in stored (uncompressed) deflate blocks. It
+// costs disk space but keeps the writer cheap and free of dependencies.
+static void encode_png(const Pixel* pixels, std::vector<uint8_t>& out)
+{
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    out.assign(signature, signature + 8);
+
+    uint8_t ihdr[13] = { 0 };
+    ihdr[0] = (uint8_t)(SCREEN_WIDTH >> 24); ihdr[1] = (uint8_t)(SCREEN_WIDTH >> 16);
+    ihdr[2] = (uint8_t)(SCREEN_WIDTH >> 8);  ihdr[3] = (uint8_t)SCREEN_WIDTH;
+    ihdr[4] = (uint8_t)(SCREEN_HEIGHT >> 24); ihdr[5] = (uint8_t)(SCREEN_HEIGHT >> 16);
+    ihdr[6] = (uint8_t)(SCREEN_HEIGHT >> 8);  ihdr[7] = (uint8_t)SCREEN_HEIGHT;
+    ihdr[8] = 8;
+    ihdr[9] = 2;
+    put_png_chunk(out, "IHDR", ihdr, sizeof(ihdr));
+
+    // Scanlines: a filter byte (none) and RGB triplets.
+    std::vector<uint8_t> raw;
+    raw.reserve((size_t)SCREEN_HEIGHT * (SCREEN_WIDTH * 3 + 1));
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        raw.push_back(0);
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            Pixel p = pixels[y * SCREEN_WIDTH + x];
+            raw.push_back((uint8_t)pixel_r(p));
+            raw.push_back((uint8_t)pixel_g(p));
+            raw.push_back((uint8_t)pixel_b(p));
+        }
+    }
+
+    std::vector<uint8_t> zlib;
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    size_t pos = 0;
+    do {
+        size_t len = std::min<size_t>(raw.size() - pos, 65535);
+        zlib.push_back(pos + len == raw.size() ? 1 : 0);
+        zlib.push_back((uint8_t)len);
+        zlib.push_back((uint8_t)(len >> 8));
+        zlib.push_back((uint8_t)~len);
+        zlib.push_back((uint8_t)(~len >> 8));
+        zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+        pos += len;
+    } while (pos < raw.size());
+
+    uint32_t a = 1, b = 0;
+    for (uint8_t v : raw) {
+        a = (a + v) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_be32(zlib, (b << 16) | a);
+
+    put_png_chunk(out, "IDAT", zlib.data(), zlib.size());
+    put_png_chunk(out, "IEND", NULL, 0);
+}
+
+// Full-range BT.601 4:2:0, chroma averaged over each 2x2 block.
+static void encode_y4m_frame(const Pixel* pixels, std::vector<uint8_t>& out)
+{
+    static const char frameTag[] = "FRAME\n";
+    const int cw = (SCREEN_WIDTH + 1) / 2, ch = (SCREEN_HEIGHT + 1) / 2;
+    out.assign(frameTag, frameTag + 6);
+    size_t yPlane = out.size();
+    out.resize(yPlane + FRAME_PIXELS + 2 * cw * ch);
+    uint8_t* Y = &out[yPlane];
+    uint8_t* U = Y + FRAME_PIXELS;
+    uint8_t* V = U + cw * ch;
+
+    for (int i = 0; i < FRAME_PIXELS; i++) {
+        Pixel p = pixels[i];
+        int r = pixel_r(p), g = pixel_g(p), b = pixel_b(p);
+        Y[i] = (uint8_t)((77 * r + 150 * g + 29 * b + 128) >> 8);
+    }
+
+    for (int cy = 0; cy < ch; cy++) {
+        for (int cx = 0; cx < cw; cx++) {
+            int r = 0, g = 0, b = 0, n = 0;
+            for (int dy = 0; dy < 2; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    int x = cx * 2 + dx, y = cy * 2 + dy;
+                    if (x >= SCREEN_WIDTH || y >= SCREEN_HEIGHT)
+                        continue;
+                    Pixel p = pixels[y * SCREEN_WIDTH + x];
+                    r += pixel_r(p);
+                    g += pixel_g(p);
+                    b += pixel_b(p);
+                    n++;
+                }
+            }
+            r /= n; g /= n; b /= n;
+            U[cy * cw + cx] = (uint8_t)std::max(0, std::min(255, ((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128));
+            V[cy * cw + cx] = (uint8_t)std::max(0, std::min(255, ((128 * r - 107 * g - 21 * b + 128) >> 8) + 128));
+        }
+    }
+}
+
+static int write_frame(const Pixel* pixels, uint64_t frame)
+{
+    switch (captureFormat) {
+    case CAPTURE_RAW:
+        return fwrite(pixels, sizeof(Pixel), FRAME_PIXELS, captureFile) == (size_t)FRAME_PIXELS;
+    case CAPTURE_Y4M:
+        encode_y4m_frame(pixels, encodeBuffer);
+        return fwrite(encodeBuffer.data(), 1, encodeBuffer.size(), captureFile) == encodeBuffer.size();
+    case CAPTURE_PNG: {
+        char name[32];
+        snprintf(name, sizeof(name), "_%06llu.png", (unsigned long long)frame);
+        FILE* f = fopen((capturePath + name).c_str(), "wb");
+        if (!f)
+            return 0;
+        encode_png(pixels, encodeBuffer);
+        int ok = fwrite(encodeBuffer.data(), 1, encodeBuffer.size(), f) == encodeBuffer.size();
+        fclose(f);
+        return ok;
+    }
+    }
+    return 0;
+}
+
+static void writer_main()
+{
+    int reported = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [] { return stopping.load() || head.load() != tail.load(); });
+        }
+
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            if (stopping)
+                return;
+            continue;
+        }
+
+        size_t slot = h % ring.size();
+        if (!write_frame(ring[slot].data(), ringFrame[slot]) && !reported) {
+            std::cerr << "capture: failed to write frame " << h << std::endl;
+            reported = 1;
+        }
+        written++;
+        head.store(h + 1, std::memory_order_release);
+    }
+}
+
+int capture_start(const char* path, CaptureFormat format, int ringSize, int fps)
+{
+    capture_stop();
+    if (ringSize < 1)
+        ringSize = 1;
+
+    captureFormat = format;
+    capturePath = path;
+    captureFps = fps;
+    if (format == CAPTURE_PNG) {
+        size_t dot = capturePath.rfind(".png");
+        if (dot != std::string::npos && dot + 4 == capturePath.size())
+            capturePath.erase(dot);
+    }
+    else {
+        captureFile = fopen(path, "wb");
+        if (!captureFile) {
+            std::cerr << "err creating capture file " << path << std::endl;
+            return 0;
+        }
+        if (format == CAPTURE_Y4M)
+            fprintf(captureFile, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", SCREEN_WIDTH, SCREEN_HEIGHT, captureFps);
+    }
+
+    init_crc_table();
+    ring.assign(ringSize, std::vector<Pixel>(FRAME_PIXELS));
+    ringFrame.assign(ringSize, 0);
+    head = 0;
+    tail = 0;
+    captured = dropped = 0;
+    written = 0;
+    maxQueueDepth = 0;
+    stopping = 0;
+
+    writer = std::thread(writer_main);
+    active = 1;
+    return 1;
+}
+
+int capture_start(const char* path, int ringSize, int fps)
+{
+    std::string p = path;
+    auto ends_with = [&](const char* ext) {
+        size_t n = strlen(ext);
+        return p.size() >= n && p.compare(p.size() - n, n, ext) == 0;
+    };
+
+    if (ends_with(".png"))
+        return capture_start(path, CAPTURE_PNG, ringSize, fps);
+    if (ends_with(".y4m"))
+        return capture_start(path, CAPTURE_Y4M, ringSize, fps);
+    if (ends_with(".raw"))
+        return capture_start(path, CAPTURE_RAW, ringSize, fps);
+
+    std::cerr << "capture: unknown format for " << path << " (use .raw, .png or .y4m)" << std::endl;
+    return 0;
+}
+
+void capture_frame()
+{
+    if (!active)
+        return;
+
+    uint64_t frame = captured++;
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    int depth = (int)(t - head.load(std::memory_order_acquire));
+    if (depth >= (int)ring.size()) {
+        dropped++;
+        return;
+    }
+
+    size_t slot = t % ring.size();
+    memcpy(ring[slot].data(), state.pixels, sizeof(state.pixels));
+    ringFrame[slot] = frame;
+    tail.store(t + 1, std::memory_order_release);
+    maxQueueDepth = std::max(maxQueueDepth, depth + 1);
+
+    // The writer only holds the lock to check for work, so this is brief.
+    {
+        std::lock_guard<std::mutex> guard(lock);
+    }
+    wake.notify_one();
+}
+
+void capture_stop()
+{
+    if (!active)
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = 1;
+    }
+    wake.notify_one();
+    writer.join();
+
+    if (captureFile) {
+        fclose(captureFile);
+        captureFile = NULL;
+    }
+    active = 0;
+}
+
+int capture_active()
+{
+    return active;
+}
+
+CaptureStats capture_stats()
+{
+    CaptureStats s;
+    s.captured = captured;
+    s.written = written;
+    s.dropped = dropped;
+    s.queueDepth = active ? (int)(tail.load() - head.load()) : 0;
+    s.maxQueueDepth = maxQueueDepth;
+    return s;
+}
+
@@ -0,0 +1,43 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <cstdint>
+
+// Frames buffered between the render thread and the writer, about a
+// second of play; a slow disk drops frames instead of stalling the game.
+constexpr int CAPTURE_RING_FRAMES = 64;
+// Frame rate written into Y4M headers.
+constexpr int CAPTURE_FPS = 60;
+
+enum CaptureFormat {
+    CAPTURE_RAW,
+    CAPTURE_PNG,
+    CAPTURE_Y4M
+};
+
+struct CaptureStats {
+    uint64_t captured;
+    uint64_t written;
+    // Frames skipped because every ring buffer was still waiting to be written.
+    uint64_t dropped;
+    int queueDepth;
+    int maxQueueDepth;
+};
+
+// Starts the writer thread. RAW appends frames to one file, Y4M writes a
+// 4:2:0 stream to one file, and PNG writes path_000000.png, ... with any
+// .png extension of path stripped. ringSize buffers are allocated up front.
+int capture_start(const char* path, CaptureFormat format, int ringSize, int fps);
+// Picks the format from the extension of path (.raw, .png or .y4m).
+int capture_start(const char* path, int ringSize, int fps);
+
+// Copies state.pixels into a free ring buffer and queues it. Never waits
+// for the writer; if no buffer is free the frame is dropped and counted.
+void capture_frame();
+
+// Writes out everything still queued and stops the writer thread.
+void capture_stop();
+int capture_active();
+CaptureStats capture_stats();
+
+#endif
\ No newline at end of file
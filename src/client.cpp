@@ -0,0 +1,189 @@
+#include "pch.h"
+
+static void send_connect(NetClient* c)
+{
+    std::vector<uint8_t> out;
+    net_put_u8(out, NET_MSG_CONNECT);
+    net_put_u32(out, NET_PROTOCOL_MAGIC);
+    net_put_u32(out, NET_PROTOCOL_VERSION);
+    net_send(c->sock, c->server, out.data(), (int)out.size());
+}
+
+int client_connect(NetClient* c, uint16_t port, const uint8_t* map, int mapSize)
+{
+    c->sock = net_open(0);
+    if (c->sock == NET_INVALID_SOCKET)
+        return 0;
+
+    c->server = net_loopback(port);
+    c->id = -1;
+    c->ackTick = 0;
+    for (NetSnapshot& s : c->history) {
+        s.tick = 0;
+        s.entities.clear();
+    }
+    c->map.assign(map, map + mapSize * mapSize);
+    c->mapSize = mapSize;
+    c->bytesReceived = 0;
+    c->snapshots = 0;
+    c->missingBase = 0;
+    c->dropped = 0;
+    if (!c->dropSeed)
+        c->dropSeed = 2463534242u + port + (uint32_t)net_local_port(c->sock);
+    send_connect(c);
+    return 1;
+}
+
+void client_send_input(NetClient* c, const InputFrame& in)
+{
+    if (c->id == -1) {
+        send_connect(c);
+        return;
+    }
+    if (c->id < 0)
+        return;
+
+    std::vector<uint8_t> out;
+    net_put_u8(out, NET_MSG_INPUT);
+    net_put_u32(out, c->ackTick);
+    net_put_u16(out, in.buttons);
+    net_put_u16(out, (uint16_t)in.mouseX);
+    net_put_u16(out, (uint16_t)in.mouseY);
+    net_send(c->sock, c->server, out.data(), (int)out.size());
+}
+
+static void read_welcome(NetClient* c, NetReader& r)
+{
+    int id = net_get_u8(r);
+    uint32_t checksum = net_get_u32(r);
+    if (r.overflow || c->id >= 0)
+        return;
+    if (checksum != map_checksum(c->map.data(), c->mapSize)) {
+        std::cerr << "server is running a different map" << std::endl;
+        c->id = -2;
+        return;
+    }
+    c->id = id;
+}
+
+static void read_snapshot(NetClient* c, NetReader& r)
+{
+    static const std::vector<NetEntity> empty;
+    static std::vector<MapChange> changes;
+
+    uint32_t tick = net_get_u32(r);
+    uint32_t baseTick = net_get_u32(r);
+    if (r.overflow || tick <= c->ackTick)
+        return;
+
+    if (c->dropRate > 0.0f) {
+        c->dropSeed ^= c->dropSeed << 13;
+        c->dropSeed ^= c->dropSeed >> 17;
+        c->dropSeed ^= c->dropSeed << 5;
+        if ((c->dropSeed >> 8) * (1.0f / 16777216.0f) < c->dropRate) {
+            c->dropped++;
+            return;
+        }
+    }
+
+    const std::vector<NetEntity>* base = &empty;
+    if (baseTick) {
+        const NetSnapshot& h = c->history[baseTick % NET_SNAPSHOT_HISTORY];
+        if (h.tick != baseTick) {
+            c->missingBase++;
+            return;
+        }
+        base = &h.entities;
+    }
+
+    changes.resize(net_get_varint(r));
+    for (MapChange& m : changes) {
+        m.cell = (int)net_get_varint(r);
+        m.tile = net_get_u8(r);
+    }
+
+    // The new snapshot may land in the slot its own baseline came from.
+    static std::vector<NetEntity> entities;
+    if (!net_read_entities(r, *base, entities))
+        return;
+
+    for (const MapChange& m : changes) {
+        if (m.cell >= 0 && m.cell < (int)c->map.size())
+            c->map[m.cell] = m.tile;
+    }
+
+    NetSnapshot& slot = c->history[tick % NET_SNAPSHOT_HISTORY];
+    slot.tick = tick;
+    slot.entities.swap(entities);
+    c->ackTick = tick;
+    c->snapshots++;
+}
+
+void client_receive(NetClient* c)
+{
+    uint8_t packet[NET_MAX_PACKET];
+    NetAddress from;
+    int size;
+    while ((size = net_receive(c->sock, &from, packet, sizeof(packet))) > 0) {
+        if (!(from == c->server))
+            continue;
+        c->bytesReceived += size;
+
+        NetReader r = { packet, size, 0, 0 };
+        int type = net_get_u8(r);
+        if (type == NET_MSG_WELCOME) {
+            read_welcome(c, r);
+        }
+        else if (type == NET_MSG_REJECT) {
+            std::cerr << "server is full" << std::endl;
+            c->id = -2;
+        }
+        else if (type == NET_MSG_SNAPSHOT && c->id >= 0) {
+            read_snapshot(c, r);
+        }
+    }
+}
+
+const NetSnapshot& client_snapshot(const NetClient* c)
+{
+    return c->history[c->ackTick % NET_SNAPSHOT_HISTORY];
+}
+
+void client_disconnect(NetClient* c)
+{
+    if (c->sock == NET_INVALID_SOCKET)
+        return;
+    if (c->id >= 0) {
+        uint8_t bye = NET_MSG_DISCONNECT;
+        net_send(c->sock, c->server, &bye, 1);
+    }
+    net_close(c->sock);
+    c->sock = NET_INVALID_SOCKET;
+}
+
+static uint32_t next_random(uint32_t* seed)
+{
+    uint32_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return x;
+}
+
+InputFrame client_bot_input(ClientBot* b, int frameMs)
+{
+    if (--b->turnTicks <= 0) {
+        b->turnTicks = 15 + next_random(&b->seed) % 45;
+        b->turn = (int16_t)((int)(next_random(&b->seed) % 81) - 40);
+    }
+
+    InputFrame in = {};
+    in.frameMs = (uint16_t)frameMs;
+    in.buttons = INPUT_FORWARD;
+    in.mouseX = b->turn;
+    uint32_t r = next_random(&b->seed) % 90;
+    if (r < 3) in.buttons |= INPUT_FIRE;
+    else if (r == 3) in.buttons |= INPUT_ALT_FIRE;
+    return in;
+}
@@ -0,0 +1,53 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "input.h"
+#include "net.h"
+
+// Minimal network client: sends input and rebuilds the world from
+// snapshots into its own copy of the map. Used for loopback testing.
+struct NetClient {
+    NetSocket sock;
+    NetAddress server;
+    // Slot on the server; -1 until welcomed, -2 when refused.
+    int id;
+    // Newest snapshot decoded, echoed back so the server deltas against it.
+    uint32_t ackTick;
+    NetSnapshot history[NET_SNAPSHOT_HISTORY];
+    std::vector<uint8_t> map;
+    int mapSize;
+    uint64_t bytesReceived;
+    uint32_t snapshots;
+    // Snapshots whose baseline had already left the history.
+    uint32_t missingBase;
+    // Fraction of snapshots thrown away on arrival, to exercise recovery
+    // from packet loss on a loopback link.
+    float dropRate;
+    uint32_t dropSeed;
+    uint32_t dropped;
+};
+
+// Starts connecting to the server on this machine. map is the tile grid as
+// loaded from disk; snapshots only carry the changes made to it.
+int client_connect(NetClient* c, uint16_t port, const uint8_t* map, int mapSize);
+void client_send_input(NetClient* c, const InputFrame& in);
+// Handles every packet waiting on the socket.
+void client_receive(NetClient* c);
+const NetSnapshot& client_snapshot(const NetClient* c);
+void client_disconnect(NetClient* c);
+
+// Scripted player for loopback tests: walks forward, turns for a while,
+// and now and then shoots so objects break and rockets fly.
+struct ClientBot {
+    NetClient client;
+    uint32_t seed;
+    int turnTicks;
+    int16_t turn;
+};
+
+InputFrame client_bot_input(ClientBot* b, int frameMs);
+
+#endif
\ No newline at end of file
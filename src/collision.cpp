@@ -0,0 +1,208 @@
+#include "pch.h"
+
+// Gap kept between a circle and the wall it stopped at, so the next sweep
+// starts strictly outside.
+static const float SKIN = 1e-4f;
+static const int MAX_SLIDES = 4;
+
+// Same tiles as check_collision(), but by cell: going through a float
+// position would truncate cell -1 to cell 0.
+int player_blocks(int cellX, int cellY)
+{
+    if (cellX < 0 || cellX >= MAP_SIZE || cellY < 0 || cellY >= MAP_SIZE)
+        return 1;
+    int tile = MAPDATA[cellY * MAP_SIZE + cellX];
+    return tile != 0 && tile != 2 && tile != 3;
+}
+
+int actor_blocks(int cellX, int cellY)
+{
+    return !nav_open(cellX, cellY);
+}
+
+struct SweepHit {
+    float t;
+    float nx, ny;
+};
+
+static inline void sweep_corner(float x, float y, float dx, float dy, float r,
+                                float cornerX, float cornerY, SweepHit* best)
+{
+    float ox = x - cornerX;
+    float oy = y - cornerY;
+    float b = ox * dx + oy * dy;
+    if (b >= 0.0f)
+        return;
+
+    float a = dx * dx + dy * dy;
+    float c = ox * ox + oy * oy - r * r;
+    float disc = b * b - a * c;
+    if (disc < 0.0f)
+        return;
+
+    float t = (-b - sqrtf(disc)) / a;
+    if (t < 0.0f || t >= best->t)
+        return;
+
+    best->t = t;
+    best->nx = (ox + dx * t) / r;
+    best->ny = (oy + dy * t) / r;
+}
+
+// Earliest time in [0, best->t) at which the point (x, y) moving by (dx, dy)
+// enters the cell grown by r: four straight edges plus four corner arcs. A
+// point up to SKIN past an edge counts as on it; stopping against one wall
+// can leave it there against the next, and the next slide must not pass.
+static void sweep_cell(float x, float y, float dx, float dy, float r, int cellX, int cellY, SweepHit* best)
+{
+    float left = (float)cellX, right = cellX + 1.0f;
+    float top = (float)cellY, bottom = cellY + 1.0f;
+
+    if (dx != 0.0f) {
+        float edge = (dx > 0.0f) ? left - r : right + r;
+        float t = (edge - x) / dx;
+        if (t < 0.0f && t * fabsf(dx) > -SKIN)
+            t = 0.0f;
+        float hitY = y + dy * t;
+        if (t >= 0.0f && t < best->t && hitY >= top && hitY <= bottom) {
+            best->t = t;
+            best->nx = (dx > 0.0f) ? -1.0f : 1.0f;
+            best->ny = 0.0f;
+        }
+    }
+    if (dy != 0.0f) {
+        float edge = (dy > 0.0f) ? top - r : bottom + r;
+        float t = (edge - y) / dy;
+        if (t < 0.0f && t * fabsf(dy) > -SKIN)
+            t = 0.0f;
+        float hitX = x + dx * t;
+        if (t >= 0.0f && t < best->t && hitX >= left && hitX <= right) {
+            best->t = t;
+            best->nx = 0.0f;
+            best->ny = (dy > 0.0f) ? -1.0f : 1.0f;
+        }
+    }
+
+    sweep_corner(x, y, dx, dy, r, left, top, best);
+    sweep_corner(x, y, dx, dy, r, right, top, best);
+    sweep_corner(x, y, dx, dy, r, left, bottom, best);
+    sweep_corner(x, y, dx, dy, r, right, bottom, best);
+}
+
+int circle_blocked(float x, float y, float radius, SolidFunc solid)
+{
+    int x0 = (int)floorf(x - radius), x1 = (int)floorf(x + radius);
+    int y0 = (int)floorf(y - radius), y1 = (int)floorf(y + radius);
+    for (int cy = y0; cy <= y1; cy++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            if (!solid(cx, cy))
+                continue;
+
+            float nearX = clamp(x, (float)cx, cx + 1.0f);
+            float nearY = clamp(y, (float)cy, cy + 1.0f);
+            float ox = x - nearX, oy = y - nearY;
+            if (ox * ox + oy * oy < radius * radius)
+                return 1;
+        }
+    }
+    return 0;
+}
+
+// Pushes a circle that starts inside walls (spawned on a cell corner, or
+// shoved by a neighbour) out along the shortest way. A centre inside a wall
+// leaves through the nearest side that opens onto a free cell, or the
+// nearest side if none does. That can land it against a wall already looked
+// at, so the cells around its new place get one more pass.
+static void depenetrate(float* x, float* y, float radius, SolidFunc solid)
+{
+    static const int sideX[4] = { -1, 1, 0, 0 };
+    static const int sideY[4] = { 0, 0, -1, 1 };
+    for (int pass = 0; pass < 2; pass++) {
+        int escaped = 0;
+        int x0 = (int)floorf(*x - radius), x1 = (int)floorf(*x + radius);
+        int y0 = (int)floorf(*y - radius), y1 = (int)floorf(*y + radius);
+        for (int cy = y0; cy <= y1; cy++) {
+            for (int cx = x0; cx <= x1; cx++) {
+                if (!solid(cx, cy))
+                    continue;
+
+                float nearX = clamp(*x, (float)cx, cx + 1.0f);
+                float nearY = clamp(*y, (float)cy, cy + 1.0f);
+                float ox = *x - nearX, oy = *y - nearY;
+                float dist2 = ox * ox + oy * oy;
+                if (dist2 >= radius * radius)
+                    continue;
+
+                if (dist2 > 0.0f) {
+                    float dist = sqrtf(dist2);
+                    float push = radius - dist + SKIN;
+                    *x += ox / dist * push;
+                    *y += oy / dist * push;
+                    continue;
+                }
+
+                float gap[4] = { *x - cx, cx + 1.0f - *x, *y - cy, cy + 1.0f - *y };
+                int side = -1, nearest = 0;
+                for (int s = 0; s < 4; s++) {
+                    if (gap[s] < gap[nearest])
+                        nearest = s;
+                    if (!solid(cx + sideX[s], cy + sideY[s]) && (side < 0 || gap[s] < gap[side]))
+                        side = s;
+                }
+                if (side < 0)
+                    side = nearest;
+                if (sideX[side])
+                    *x = (sideX[side] < 0) ? cx - radius - SKIN : cx + 1.0f + radius + SKIN;
+                else
+                    *y = (sideY[side] < 0) ? cy - radius - SKIN : cy + 1.0f + radius + SKIN;
+                escaped = 1;
+            }
+        }
+        if (!escaped)
+            break;
+    }
+}
+
+int move_circle(float* x, float* y, float dx, float dy, float radius, SolidFunc solid)
+{
+    depenetrate(x, y, radius, solid);
+
+    int touched = 0;
+    for (int slide = 0; slide < MAX_SLIDES; slide++) {
+        if (dx == 0.0f && dy == 0.0f)
+            break;
+
+        // Every cell the swept circle's bounding box covers.
+        int x0 = (int)floorf(std::min(*x, *x + dx) - radius);
+        int x1 = (int)floorf(std::max(*x, *x + dx) + radius);
+        int y0 = (int)floorf(std::min(*y, *y + dy) - radius);
+        int y1 = (int)floorf(std::max(*y, *y + dy) + radius);
+
+        SweepHit hit = { 1.0f, 0.0f, 0.0f };
+        for (int cy = y0; cy <= y1; cy++) {
+            for (int cx = x0; cx <= x1; cx++) {
+                if (solid(cx, cy))
+                    sweep_cell(*x, *y, dx, dy, radius, cx, cy, &hit);
+            }
+        }
+
+        if (hit.t >= 1.0f) {
+            *x += dx;
+            *y += dy;
+            break;
+        }
+
+        touched = 1;
+        *x += dx * hit.t + hit.nx * SKIN;
+        *y += dy * hit.t + hit.ny * SKIN;
+
+        // Keep only the part of the remaining motion along the wall.
+        float restX = dx * (1.0f - hit.t);
+        float restY = dy * (1.0f - hit.t);
+        float into = restX * hit.nx + restY * hit.ny;
+        dx = restX - hit.nx * into;
+        dy = restY - hit.ny * into;
+    }
+    return touched;
+}
+
@@ -0,0 +1,21 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+// Whether a map cell stops a mover. Cells outside the map always do.
+typedef int (*SolidFunc)(int cellX, int cellY);
+
+int player_blocks(int cellX, int cellY);
+int actor_blocks(int cellX, int cellY);
+
+constexpr float PLAYER_RADIUS = 0.2f;
+
+// Moves a circle centred at (*x, *y) by (dx, dy) through the grid. The
+// motion stops at the first wall it touches and the rest of it slides along
+// that wall, for up to a few contacts. The sweep is exact for any distance,
+// so large steps cannot tunnel. Returns 1 if a wall was touched.
+int move_circle(float* x, float* y, float dx, float dy, float radius, SolidFunc solid);
+
+// Whether a circle at (x, y) overlaps a solid cell.
+int circle_blocked(float x, float y, float radius, SolidFunc solid);
+
+#endif
\ No newline at end of file
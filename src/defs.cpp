@@ -1,9 +1,10 @@
-#include "pch.h"
-
-int MAP_SIZE;
-uint8_t* MAPDATA = new uint8_t[MAP_SIZE * MAP_SIZE];
-
-std::vector<v3> bulletTrail;
-std::vector<DLight> dynamicLights;
-
-GameState state;
\ No newline at end of file
+#include "pch.h"
+
+int MAP_SIZE;
+uint8_t* MAPDATA = new uint8_t[MAP_SIZE * MAP_SIZE];
+
+BulletTrail bulletTrail;
+std::vector<DLight> dynamicLights;
+
+GameState state;
+CameraTable camera;
\ No newline at end of file
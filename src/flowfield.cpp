@@ -0,0 +1,321 @@
+#include "pch.h"
+
+FlowField flowField;
+
+// The first four neighbours are the 4-connected ones the distances are
+// measured over; the diagonals are only used when choosing a step.
+static const int neighbourX[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
+static const int neighbourY[8] = { 0, 0, 1, -1, 1, 1, -1, -1 };
+
+static inline int tile_open(int tile)
+{
+    return tile == 0 || tile == 3;
+}
+
+int nav_open(int cellX, int cellY)
+{
+    if (cellX < 0 || cellX >= MAP_SIZE || cellY < 0 || cellY >= MAP_SIZE)
+        return 0;
+    return tile_open(MAPDATA[cellY * MAP_SIZE + cellX]);
+}
+
+// Picks the neighbour with the smallest distance. Diagonal steps are only
+// taken when both cells they cut between are open, so actors never clip a
+// wall corner.
+static void compute_next(int cell)
+{
+    FlowField& f = flowField;
+    int x = cell % f.size;
+    int y = cell / f.size;
+
+    int best = -1;
+    int bestDist = f.dist[cell];
+    if (bestDist == FLOW_UNREACHABLE) {
+        f.next[cell] = -1;
+        return;
+    }
+
+    for (int n = 0; n < 8; n++) {
+        int nx = x + neighbourX[n];
+        int ny = y + neighbourY[n];
+        if (!nav_open(nx, ny))
+            continue;
+        if (n >= 4 && (!nav_open(nx, y) || !nav_open(x, ny)))
+            continue;
+
+        int d = f.dist[ny * f.size + nx];
+        if (d < bestDist) {
+            bestDist = d;
+            best = n;
+        }
+    }
+    f.next[cell] = (int8_t)best;
+}
+
+static void compute_next_around(int cell)
+{
+    FlowField& f = flowField;
+    int x = cell % f.size;
+    int y = cell / f.size;
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            int nx = x + dx, ny = y + dy;
+            if (nx >= 0 && nx < f.size && ny >= 0 && ny < f.size)
+                compute_next(ny * f.size + nx);
+        }
+    }
+}
+
+// Breadth-first relaxation from the cells in f.queue[head..], whose
+// distances are already final and non-decreasing. Extra seeds with larger
+// distances are merged in from f.seeds (sorted by distance) as the wave
+// reaches them. Every cell whose distance drops is appended to f.queue.
+static void propagate(size_t head)
+{
+    FlowField& f = flowField;
+    size_t seed = 0;
+
+    for (;;) {
+        int u;
+        if (seed < f.seeds.size()
+            && (head == f.queue.size() || f.dist[f.seeds[seed]] <= f.dist[f.queue[head]])) {
+            u = f.seeds[seed++];
+        }
+        else if (head < f.queue.size()) {
+            u = f.queue[head++];
+        }
+        else {
+            break;
+        }
+
+        int x = u % f.size;
+        int y = u / f.size;
+        int d = f.dist[u] + 1;
+        if (d > FLOW_MAX_STEPS)
+            continue;
+        for (int n = 0; n < 4; n++) {
+            int nx = x + neighbourX[n];
+            int ny = y + neighbourY[n];
+            if (!nav_open(nx, ny))
+                continue;
+
+            int v = ny * f.size + nx;
+            if (d < f.dist[v]) {
+                f.dist[v] = d;
+                f.queue.push_back(v);
+            }
+        }
+    }
+}
+
+void build_flow_field(int targetCell)
+{
+    FlowField& f = flowField;
+    int cells = MAP_SIZE * MAP_SIZE;
+    f.size = MAP_SIZE;
+    f.target = targetCell;
+    f.dist.assign(cells, FLOW_UNREACHABLE);
+    f.next.assign(cells, -1);
+    f.mark.assign(cells, 0);
+    f.queue.clear();
+    f.seeds.clear();
+
+    if (targetCell < 0 || targetCell >= cells || !nav_open(targetCell % f.size, targetCell / f.size))
+        return;
+
+    f.dist[targetCell] = 0;
+    f.queue.push_back(targetCell);
+    propagate(0);
+
+    // The search reached each cell once, so the queue lists them all.
+    for (int c : f.queue)
+        compute_next(c);
+}
+
+// Every cell the field reaches lies within FLOW_MAX_STEPS of the target on
+// both axes, so clearing that window around the old target resets the field
+// without touching the rest of the map.
+static void move_target(int targetCell)
+{
+    FlowField& f = flowField;
+    if (f.target >= 0) {
+        int tx = f.target % f.size, ty = f.target / f.size;
+        int x0 = std::max(0, tx - FLOW_MAX_STEPS), x1 = std::min(f.size - 1, tx + FLOW_MAX_STEPS);
+        int y0 = std::max(0, ty - FLOW_MAX_STEPS), y1 = std::min(f.size - 1, ty + FLOW_MAX_STEPS);
+        for (int y = y0; y <= y1; y++) {
+            std::fill(f.dist.begin() + y * f.size + x0, f.dist.begin() + y * f.size + x1 + 1, FLOW_UNREACHABLE);
+            std::fill(f.next.begin() + y * f.size + x0, f.next.begin() + y * f.size + x1 + 1, (int8_t)-1);
+        }
+    }
+    f.target = targetCell;
+    f.queue.clear();
+    f.seeds.clear();
+
+    if (targetCell < 0 || !nav_open(targetCell % f.size, targetCell / f.size))
+        return;
+
+    f.dist[targetCell] = 0;
+    f.queue.push_back(targetCell);
+    propagate(0);
+    for (int c : f.queue)
+        compute_next(c);
+}
+
+void update_flow_target(float x, float y)
+{
+    int cellX = (int)x;
+    int cellY = (int)y;
+    int target = -1;
+    if (cellX >= 0 && cellX < MAP_SIZE && cellY >= 0 && cellY < MAP_SIZE)
+        target = cellY * MAP_SIZE + cellX;
+
+    if (flowField.size != MAP_SIZE)
+        build_flow_field(target);
+    else if (flowField.target != target)
+        move_target(target);
+}
+
+// A cell opened: its distance comes from its neighbours, and any cell that
+// is now closer to the target through it is lowered by a wave outward.
+static void open_cell(int cell)
+{
+    FlowField& f = flowField;
+    int x = cell % f.size;
+    int y = cell / f.size;
+
+    int best = (cell == f.target) ? 0 : FLOW_UNREACHABLE;
+    for (int n = 0; n < 4; n++) {
+        int nx = x + neighbourX[n];
+        int ny = y + neighbourY[n];
+        if (nav_open(nx, ny))
+            best = std::min(best, f.dist[ny * f.size + nx]);
+    }
+    if (best != FLOW_UNREACHABLE && cell != f.target)
+        best++;
+    if (best > FLOW_MAX_STEPS)
+        best = FLOW_UNREACHABLE;
+    f.dist[cell] = best;
+
+    f.queue.clear();
+    f.seeds.clear();
+    if (best == FLOW_UNREACHABLE) {
+        compute_next_around(cell);
+        return;
+    }
+
+    f.queue.push_back(cell);
+    propagate(0);
+
+    for (int c : f.queue)
+        compute_next_around(c);
+}
+
+// Whether v still has a neighbour one step closer to the target that is not
+// being cleared. The region grows in order of distance, so by the time v is
+// looked at every cleared cell one step closer is already marked.
+static int has_other_parent(int v)
+{
+    FlowField& f = flowField;
+    int x = v % f.size;
+    int y = v / f.size;
+    for (int n = 0; n < 4; n++) {
+        int nx = x + neighbourX[n];
+        int ny = y + neighbourY[n];
+        if (!nav_open(nx, ny))
+            continue;
+
+        int w = ny * f.size + nx;
+        if (!f.mark[w] && f.dist[w] == f.dist[v] - 1)
+            return 1;
+    }
+    return 0;
+}
+
+// A cell closed: the cells whose every shortest route ran through it (found
+// by following +1 distance steps away from it) are cleared, then refilled by
+// a wave seeded from the untouched cells bordering that region.
+static void close_cell(int cell)
+{
+    FlowField& f = flowField;
+
+    f.region.clear();
+    f.region.push_back(cell);
+    f.mark[cell] = 1;
+    for (size_t head = 0; head < f.region.size(); head++) {
+        int u = f.region[head];
+        int x = u % f.size;
+        int y = u / f.size;
+        for (int n = 0; n < 4; n++) {
+            int nx = x + neighbourX[n];
+            int ny = y + neighbourY[n];
+            if (!nav_open(nx, ny))
+                continue;
+
+            int v = ny * f.size + nx;
+            if (!f.mark[v] && f.dist[v] == f.dist[u] + 1 && !has_other_parent(v)) {
+                f.mark[v] = 1;
+                f.region.push_back(v);
+            }
+        }
+    }
+
+    for (int u : f.region)
+        f.dist[u] = FLOW_UNREACHABLE;
+
+    f.seeds.clear();
+    for (int u : f.region) {
+        int x = u % f.size;
+        int y = u / f.size;
+        for (int n = 0; n < 4; n++) {
+            int nx = x + neighbourX[n];
+            int ny = y + neighbourY[n];
+            if (!nav_open(nx, ny))
+                continue;
+
+            int v = ny * f.size + nx;
+            if (!f.mark[v] && f.dist[v] != FLOW_UNREACHABLE) {
+                f.mark[v] = 2;
+                f.seeds.push_back(v);
+            }
+        }
+    }
+    std::sort(f.seeds.begin(), f.seeds.end(), [&](int a, int b) { return f.dist[a] < f.dist[b]; });
+
+    f.queue.clear();
+    propagate(0);
+
+    for (int v : f.seeds)
+        f.mark[v] = 0;
+    for (int u : f.region) {
+        f.mark[u] = 0;
+        compute_next_around(u);
+    }
+}
+
+void flow_field_cell_changed(int cell)
+{
+    FlowField& f = flowField;
+    if (f.size != MAP_SIZE || cell < 0 || cell >= MAP_SIZE * MAP_SIZE)
+        return;
+
+    if (cell == f.target)
+        move_target(f.target);
+    else if (nav_open(cell % f.size, cell / f.size))
+        open_cell(cell);
+    else if (f.dist[cell] != FLOW_UNREACHABLE)
+        close_cell(cell);
+    else
+        compute_next_around(cell);
+}
+
+int flow_next(int cell, int* nextCell)
+{
+    const FlowField& f = flowField;
+    int n = f.next[cell];
+    if (n < 0)
+        return 0;
+
+    *nextCell = cell + neighbourY[n] * f.size + neighbourX[n];
+    return 1;
+}
+
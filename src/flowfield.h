@@ -0,0 +1,51 @@
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include <cstdint>
+#include <vector>
+
+constexpr int FLOW_UNREACHABLE = 0x7fffffff;
+// Distances are only worked out this far from the target; cells farther away
+// count as unreachable. Actors only follow the field to ACTOR_HUNT_STEPS.
+constexpr int FLOW_MAX_STEPS = 40;
+
+// Grid distances (4-connected steps) from the map cells within FLOW_MAX_STEPS
+// of the target cell, plus the neighbour each cell should step to next.
+// Actors navigate with one lookup instead of running their own search.
+struct FlowField {
+    int size = 0;
+    int target = -1;
+    std::vector<int> dist;
+    // Index 0-7 into the neighbour table, -1 where there is no step to take.
+    std::vector<int8_t> next;
+
+    // Scratch for the searches, kept between rebuilds.
+    std::vector<int> queue;
+    std::vector<int> seeds;
+    std::vector<int> region;
+    std::vector<uint8_t> mark;
+};
+
+extern FlowField flowField;
+
+// Whether actors may stand in a cell. Unlike the player they do not walk
+// through the destructible objects (tile 2).
+int nav_open(int cellX, int cellY);
+
+void build_flow_field(int targetCell);
+// Follows the target into another cell, clearing only the window the old
+// field covered, or rebuilds the field when the map changed.
+void update_flow_target(float x, float y);
+// Repairs the field after MAPDATA[cell] changed, touching only the cells
+// whose distance can have changed.
+void flow_field_cell_changed(int cell);
+
+inline int flow_distance(int cell)
+{
+    return flowField.dist[cell];
+}
+
+// Next cell on the way to the target; returns 0 if there is none.
+int flow_next(int cell, int* nextCell);
+
+#endif
\ No newline at end of file
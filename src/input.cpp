@@ -0,0 +1,138 @@
+#include "pch.h"
+
+#include <cstdio>
+
+static const char LOG_MAGIC[4] = { 'S', 'Q', '1', 'I' };
+static const uint32_t LOG_VERSION = 1;
+
+static FILE* logFile = NULL;
+
+InputFrame poll_input(uint32_t frameMs)
+{
+    InputFrame in;
+    in.frameMs = (uint16_t)std::min<uint32_t>(frameMs, 0xffff);
+    in.buttons = 0;
+
+    const uint8_t* keystate = SDL_GetKeyboardState(NULL);
+    if (keystate[SDL_SCANCODE_W]) in.buttons |= INPUT_FORWARD;
+    if (keystate[SDL_SCANCODE_S]) in.buttons |= INPUT_BACK;
+    if (keystate[SDL_SCANCODE_A]) in.buttons |= INPUT_LEFT;
+    if (keystate[SDL_SCANCODE_D]) in.buttons |= INPUT_RIGHT;
+    if (keystate[SDL_SCANCODE_LSHIFT]) in.buttons |= INPUT_SPRINT;
+
+    int mouseX, mouseY;
+    Uint32 mouseState = SDL_GetMouseState(&mouseX, &mouseY);
+    if (mouseState & SDL_BUTTON(SDL_BUTTON_LEFT)) in.buttons |= INPUT_FIRE;
+    if (mouseState & SDL_BUTTON(SDL_BUTTON_RIGHT)) in.buttons |= INPUT_ALT_FIRE;
+
+    SDL_GetRelativeMouseState(&mouseX, &mouseY);
+    in.mouseX = (int16_t)std::max(-32768, std::min(32767, mouseX));
+    in.mouseY = (int16_t)std::max(-32768, std::min(32767, mouseY));
+    return in;
+}
+
+static void put_u16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t* p, uint32_t v)
+{
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get_u16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* p)
+{
+    return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+int open_input_recording(const char* path)
+{
+    close_input_log();
+    logFile = fopen(path, "wb");
+    if (!logFile) {
+        std::cerr << "err creating input log " << path << std::endl;
+        return 0;
+    }
+
+    uint8_t header[12];
+    memcpy(header, LOG_MAGIC, 4);
+    put_u32(header + 4, LOG_VERSION);
+    put_u32(header + 8, map_checksum(MAPDATA, MAP_SIZE));
+    if (fwrite(header, sizeof(header), 1, logFile) != 1) {
+        std::cerr << "err writing input log " << path << std::endl;
+        close_input_log();
+        return 0;
+    }
+    return 1;
+}
+
+int open_input_playback(const char* path)
+{
+    close_input_log();
+    logFile = fopen(path, "rb");
+    if (!logFile) {
+        std::cerr << "err opening input log " << path << std::endl;
+        return 0;
+    }
+
+    uint8_t header[12];
+    if (fread(header, sizeof(header), 1, logFile) != 1 || memcmp(header, LOG_MAGIC, 4) != 0
+        || get_u32(header + 4) != LOG_VERSION) {
+        std::cerr << "not an input log: " << path << std::endl;
+        close_input_log();
+        return 0;
+    }
+    if (get_u32(header + 8) != map_checksum(MAPDATA, MAP_SIZE)) {
+        std::cerr << "input log " << path << " was recorded on a different map" << std::endl;
+        close_input_log();
+        return 0;
+    }
+    return 1;
+}
+
+int record_input(const InputFrame& in)
+{
+    uint8_t rec[8];
+    put_u16(rec, in.frameMs);
+    put_u16(rec + 2, in.buttons);
+    put_u16(rec + 4, (uint16_t)in.mouseX);
+    put_u16(rec + 6, (uint16_t)in.mouseY);
+    return logFile && fwrite(rec, sizeof(rec), 1, logFile) == 1;
+}
+
+int next_input(InputFrame* in)
+{
+    uint8_t rec[8];
+    if (!logFile || fread(rec, sizeof(rec), 1, logFile) != 1)
+        return 0;
+
+    in->frameMs = get_u16(rec);
+    in->buttons = get_u16(rec + 2);
+    in->mouseX = (int16_t)get_u16(rec + 4);
+    in->mouseY = (int16_t)get_u16(rec + 6);
+    return 1;
+}
+
+void close_input_log()
+{
+    if (logFile) {
+        fclose(logFile);
+        logFile = NULL;
+    }
+}
+
+uint64_t hash_frame(uint64_t hash)
+{
+    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++)
+        hash = (hash ^ state.pixels[i]) * 1099511628211ull;
+    return hash;
+}
+
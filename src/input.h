@@ -0,0 +1,40 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <cstdint>
+
+enum InputButton {
+    INPUT_FORWARD = 1 << 0,
+    INPUT_BACK = 1 << 1,
+    INPUT_LEFT = 1 << 2,
+    INPUT_RIGHT = 1 << 3,
+    INPUT_SPRINT = 1 << 4,
+    INPUT_FIRE = 1 << 5,
+    INPUT_ALT_FIRE = 1 << 6
+};
+
+// Everything the simulation reads from the outside world in one frame,
+// including how long the frame took. Stored as 8 bytes per frame in a log.
+struct InputFrame {
+    uint16_t frameMs;
+    uint16_t buttons;
+    int16_t mouseX, mouseY;
+};
+
+// Samples the keyboard and mouse for a frame that lasted frameMs.
+InputFrame poll_input(uint32_t frameMs);
+
+// Input logs start with a header holding a checksum of the map they were
+// recorded on; playback refuses a log made on a different map.
+int open_input_recording(const char* path);
+int open_input_playback(const char* path);
+int record_input(const InputFrame& in);
+// Returns 0 once the log is exhausted.
+int next_input(InputFrame* in);
+void close_input_log();
+
+// Folds the current framebuffer into a running hash, so a recording and its
+// playback can be compared frame for frame.
+uint64_t hash_frame(uint64_t hash);
+
+#endif
\ No newline at end of file
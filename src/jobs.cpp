@@ -0,0 +1,138 @@
+#include "pch.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// One parallel_for() at a time. Workers sleep on wake until the generation
+// changes, then pull chunk indices from next until the range is exhausted.
+// A worker counts itself in busy, under the lock, for as long as it is in
+// run_chunks(), and a new job is only published once busy is back to zero,
+// so no worker still finishing the last job can see the next one's counters
+// or parameters half written.
+static std::vector<std::thread> workers;
+static std::mutex lock;
+static std::condition_variable wake;
+static std::condition_variable done;
+static int generation = 0;
+static int stopping = 0;
+static int busy = 0;
+
+static JobFunc jobFunc = NULL;
+static void* jobCtx = NULL;
+static int jobCount = 0;
+static int jobGrain = 1;
+static int jobChunks = 0;
+static std::atomic<int> nextChunk(0);
+static std::atomic<int> chunksLeft(0);
+
+static void run_chunks()
+{
+    for (;;) {
+        int chunk = nextChunk.fetch_add(1);
+        if (chunk >= jobChunks)
+            return;
+
+        int begin = chunk * jobGrain;
+        int end = std::min(begin + jobGrain, jobCount);
+        jobFunc(begin, end, jobCtx);
+
+        if (chunksLeft.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> guard(lock);
+            done.notify_all();
+        }
+    }
+}
+
+static void worker_main()
+{
+    int seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+            busy++;
+        }
+        run_chunks();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (--busy == 0)
+                done.notify_all();
+        }
+    }
+}
+
+int jobs_init(int threadCount)
+{
+    jobs_shutdown();
+
+    if (threadCount <= 0)
+        threadCount = (int)std::thread::hardware_concurrency();
+    if (threadCount <= 0)
+        threadCount = 1;
+
+    stopping = 0;
+    try {
+        for (int i = 1; i < threadCount; i++)
+            workers.emplace_back(worker_main);
+    } catch (const std::system_error& e) {
+        std::cerr << "failed to start worker thread: " << e.what() << std::endl;
+        jobs_shutdown();
+        return 0;
+    }
+    return 1;
+}
+
+void jobs_shutdown()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = 1;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers)
+        t.join();
+    workers.clear();
+}
+
+int jobs_thread_count()
+{
+    return (int)workers.size() + 1;
+}
+
+void parallel_for(int count, int grain, JobFunc fn, void* ctx)
+{
+    if (count <= 0)
+        return;
+    if (grain <= 0)
+        grain = 1;
+
+    int chunks = (count + grain - 1) / grain;
+    if (workers.empty() || chunks == 1) {
+        fn(0, count, ctx);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [] { return busy == 0; });
+        jobFunc = fn;
+        jobCtx = ctx;
+        jobCount = count;
+        jobGrain = grain;
+        jobChunks = chunks;
+        nextChunk = 0;
+        chunksLeft = chunks;
+        generation++;
+    }
+    wake.notify_all();
+
+    run_chunks();
+
+    std::unique_lock<std::mutex> guard(lock);
+    done.wait(guard, [] { return chunksLeft.load() == 0; });
+}
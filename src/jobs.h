@@ -0,0 +1,18 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+// Processes items [begin, end) of a parallel_for() range.
+typedef void (*JobFunc)(int begin, int end, void* ctx);
+
+// Starts the worker pool. threadCount counts the calling thread too; 0 picks
+// one thread per hardware core. Returns 1 on success.
+int jobs_init(int threadCount);
+void jobs_shutdown();
+int jobs_thread_count();
+
+// Splits [0, count) into chunks of at most grain items and runs fn on them
+// across the pool, the caller included. Returns once every chunk is done.
+// Without a pool the whole range runs inline.
+void parallel_for(int count, int grain, JobFunc fn, void* ctx);
+
+#endif
\ No newline at end of file
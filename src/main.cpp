@@ -1,154 +1,222 @@
-#include "pch.h"
-
-static int load_map(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "err loading map file " << filename << std::endl;
-        return 0;
-    }
-
-    std::vector<std::string> lines;
-    std::string line;
-
-    while (std::getline(file, line)) {
-        lines.push_back(line);
-    }
-
-    int mapSize = lines.size();
-    delete[] MAPDATA;
-    MAP_SIZE = mapSize;
-    MAPDATA = new uint8_t[MAP_SIZE * MAP_SIZE];
-
-    int spawnFound = 0;
-
-    for (int y = 0; y < mapSize; y++) {
-        for (int x = 0; x < mapSize; x++) {
-            if (lines[y][x] == '1') {
-                MAPDATA[y * MAP_SIZE + x] = 1;
-            }
-            else if (lines[y][x] == '2') {
-                MAPDATA[y * MAP_SIZE + x] = 2;
-            }
-            else if (lines[y][x] == '3') {
-                MAPDATA[y * MAP_SIZE + x] = 3;
-                if (!spawnFound) {
-                    state.pos = { static_cast<float>(x), static_cast<float>(y), 0 };
-                    spawnFound = 1;
-                }
-            }
-            else {
-                MAPDATA[y * MAP_SIZE + x] = 0;
-            }
-        }
-    }
-
-    return 1;
-}
-
-int main() {
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        std::cerr << "SDL_Init failed: " << SDL_GetError() << std::endl;
-        return 1;
-    }
-
-    state.window = SDL_CreateWindow("sq1",
-                                    SDL_WINDOWPOS_CENTERED,
-                                    SDL_WINDOWPOS_CENTERED,
-                                    1280, 720,
-                                    SDL_WINDOW_ALLOW_HIGHDPI);
-    if (!state.window) {
-        std::cerr << "Failed to create window: " << SDL_GetError() << std::endl;
-        SDL_Quit();
-        return 1;
-    }
-
-    int renderMethod = (USE_GPU == 1) ? SDL_RENDERER_ACCELERATED : SDL_RENDERER_SOFTWARE;
-    state.renderer = SDL_CreateRenderer(state.window, -1, renderMethod);
-    if (!state.renderer) {
-        std::cerr << "Failed to create renderer: " << SDL_GetError() << std::endl;
-        SDL_DestroyWindow(state.window);
-        SDL_Quit();
-        return 1;
-    }
-    
-    state.texture = SDL_CreateTexture(state.renderer,
-                                     SDL_PIXELFORMAT_ABGR8888,
-                                     SDL_TEXTUREACCESS_STREAMING,
-                                     SCREEN_WIDTH,
-                                     SCREEN_HEIGHT);
-    if (!state.texture) {
-        std::cerr << "Failed to create texture: " << SDL_GetError() << std::endl;
-        SDL_DestroyRenderer(state.renderer);
-        SDL_DestroyWindow(state.window);
-        SDL_Quit();
-        return 1;
-    }
-
-    state.pos = { 0.0f, 0.0f, 0 };
-    state.dir = { -1.0f, 0.0f, 0 };
-    state.plane = { 0.0f, 0.66f, 0 };
-
-    if (!load_textures()) return 1;
-    if (!load_map("map.txt")) return 1;
-
-    SDL_SetRelativeMouseMode(SDL_TRUE);
-
-    float lightX = 8.0f;
-    float lightDir = 1.0f;
-    float lightSpeed = 1.5f;
-
-    Uint32 frameStart;
-    Uint32 lastTime = SDL_GetTicks();
-    Uint32 lastFpsUpdate = lastTime;
-    int frameCount = 0;
-    float fps = 0.0f;
-
-    int quit = 0;
-    while (!quit) {
-        frameStart = SDL_GetTicks();
-        state.deltaTime = (frameStart - lastTime) / 1000.0f;
-        lastTime = frameStart;
-
-        SDL_Event ev;
-        while (SDL_PollEvent(&ev)) {
-            if (ev.type == SDL_QUIT) quit = 1;
-        }
-
-        const uint8_t* keystate = SDL_GetKeyboardState(NULL);
-        update_player(keystate);
-
-        lightX += lightDir * lightSpeed * state.deltaTime;
-        if (lightX > 12.0f) lightDir = -1.0f;
-        if (lightX < 4.0f) lightDir = 1.0f;
-
-        dynamicLights.clear();
-        add_dynamic_light(lightX, 8, 1.5f, { 255, 255, 255 }, 3.0f, CONSTANT);
-
-        memset(state.pixels, 0, sizeof(state.pixels));
-        render(state.deltaTime);
-
-        frameCount++;
-        if (frameStart - lastFpsUpdate >= 300) {
-            fps = frameCount * (1000.0f / (frameStart - lastFpsUpdate));
-            lastFpsUpdate = frameStart;
-            frameCount = 0;
-
-            std::stringstream title;
-            title << "sq1 - FPS: " << static_cast<int>(fps);
-            SDL_SetWindowTitle(state.window, title.str().c_str());
-        }
-    }
-
-    for (int i = 0; i < 1; i++) {
-        if (state.textures[i]) {
-            SDL_FreeSurface(state.textures[i]);
-        }
-    }
-
-    SDL_DestroyTexture(state.texture);
-    SDL_DestroyRenderer(state.renderer);
-    SDL_DestroyWindow(state.window);
-
-    SDL_Quit();
-    return 0;
-}
+#include "pch.h"
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--bake-pvs") == 0) {
+        const char* path = argc > 2 ? argv[2] : "map.txt";
+        if (!load_map(path)) return 1;
+        build_pvs();
+        return save_map_pvs(path) ? 0 : 1;
+    }
+
+    if (argc > 2 && strcmp(argv[1], "--bench") == 0) {
+        if (!load_map("map.txt")) return 1;
+        if (!jobs_init(0)) return 1;
+        int ok = run_bench(argv[2]);
+        jobs_shutdown();
+        return ok ? 0 : 1;
+    }
+
+    const char* recordPath = NULL;
+    const char* playPath = NULL;
+    const char* capturePath = NULL;
+    int headless = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--play") == 0 && i + 1 < argc) {
+            playPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capturePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--headless") == 0) {
+            headless = 1;
+        }
+        else if (strcmp(argv[i], "--post") == 0 && i + 1 < argc) {
+            if (!post_enable_list(argv[++i]))
+                return 1;
+        }
+        else {
+            std::cerr << "usage: sq1 [--record file | --play file [--headless]] [--capture file.raw|.png|.y4m] [--post glitch,dither] | --bench name | --bake-pvs [map]" << std::endl;
+            return 1;
+        }
+    }
+    if ((recordPath && playPath) || (headless && !playPath)) {
+        std::cerr << "--record and --play are exclusive, and --headless needs --play" << std::endl;
+        return 1;
+    }
+
+    if (SDL_Init(headless ? 0 : SDL_INIT_VIDEO) < 0) {
+        std::cerr << "SDL_Init failed: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+
+    // Headless playback simulates and renders into state.pixels but never
+    // opens a window.
+    if (!headless) {
+        state.window = SDL_CreateWindow("sq1",
+                                        SDL_WINDOWPOS_CENTERED,
+                                        SDL_WINDOWPOS_CENTERED,
+                                        1280, 720,
+                                        SDL_WINDOW_ALLOW_HIGHDPI);
+        if (!state.window) {
+            std::cerr << "Failed to create window: " << SDL_GetError() << std::endl;
+            SDL_Quit();
+            return 1;
+        }
+
+        int renderMethod = (USE_GPU == 1) ? SDL_RENDERER_ACCELERATED : SDL_RENDERER_SOFTWARE;
+        state.renderer = SDL_CreateRenderer(state.window, -1, renderMethod);
+        if (!state.renderer) {
+            std::cerr << "Failed to create renderer: " << SDL_GetError() << std::endl;
+            SDL_DestroyWindow(state.window);
+            SDL_Quit();
+            return 1;
+        }
+    
+        state.texture = SDL_CreateTexture(state.renderer,
+                                         SDL_PIXELFORMAT_ABGR8888,
+                                         SDL_TEXTUREACCESS_STREAMING,
+                                         SCREEN_WIDTH,
+                                         SCREEN_HEIGHT);
+        if (!state.texture) {
+            std::cerr << "Failed to create texture: " << SDL_GetError() << std::endl;
+            SDL_DestroyRenderer(state.renderer);
+            SDL_DestroyWindow(state.window);
+            SDL_Quit();
+            return 1;
+        }
+    }
+
+    state.pos = { 0.0f, 0.0f, 0 };
+    state.dir = { -1.0f, 0.0f, 0 };
+    state.plane = { 0.0f, 0.66f, 0 };
+
+    if (!jobs_init(0)) return 1;
+    pack_open(PACK_FILE);
+    if (!load_textures()) return 1;
+    init_renderer();
+    if (!load_map("map.txt")) return 1;
+    dynamicLights.reserve(PROJECTILE_CAPACITY + 16);
+
+    if (recordPath && !open_input_recording(recordPath)) return 1;
+    if (playPath && !open_input_playback(playPath)) return 1;
+    if (capturePath && !capture_start(capturePath, CAPTURE_RING_FRAMES, CAPTURE_FPS)) return 1;
+    // Logged sessions must see the same assets from start to end.
+    if (!recordPath && !playPath)
+        reload_start(".", "map.txt");
+    uint64_t frameHash = 1469598103934665603ull;
+    int loggedFrames = 0;
+
+    if (!headless)
+        SDL_SetRelativeMouseMode(SDL_TRUE);
+
+    float lightX = 8.0f;
+    float lightDir = 1.0f;
+    float lightSpeed = 1.5f;
+
+    Uint32 frameStart;
+    Uint32 lastTime = SDL_GetTicks();
+    Uint32 lastFpsUpdate = lastTime;
+    int frameCount = 0;
+    float fps = 0.0f;
+    size_t reloadsShown = 0;
+
+    int quit = 0;
+    while (!quit) {
+        frameStart = SDL_GetTicks();
+        Uint32 frameMs = frameStart - lastTime;
+        lastTime = frameStart;
+        reload_poll();
+
+        if (!headless) {
+            SDL_Event ev;
+            while (SDL_PollEvent(&ev)) {
+                if (ev.type == SDL_QUIT) quit = 1;
+            }
+        }
+
+        InputFrame in;
+        if (playPath) {
+            if (!next_input(&in)) break;
+        }
+        else {
+            in = poll_input(frameMs);
+        }
+        if (recordPath) record_input(in);
+
+        state.deltaTime = in.frameMs / 1000.0f;
+        update_player(in);
+        tick_actors(state.deltaTime);
+        update_projectiles(state.deltaTime);
+
+        lightX += lightDir * lightSpeed * state.deltaTime;
+        if (lightX > 12.0f) lightDir = -1.0f;
+        if (lightX < 4.0f) lightDir = 1.0f;
+
+        dynamicLights.clear();
+        add_dynamic_light(lightX, 8, 1.5f, { 255, 255, 255 }, 3.0f, CONSTANT);
+        add_projectile_lights();
+        rebuild_spatial();
+
+        render(state.deltaTime);
+        capture_frame();
+
+        if (recordPath || playPath) {
+            frameHash = hash_frame(frameHash);
+            loggedFrames++;
+        }
+
+        frameCount++;
+        if (!headless && frameStart - lastFpsUpdate >= 300) {
+            fps = frameCount * (1000.0f / (frameStart - lastFpsUpdate));
+            lastFpsUpdate = frameStart;
+            frameCount = 0;
+
+            std::stringstream title;
+            title << "sq1 - FPS: " << static_cast<int>(fps)
+                  << " - overdraw: " << std::fixed << std::setprecision(2) << profile_overdraw();
+            if (capture_active()) {
+                CaptureStats cs = capture_stats();
+                title << " - capture queue: " << cs.queueDepth << " dropped: " << cs.dropped;
+            }
+            profile_reset();
+            SDL_SetWindowTitle(state.window, title.str().c_str());
+
+            // Reported here, away from the frame that applied them.
+            ReloadStats rs = reload_stats();
+            for (size_t i = reloadsShown; i < rs.names.size(); i++)
+                printf("reloaded %s\n", rs.names[i].c_str());
+            reloadsShown = rs.names.size();
+        }
+    }
+
+    profile_report();
+    reload_stop();
+    jobs_shutdown();
+    close_input_log();
+    if (capture_active()) {
+        capture_stop();
+        CaptureStats cs = capture_stats();
+        printf("capture: %llu frames written, %llu dropped, max queue depth %d\n",
+               (unsigned long long)cs.written, (unsigned long long)cs.dropped, cs.maxQueueDepth);
+    }
+    if (recordPath || playPath) {
+        printf("%s: %d frames, frame hash %016llx\n", playPath ? "playback" : "recording",
+               loggedFrames, (unsigned long long)frameHash);
+    }
+
+    free_palette();
+    free_textures();
+    pack_close();
+
+    if (!headless) {
+        SDL_DestroyTexture(state.texture);
+        SDL_DestroyRenderer(state.renderer);
+        SDL_DestroyWindow(state.window);
+    }
+
+    SDL_Quit();
+    return 0;
+}
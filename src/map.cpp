@@ -0,0 +1,144 @@
+#include "pch.h"
+
+#include <iterator>
+
+int parse_map(std::istream& in, MapSource* out)
+{
+    std::vector<std::string> lines;
+    std::string line;
+    out->pvsText.clear();
+
+    // Rows of tiles, then optional lines starting with '#'.
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.compare(0, 5, "#pvs ") == 0)
+            out->pvsText = line.substr(5);
+        else if (line.empty() || line[0] != '#')
+            lines.push_back(line);
+    }
+    if (lines.empty())
+        return 0;
+
+    int mapSize = (int)lines.size();
+    out->size = mapSize;
+    out->tiles.assign((size_t)mapSize * mapSize, 0);
+    out->actorCells.clear();
+    out->spawnCell = -1;
+
+    // Short rows are padded with floor, in case the file is caught while
+    // an editor is still writing it.
+    for (int y = 0; y < mapSize; y++) {
+        for (int x = 0; x < mapSize && x < (int)lines[y].size(); x++) {
+            int cell = y * mapSize + x;
+            if (lines[y][x] == '1') {
+                out->tiles[cell] = 1;
+            }
+            else if (lines[y][x] == '2') {
+                out->tiles[cell] = 2;
+            }
+            else if (lines[y][x] == '4') {
+                out->actorCells.push_back(cell);
+            }
+            else if (lines[y][x] == '3') {
+                out->tiles[cell] = 3;
+                if (out->spawnCell < 0)
+                    out->spawnCell = cell;
+            }
+        }
+    }
+    return 1;
+}
+
+void apply_map(const MapSource& src, int reload)
+{
+    delete[] MAPDATA;
+    MAP_SIZE = src.size;
+    MAPDATA = new uint8_t[MAP_SIZE * MAP_SIZE];
+    memcpy(MAPDATA, src.tiles.data(), src.tiles.size());
+
+    clear_actors();
+    clear_projectiles();
+    for (int cell : src.actorCells)
+        spawn_actor(cell % MAP_SIZE + 0.5f, cell / MAP_SIZE + 0.5f);
+
+    int px = (int)state.pos.x, py = (int)state.pos.y;
+    int keepPlayer = reload && px >= 0 && py >= 0 && px < MAP_SIZE && py < MAP_SIZE &&
+                     !check_collision(state.pos.x, state.pos.y);
+    if (!keepPlayer && src.spawnCell >= 0)
+        state.pos = { static_cast<float>(src.spawnCell % MAP_SIZE), static_cast<float>(src.spawnCell / MAP_SIZE), 0 };
+
+    build_flow_field((int)state.pos.y * MAP_SIZE + (int)state.pos.x);
+    if (src.pvsText.empty() || !decode_pvs(src.pvsText)) {
+        if (reload)
+            begin_pvs_build();
+        else
+            build_pvs();
+    }
+}
+
+int load_map(const std::string& filename) {
+    std::ifstream file;
+    std::istringstream packed;
+    std::istream* in = &file;
+    if (const PackEntry* e = pack_find(filename.c_str(), PACK_TEXT)) {
+        packed.str(std::string((const char*)pack_data(e->offset), e->size));
+        in = &packed;
+    }
+    else {
+        file.open(filename);
+        if (!file.is_open()) {
+            std::cerr << "err loading map file " << filename << std::endl;
+            return 0;
+        }
+    }
+
+    MapSource src;
+    if (!parse_map(*in, &src)) {
+        std::cerr << "err parsing map file " << filename << std::endl;
+        return 0;
+    }
+    apply_map(src, 0);
+    return 1;
+}
+
+int save_map_pvs(const std::string& filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "err loading map file " << filename << std::endl;
+        return 0;
+    }
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    std::string eol = text.find("\r\n") != std::string::npos ? "\r\n" : "\n";
+    std::string out;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        std::string line = text.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        pos = (end == std::string::npos) ? text.size() : end + 1;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.compare(0, 5, "#pvs ") != 0)
+            out += line + eol;
+    }
+    out += "#pvs " + encode_pvs() + eol;
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open() || !(file << out)) {
+        std::cerr << "err writing map file " << filename << std::endl;
+        return 0;
+    }
+    return 1;
+}
+
+uint32_t map_checksum(const uint8_t* data, int size)
+{
+    uint32_t h = 2166136261u;
+    h = (h ^ (uint32_t)size) * 16777619u;
+    for (int i = 0; i < size * size; i++)
+        h = (h ^ data[i]) * 16777619u;
+    return h;
+}
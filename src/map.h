@@ -0,0 +1,37 @@
+#ifndef MAP_H
+#define MAP_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+// A map read from text but not yet in use, so it can be parsed away from
+// the render thread.
+struct MapSource {
+    int size;
+    std::vector<uint8_t> tiles;
+    std::vector<int> actorCells;
+    // First player start, -1 if the map has none.
+    int spawnCell;
+    std::string pvsText;
+};
+
+// Reads a map text file into MAPDATA, spawning actors and placing the
+// player on the first spawn tile. A copy in the open asset pack is read in
+// place of the file. The visibility set comes from the file's #pvs line
+// when it matches the tiles, and is computed otherwise.
+int load_map(const std::string& filename);
+int parse_map(std::istream& in, MapSource* out);
+// Makes src the running map and respawns its actors. A reload keeps the
+// player where they stand if that cell is still open, and rebuilds a stale
+// visibility set in slices instead of all at once.
+void apply_map(const MapSource& src, int reload);
+// Stores the current visibility set in the map file, replacing any older one.
+int save_map_pvs(const std::string& filename);
+
+// FNV-1a over a size x size tile grid, used to check that two sides of an
+// input log or a network session run on the same map.
+uint32_t map_checksum(const uint8_t* data, int size);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,313 @@
+#include "pch.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+enum EntityField {
+    FIELD_KIND = 1 << 0,
+    FIELD_X = 1 << 1,
+    FIELD_Y = 1 << 2,
+    FIELD_ANGLE = 1 << 3,
+    FIELD_PITCH = 1 << 4
+};
+
+int net_init()
+{
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        std::cerr << "WSAStartup failed" << std::endl;
+        return 0;
+    }
+#endif
+    return 1;
+}
+
+void net_shutdown()
+{
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+NetSocket net_open(uint16_t port)
+{
+    NetSocket sock = (NetSocket)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == NET_INVALID_SOCKET) {
+        std::cerr << "err creating socket" << std::endl;
+        return NET_INVALID_SOCKET;
+    }
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        std::cerr << "err binding udp port " << port << std::endl;
+        net_close(sock);
+        return NET_INVALID_SOCKET;
+    }
+
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(sock, FIONBIO, &nonBlocking);
+#else
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+    // Every client snapshot of a tick can land before anyone reads.
+    int bufferSize = 4 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char*)&bufferSize, sizeof(bufferSize));
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (const char*)&bufferSize, sizeof(bufferSize));
+    return sock;
+}
+
+void net_close(NetSocket sock)
+{
+    if (sock == NET_INVALID_SOCKET)
+        return;
+#ifdef _WIN32
+    closesocket(sock);
+#else
+    close(sock);
+#endif
+}
+
+uint16_t net_local_port(NetSocket sock)
+{
+    sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(sock, (sockaddr*)&addr, &len) != 0)
+        return 0;
+    return ntohs(addr.sin_port);
+}
+
+NetAddress net_loopback(uint16_t port)
+{
+    NetAddress a = { INADDR_LOOPBACK, port };
+    return a;
+}
+
+int net_send(NetSocket sock, const NetAddress& to, const uint8_t* data, int size)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(to.host);
+    addr.sin_port = htons(to.port);
+    return sendto(sock, (const char*)data, size, 0, (sockaddr*)&addr, sizeof(addr)) == size;
+}
+
+int net_receive(NetSocket sock, NetAddress* from, uint8_t* data, int capacity)
+{
+    sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int size = (int)recvfrom(sock, (char*)data, capacity, 0, (sockaddr*)&addr, &len);
+    if (size <= 0)
+        return 0;
+    from->host = ntohl(addr.sin_addr.s_addr);
+    from->port = ntohs(addr.sin_port);
+    return size;
+}
+
+void net_put_u8(std::vector<uint8_t>& out, uint8_t v)
+{
+    out.push_back(v);
+}
+
+void net_put_u16(std::vector<uint8_t>& out, uint16_t v)
+{
+    out.push_back((uint8_t)v);
+    out.push_back((uint8_t)(v >> 8));
+}
+
+void net_put_u32(std::vector<uint8_t>& out, uint32_t v)
+{
+    net_put_u16(out, (uint16_t)v);
+    net_put_u16(out, (uint16_t)(v >> 16));
+}
+
+void net_put_varint(std::vector<uint8_t>& out, uint32_t v)
+{
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+void net_put_svarint(std::vector<uint8_t>& out, int32_t v)
+{
+    net_put_varint(out, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+uint8_t net_get_u8(NetReader& r)
+{
+    if (r.pos >= r.size) {
+        r.overflow = 1;
+        return 0;
+    }
+    return r.data[r.pos++];
+}
+
+uint16_t net_get_u16(NetReader& r)
+{
+    uint16_t lo = net_get_u8(r);
+    return (uint16_t)(lo | (net_get_u8(r) << 8));
+}
+
+uint32_t net_get_u32(NetReader& r)
+{
+    uint32_t lo = net_get_u16(r);
+    return lo | ((uint32_t)net_get_u16(r) << 16);
+}
+
+uint32_t net_get_varint(NetReader& r)
+{
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        uint8_t b = net_get_u8(r);
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+    r.overflow = 1;
+    return 0;
+}
+
+int32_t net_get_svarint(NetReader& r)
+{
+    uint32_t v = net_get_varint(r);
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static int changed_fields(const NetEntity& from, const NetEntity& to)
+{
+    int mask = 0;
+    if (from.kind != to.kind) mask |= FIELD_KIND;
+    if (from.x != to.x) mask |= FIELD_X;
+    if (from.y != to.y) mask |= FIELD_Y;
+    if (from.angle != to.angle) mask |= FIELD_ANGLE;
+    if (from.pitch != to.pitch) mask |= FIELD_PITCH;
+    return mask;
+}
+
+// Deltas are taken against a zeroed entity when there is no baseline, so
+// new entities use the same encoding as changed ones.
+static void write_fields(std::vector<uint8_t>& out, const NetEntity& from, const NetEntity& to, int mask)
+{
+    net_put_u8(out, (uint8_t)mask);
+    if (mask & FIELD_KIND) net_put_u8(out, to.kind);
+    if (mask & FIELD_X) net_put_svarint(out, to.x - from.x);
+    if (mask & FIELD_Y) net_put_svarint(out, to.y - from.y);
+    if (mask & FIELD_ANGLE) net_put_svarint(out, (int16_t)(to.angle - from.angle));
+    if (mask & FIELD_PITCH) net_put_svarint(out, to.pitch - from.pitch);
+}
+
+static void read_fields(NetReader& r, NetEntity* e)
+{
+    int mask = net_get_u8(r);
+    if (mask & FIELD_KIND) e->kind = net_get_u8(r);
+    if (mask & FIELD_X) e->x += net_get_svarint(r);
+    if (mask & FIELD_Y) e->y += net_get_svarint(r);
+    if (mask & FIELD_ANGLE) e->angle = (uint16_t)(e->angle + net_get_svarint(r));
+    if (mask & FIELD_PITCH) e->pitch = (int16_t)(e->pitch + net_get_svarint(r));
+}
+
+void net_write_entities(std::vector<uint8_t>& out, const std::vector<NetEntity>& base,
+                        const std::vector<NetEntity>& cur)
+{
+    static const NetEntity zero = { 0, 0, 0, 0, 0, 0 };
+
+    // Removed ids, gap coded.
+    std::vector<uint16_t> removed;
+    size_t b = 0, c = 0;
+    while (b < base.size()) {
+        while (c < cur.size() && cur[c].id < base[b].id)
+            c++;
+        if (c == cur.size() || cur[c].id != base[b].id)
+            removed.push_back(base[b].id);
+        b++;
+    }
+    net_put_varint(out, (uint32_t)removed.size());
+    int prev = -1;
+    for (uint16_t id : removed) {
+        net_put_varint(out, (uint32_t)(id - prev - 1));
+        prev = id;
+    }
+
+    // New and changed entities. The count is patched in afterwards so the
+    // merge only runs once.
+    size_t countAt = out.size();
+    net_put_u16(out, 0);
+    int changed = 0;
+    prev = -1;
+    b = 0;
+    for (c = 0; c < cur.size(); c++) {
+        while (b < base.size() && base[b].id < cur[c].id)
+            b++;
+        const NetEntity& from = (b < base.size() && base[b].id == cur[c].id) ? base[b] : zero;
+        int mask = changed_fields(from, cur[c]);
+        if (&from != &zero && mask == 0)
+            continue;
+        if (&from == &zero)
+            mask |= FIELD_KIND;
+        net_put_varint(out, (uint32_t)(cur[c].id - prev - 1));
+        write_fields(out, from, cur[c], mask);
+        prev = cur[c].id;
+        changed++;
+    }
+    out[countAt] = (uint8_t)changed;
+    out[countAt + 1] = (uint8_t)(changed >> 8);
+}
+
+int net_read_entities(NetReader& r, const std::vector<NetEntity>& base, std::vector<NetEntity>& out)
+{
+    std::vector<uint16_t> removed(net_get_varint(r) & 0xffff);
+    int prev = -1;
+    for (uint16_t& id : removed) {
+        id = (uint16_t)(prev + 1 + (int)net_get_varint(r));
+        prev = id;
+    }
+
+    out.clear();
+    size_t b = 0, rm = 0;
+    int changed = net_get_u16(r);
+    prev = -1;
+    for (int i = 0; i <= changed && !r.overflow; i++) {
+        // Past the last change the remaining base entities are carried over.
+        int id = 0x10000;
+        if (i < changed) {
+            id = prev + 1 + (int)net_get_varint(r);
+            prev = id;
+        }
+
+        for (; b < base.size() && base[b].id < id; b++) {
+            while (rm < removed.size() && removed[rm] < base[b].id)
+                rm++;
+            if (rm < removed.size() && removed[rm] == base[b].id)
+                continue;
+            out.push_back(base[b]);
+        }
+        if (i == changed)
+            break;
+
+        NetEntity e = { (uint16_t)id, 0, 0, 0, 0, 0 };
+        if (b < base.size() && base[b].id == id) {
+            e = base[b];
+            b++;
+        }
+        read_fields(r, &e);
+        out.push_back(e);
+    }
+    return !r.overflow;
+}
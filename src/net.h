@@ -0,0 +1,121 @@
+#ifndef NET_H
+#define NET_H
+
+#include <cstdint>
+#include <vector>
+
+constexpr uint16_t NET_DEFAULT_PORT = 26000;
+constexpr uint32_t NET_PROTOCOL_MAGIC = 0x4e315153; // "SQ1N"
+constexpr uint32_t NET_PROTOCOL_VERSION = 1;
+// Snapshots go out as single datagrams; anything larger is not sent.
+constexpr int NET_MAX_PACKET = 65507;
+// Sent snapshots each side remembers to delta against.
+constexpr int NET_SNAPSHOT_HISTORY = 32;
+// Positions travel in 1/256ths of a cell.
+constexpr float NET_POS_SCALE = 256.0f;
+
+#ifdef _WIN32
+typedef uintptr_t NetSocket;
+#else
+typedef int NetSocket;
+#endif
+constexpr NetSocket NET_INVALID_SOCKET = (NetSocket)-1;
+
+// IPv4 address and port, both in host byte order.
+struct NetAddress {
+    uint32_t host;
+    uint16_t port;
+};
+
+inline bool operator==(const NetAddress& a, const NetAddress& b)
+{
+    return a.host == b.host && a.port == b.port;
+}
+
+enum NetMessage {
+    NET_MSG_CONNECT = 1,
+    NET_MSG_WELCOME,
+    NET_MSG_REJECT,
+    NET_MSG_INPUT,
+    NET_MSG_SNAPSHOT,
+    NET_MSG_DISCONNECT
+};
+
+enum NetEntityKind {
+    NET_ENTITY_PLAYER,
+    NET_ENTITY_PROJECTILE
+};
+
+// Replicated entity state, quantized on the server so both sides compare
+// and reproduce exactly the same values.
+struct NetEntity {
+    uint16_t id;
+    uint8_t kind;
+    int32_t x, y;
+    // 65536 steps per turn.
+    uint16_t angle;
+    int16_t pitch;
+};
+
+inline bool operator==(const NetEntity& a, const NetEntity& b)
+{
+    return a.id == b.id && a.kind == b.kind && a.x == b.x && a.y == b.y &&
+           a.angle == b.angle && a.pitch == b.pitch;
+}
+
+// Entities are kept sorted by id so two snapshots diff in one merge pass.
+struct NetSnapshot {
+    uint32_t tick;
+    std::vector<NetEntity> entities;
+};
+
+struct MapChange {
+    uint32_t tick;
+    int cell;
+    uint8_t tile;
+};
+
+// Little-endian byte stream. Reads past the end return zeros and set
+// overflow, so a truncated packet is detected once at the end.
+struct NetReader {
+    const uint8_t* data;
+    int size;
+    int pos;
+    int overflow;
+};
+
+int net_init();
+void net_shutdown();
+
+// Opens a non-blocking UDP socket bound to port on every interface, or to
+// an ephemeral port when port is 0. Returns NET_INVALID_SOCKET on failure.
+NetSocket net_open(uint16_t port);
+void net_close(NetSocket sock);
+uint16_t net_local_port(NetSocket sock);
+NetAddress net_loopback(uint16_t port);
+int net_send(NetSocket sock, const NetAddress& to, const uint8_t* data, int size);
+// Returns the datagram size, or 0 when nothing is waiting.
+int net_receive(NetSocket sock, NetAddress* from, uint8_t* data, int capacity);
+
+void net_put_u8(std::vector<uint8_t>& out, uint8_t v);
+void net_put_u16(std::vector<uint8_t>& out, uint16_t v);
+void net_put_u32(std::vector<uint8_t>& out, uint32_t v);
+void net_put_varint(std::vector<uint8_t>& out, uint32_t v);
+// Zigzag-encoded so small negative deltas stay small.
+void net_put_svarint(std::vector<uint8_t>& out, int32_t v);
+
+uint8_t net_get_u8(NetReader& r);
+uint16_t net_get_u16(NetReader& r);
+uint32_t net_get_u32(NetReader& r);
+uint32_t net_get_varint(NetReader& r);
+int32_t net_get_svarint(NetReader& r);
+
+// Writes cur as a delta against base: ids that disappeared, then only the
+// fields that changed for each new or modified entity. Unchanged entities
+// cost nothing. An empty base gives a full snapshot.
+void net_write_entities(std::vector<uint8_t>& out, const std::vector<NetEntity>& base,
+                        const std::vector<NetEntity>& cur);
+// Rebuilds the entity list from base and a delta written by the above.
+int net_read_entities(NetReader& r, const std::vector<NetEntity>& base, std::vector<NetEntity>& out);
+
+#endif
\ No newline at end of file
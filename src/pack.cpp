@@ -0,0 +1,249 @@
+#include "pch.h"
+
+#include <iterator>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "stb_image.h"
+
+static const uint8_t* packData = NULL;
+static size_t packSize = 0;
+#ifdef _WIN32
+static HANDLE packFile = INVALID_HANDLE_VALUE;
+static HANDLE packMapping = NULL;
+#endif
+
+static const PackHeader* pack_header()
+{
+    return (const PackHeader*)packData;
+}
+
+static const PackEntry* pack_entries()
+{
+    return (const PackEntry*)(packData + sizeof(PackHeader));
+}
+
+static int in_pack(uint64_t offset, uint64_t size)
+{
+    return offset % TEXTURE_ALIGN == 0 && offset + size <= packSize;
+}
+
+// Checks every offset once so lookups can trust the table afterwards.
+static int validate_pack()
+{
+    if (packSize < sizeof(PackHeader))
+        return 0;
+    const PackHeader* h = pack_header();
+    if (h->magic != PACK_MAGIC || h->version != PACK_VERSION)
+        return 0;
+    if (sizeof(PackHeader) + (uint64_t)h->entryCount * sizeof(PackEntry) > packSize)
+        return 0;
+
+    for (uint32_t i = 0; i < h->entryCount; i++) {
+        const PackEntry& e = pack_entries()[i];
+        if (memchr(e.name, 0, PACK_NAME_LENGTH) == NULL)
+            return 0;
+        if (e.type == PACK_TEXT && !in_pack(e.offset, e.size))
+            return 0;
+        if (e.type != PACK_TEXTURE)
+            continue;
+        if (e.levels < 1 || e.levels > PACK_MAX_LEVELS || e.width == 0 || e.height == 0)
+            return 0;
+        for (uint32_t l = 0; l < e.levels; l++) {
+            uint64_t bytes = (uint64_t)std::max(1u, e.width >> l) * std::max(1u, e.height >> l) * 4;
+            if (!in_pack(e.rowOffset[l], bytes) || !in_pack(e.columnOffset[l], bytes))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+int pack_open(const char* path)
+{
+    pack_close();
+
+#ifdef _WIN32
+    packFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (packFile == INVALID_HANDLE_VALUE)
+        return 0;
+    LARGE_INTEGER size;
+    GetFileSizeEx(packFile, &size);
+    packSize = (size_t)size.QuadPart;
+    packMapping = CreateFileMappingA(packFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (packMapping)
+        packData = (const uint8_t*)MapViewOfFile(packMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        packSize = (size_t)st.st_size;
+        void* p = mmap(NULL, packSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        packData = (p == MAP_FAILED) ? NULL : (const uint8_t*)p;
+    }
+    close(fd);
+#endif
+
+    if (!packData || !validate_pack()) {
+        std::cerr << "err reading pack " << path << ", using loose assets" << std::endl;
+        pack_close();
+        return 0;
+    }
+    return 1;
+}
+
+void pack_close()
+{
+#ifdef _WIN32
+    if (packData)
+        UnmapViewOfFile(packData);
+    if (packMapping)
+        CloseHandle(packMapping);
+    if (packFile != INVALID_HANDLE_VALUE)
+        CloseHandle(packFile);
+    packMapping = NULL;
+    packFile = INVALID_HANDLE_VALUE;
+#else
+    if (packData)
+        munmap((void*)packData, packSize);
+#endif
+    packData = NULL;
+    packSize = 0;
+}
+
+int pack_is_open()
+{
+    return packData != NULL;
+}
+
+const PackEntry* pack_find(const char* name, uint32_t type)
+{
+    if (!packData)
+        return NULL;
+    for (uint32_t i = 0; i < pack_header()->entryCount; i++) {
+        const PackEntry* e = &pack_entries()[i];
+        if (e->type == type && strcmp(e->name, name) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+const uint8_t* pack_data(uint32_t offset)
+{
+    return packData + offset;
+}
+
+static uint32_t append_aligned(std::vector<uint8_t>& out, const void* data, size_t size)
+{
+    out.resize((out.size() + TEXTURE_ALIGN - 1) & ~(size_t)(TEXTURE_ALIGN - 1));
+    uint32_t offset = (uint32_t)out.size();
+    out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+    return offset;
+}
+
+static PackEntry make_entry(const std::string& name, uint32_t type)
+{
+    PackEntry e;
+    memset(&e, 0, sizeof(e));
+    strncpy(e.name, name.c_str(), PACK_NAME_LENGTH - 1);
+    e.type = type;
+    return e;
+}
+
+int pack_write(const char* path, const std::vector<std::string>& textures, const std::vector<std::string>& texts)
+{
+    std::vector<std::string> names = textures;
+    names.insert(names.end(), texts.begin(), texts.end());
+    for (const std::string& name : names) {
+        if (name.size() >= (size_t)PACK_NAME_LENGTH) {
+            std::cerr << "err packing " << name << ": name too long" << std::endl;
+            return 0;
+        }
+    }
+
+    std::vector<PackEntry> entries;
+    std::vector<uint8_t> blob;
+    // Blob offsets are relative until the table size is known; the table is
+    // padded so that shifting them keeps the alignment.
+    size_t tableSize = sizeof(PackHeader) + names.size() * sizeof(PackEntry);
+    size_t base = (tableSize + TEXTURE_ALIGN - 1) & ~(size_t)(TEXTURE_ALIGN - 1);
+
+    for (const std::string& name : textures) {
+        int w, h, channels;
+        uint8_t* pixels = stbi_load(name.c_str(), &w, &h, &channels, 4);
+        if (!pixels) {
+            std::cerr << "err loading: " << name << " " << stbi_failure_reason() << std::endl;
+            return 0;
+        }
+
+        PackEntry e = make_entry(name, PACK_TEXTURE);
+        e.width = w;
+        e.height = h;
+        e.levels = texture_level_count(w, h);
+
+        std::vector<uint32_t> level((const uint32_t*)pixels, (const uint32_t*)pixels + (size_t)w * h);
+        stbi_image_free(pixels);
+        std::vector<uint32_t> columns, next;
+        for (uint32_t l = 0; l < e.levels; l++) {
+            int lw = std::max(1, w >> l), lh = std::max(1, h >> l);
+            columns.resize(level.size());
+            transpose_texture(level.data(), lw, lh, columns.data());
+            e.rowOffset[l] = append_aligned(blob, level.data(), level.size() * 4);
+            e.columnOffset[l] = append_aligned(blob, columns.data(), columns.size() * 4);
+            if (l + 1 < e.levels) {
+                next.resize((size_t)std::max(1, lw >> 1) * std::max(1, lh >> 1));
+                downsample_texture(level.data(), lw, lh, next.data());
+                level.swap(next);
+            }
+        }
+        entries.push_back(e);
+    }
+
+    for (const std::string& name : texts) {
+        std::ifstream file(name, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "err loading " << name << std::endl;
+            return 0;
+        }
+        std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        PackEntry e = make_entry(name, PACK_TEXT);
+        e.offset = append_aligned(blob, text.data(), text.size());
+        e.size = (uint32_t)text.size();
+        entries.push_back(e);
+    }
+
+    if (base + blob.size() > 0xffffffffu) {
+        std::cerr << "err packing: archive over 4 GB" << std::endl;
+        return 0;
+    }
+    for (PackEntry& e : entries) {
+        if (e.type == PACK_TEXT)
+            e.offset += (uint32_t)base;
+        for (uint32_t l = 0; l < e.levels; l++) {
+            e.rowOffset[l] += (uint32_t)base;
+            e.columnOffset[l] += (uint32_t)base;
+        }
+    }
+
+    PackHeader header = { PACK_MAGIC, PACK_VERSION, (uint32_t)entries.size(), 0 };
+    std::vector<uint8_t> out(base, 0);
+    memcpy(out.data(), &header, sizeof(header));
+    memcpy(out.data() + sizeof(header), entries.data(), entries.size() * sizeof(PackEntry));
+    out.insert(out.end(), blob.begin(), blob.end());
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open() || !file.write((const char*)out.data(), out.size())) {
+        std::cerr << "err writing pack " << path << std::endl;
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,56 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+constexpr uint32_t PACK_MAGIC = 0x50315153; // "SQ1P"
+constexpr uint32_t PACK_VERSION = 2;
+constexpr const char* PACK_FILE = "sq1.pak";
+constexpr int PACK_NAME_LENGTH = 32;
+constexpr int PACK_MAX_LEVELS = 12;
+
+enum PackEntryType {
+    PACK_TEXTURE = 1,
+    // A text file stored as is, such as the map or the texture manifest.
+    PACK_TEXT
+};
+
+// The archive is used in place once mapped, so these structs are its file
+// layout. Offsets count from the start of the file and are multiples of
+// TEXTURE_ALIGN, which keeps every texture level aligned in memory.
+struct PackHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+struct PackEntry {
+    char name[PACK_NAME_LENGTH];
+    uint32_t type;
+    // Text entries only use offset and size.
+    uint32_t offset;
+    uint32_t size;
+    uint32_t width, height;
+    uint32_t levels;
+    // ABGR8888 texels of each mip level, by rows and by columns.
+    uint32_t rowOffset[PACK_MAX_LEVELS];
+    uint32_t columnOffset[PACK_MAX_LEVELS];
+};
+
+// Maps an archive written by pack_write. Returns 0 without a message when
+// the file does not exist, so the loose assets are used instead.
+int pack_open(const char* path);
+void pack_close();
+int pack_is_open();
+const PackEntry* pack_find(const char* name, uint32_t type);
+const uint8_t* pack_data(uint32_t offset);
+
+// Decodes the images, builds their mip chains and column copies, and
+// writes them with the text files into one archive.
+int pack_write(const char* path, const std::vector<std::string>& textures, const std::vector<std::string>& texts);
+
+#endif
\ No newline at end of file
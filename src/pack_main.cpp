@@ -0,0 +1,29 @@
+#include "pch.h"
+
+// Bakes the textures, their manifest and the map into one archive. Run from the assets
+// directory; the build does this whenever an asset changes.
+int main(int argc, char* argv[])
+{
+    const char* out = PACK_FILE;
+    const char* map = "map.txt";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--map") == 0 && i + 1 < argc) {
+            map = argv[++i];
+        }
+        else if (argv[i][0] != '-') {
+            out = argv[i];
+        }
+        else {
+            std::cerr << "usage: sq1_pack [--map file] [output]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!load_texture_manifest(TEXTURE_MANIFEST))
+        return 1;
+    if (!pack_write(out, texture_files(), { map, TEXTURE_MANIFEST }))
+        return 1;
+    printf("packed %d textures, %s and %s into %s (%llu bytes)\n", (int)texture_files().size(), map,
+           TEXTURE_MANIFEST, out, (unsigned long long)std::filesystem::file_size(out));
+    return 0;
+}
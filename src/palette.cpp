@@ -0,0 +1,247 @@
+#include "pch.h"
+
+Pixel palette[PALETTE_COLORS];
+
+// Texels are binned at 5 bits per channel: red in the low bits, then green
+// and blue.
+constexpr int BIN_BITS = 15;
+
+struct ColorBin {
+    uint16_t key;
+    uint32_t count;
+    uint64_t sum[3];
+};
+
+struct ColorBox {
+    int begin, end;
+    uint64_t count;
+};
+
+struct IndexedStore {
+    const TextureImage* source;
+    // Level 0 texels the copy was made from. Swapping a reloaded texture in
+    // replaces them under the same TextureImage.
+    const Pixel* texels;
+    IndexedImage image;
+    std::vector<uint8_t> data;
+};
+
+// Nearest palette entry for every binned colour.
+static uint8_t inverse[1 << BIN_BITS];
+static std::vector<IndexedStore> indexed;
+
+static inline int bin_key(Pixel pixel)
+{
+    return (pixel_r(pixel) >> 3) | ((pixel_g(pixel) >> 3) << 5) | ((pixel_b(pixel) >> 3) << 10);
+}
+
+static inline int pixel_channel(Pixel pixel, int c)
+{
+    return c == 0 ? pixel_r(pixel) : (c == 1 ? pixel_g(pixel) : pixel_b(pixel));
+}
+
+static inline int bin_channel(int key, int c)
+{
+    return (key >> (5 * c)) & 0x1F;
+}
+
+// Splits a box at the weighted median of its widest channel. Returns the
+// first bin of the upper half, or begin when the box holds a single bin.
+static int split_box(std::vector<ColorBin>& bins, const ColorBox& box)
+{
+    int lo[3] = { 31, 31, 31 }, hi[3] = { 0, 0, 0 };
+    for (int i = box.begin; i < box.end; i++) {
+        for (int c = 0; c < 3; c++) {
+            lo[c] = std::min(lo[c], bin_channel(bins[i].key, c));
+            hi[c] = std::max(hi[c], bin_channel(bins[i].key, c));
+        }
+    }
+    int axis = 0;
+    for (int c = 1; c < 3; c++) {
+        if (hi[c] - lo[c] > hi[axis] - lo[axis])
+            axis = c;
+    }
+    if (hi[axis] == lo[axis])
+        return box.begin;
+
+    std::sort(bins.begin() + box.begin, bins.begin() + box.end, [axis](const ColorBin& a, const ColorBin& b) {
+        return bin_channel(a.key, axis) < bin_channel(b.key, axis);
+    });
+    uint64_t below = 0;
+    int split = box.begin + 1;
+    for (; split < box.end - 1; split++) {
+        below += bins[split - 1].count;
+        if (below * 2 >= box.count)
+            break;
+    }
+    return split;
+}
+
+static void choose_palette(std::vector<ColorBin>& bins)
+{
+    std::vector<ColorBox> boxes;
+    uint64_t total = 0;
+    for (const ColorBin& b : bins)
+        total += b.count;
+    if (!bins.empty())
+        boxes.push_back({ 0, (int)bins.size(), total });
+
+    // The most populated box that still holds more than one colour is split
+    // until the palette is full.
+    std::vector<int> done(PALETTE_COLORS, 0);
+    while ((int)boxes.size() < PALETTE_COLORS) {
+        int pick = -1;
+        for (int i = 0; i < (int)boxes.size(); i++) {
+            if (!done[i] && boxes[i].end - boxes[i].begin > 1 && (pick < 0 || boxes[i].count > boxes[pick].count))
+                pick = i;
+        }
+        if (pick < 0)
+            break;
+
+        ColorBox box = boxes[pick];
+        int split = split_box(bins, box);
+        if (split == box.begin) {
+            done[pick] = 1;
+            continue;
+        }
+        uint64_t lower = 0;
+        for (int i = box.begin; i < split; i++)
+            lower += bins[i].count;
+        boxes[pick] = { box.begin, split, lower };
+        boxes.push_back({ split, box.end, box.count - lower });
+    }
+
+    memset(palette, 0, sizeof(palette));
+    for (int i = 0; i < (int)boxes.size(); i++) {
+        uint64_t sum[3] = { 0, 0, 0 };
+        for (int b = boxes[i].begin; b < boxes[i].end; b++) {
+            for (int c = 0; c < 3; c++)
+                sum[c] += bins[b].sum[c];
+        }
+        int mean[3];
+        for (int c = 0; c < 3; c++)
+            mean[c] = (int)((sum[c] + boxes[i].count / 2) / boxes[i].count);
+        palette[i] = pixel_rgba(mean[0], mean[1], mean[2], 255);
+    }
+    for (int i = (int)boxes.size(); i < PALETTE_COLORS; i++)
+        palette[i] = pixel_rgba(0, 0, 0, 255);
+}
+
+static void build_inverse()
+{
+    for (int key = 0; key < (1 << BIN_BITS); key++) {
+        int best = 0, bestDist = INT32_MAX;
+        for (int i = 0; i < PALETTE_COLORS; i++) {
+            int dist = 0;
+            for (int c = 0; c < 3; c++) {
+                int d = (bin_channel(key, c) << 3 | 4) - pixel_channel(palette[i], c);
+                dist += d * d;
+            }
+            if (dist < bestDist) {
+                best = i;
+                bestDist = dist;
+            }
+        }
+        inverse[key] = (uint8_t)best;
+    }
+}
+
+uint8_t palette_index(Pixel pixel)
+{
+    return inverse[bin_key(pixel)];
+}
+
+static void convert_image(IndexedStore& store, const TextureImage* image)
+{
+    const TextureMip& m = image->mips[0];
+    size_t n = (size_t)m.width * m.height;
+    store.texels = m.rows;
+    store.data.resize(2 * n);
+    uint8_t* rows = store.data.data();
+    uint8_t* columns = rows + n;
+    for (size_t p = 0; p < n; p++)
+        rows[p] = palette_index(m.rows[p]);
+    for (int y = 0; y < m.height; y++) {
+        for (int x = 0; x < m.width; x++)
+            columns[(size_t)x * m.height + y] = rows[(size_t)y * m.width + x];
+    }
+    store.image = { rows, columns, m.width, m.height };
+}
+
+int build_palette(const TextureImage* const* images, int count)
+{
+    free_palette();
+
+    std::vector<ColorBin> table(1 << BIN_BITS);
+    for (int i = 0; i < count; i++) {
+        const TextureMip& m = images[i]->mips[0];
+        for (int p = 0; p < m.width * m.height; p++) {
+            Pixel pixel = m.rows[p];
+            ColorBin& b = table[bin_key(pixel)];
+            b.count++;
+            for (int c = 0; c < 3; c++)
+                b.sum[c] += pixel_channel(pixel, c);
+        }
+    }
+    std::vector<ColorBin> bins;
+    for (int key = 0; key < (1 << BIN_BITS); key++) {
+        if (table[key].count) {
+            table[key].key = (uint16_t)key;
+            bins.push_back(table[key]);
+        }
+    }
+    if (bins.empty()) {
+        std::cerr << "no texels to build a palette from" << std::endl;
+        return 0;
+    }
+
+    choose_palette(bins);
+    build_inverse();
+
+    // Duplicates in images share one indexed copy.
+    indexed.reserve(count);
+    for (int i = 0; i < count; i++) {
+        if (indexed_image(images[i]))
+            continue;
+        indexed.push_back({ images[i], NULL, {}, {} });
+        convert_image(indexed.back(), images[i]);
+    }
+    return 1;
+}
+
+int index_image(const TextureImage* image)
+{
+    for (IndexedStore& store : indexed) {
+        if (store.source != image)
+            continue;
+        if (store.texels == image->mips[0].rows)
+            return 0;
+        convert_image(store, image);
+        return 1;
+    }
+    indexed.push_back({ image, NULL, {}, {} });
+    convert_image(indexed.back(), image);
+    return 1;
+}
+
+void free_palette()
+{
+    indexed.clear();
+}
+
+const IndexedImage* indexed_image(const TextureImage* image)
+{
+    for (const IndexedStore& store : indexed) {
+        if (store.source == image)
+            return &store.image;
+    }
+    return NULL;
+}
+
+size_t indexed_bytes()
+{
+    size_t bytes = 0;
+    for (const IndexedStore& store : indexed)
+        bytes += store.data.size();
+    return bytes;
+}
@@ -0,0 +1,43 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pixel.h"
+
+constexpr int PALETTE_COLORS = 256;
+
+struct TextureImage;
+
+// Level 0 of a texture as palette indices, stored by rows and by columns
+// like TextureMip. A quarter of the size of the 32-bit image.
+struct IndexedImage {
+    const uint8_t* rows;
+    const uint8_t* columns;
+    int width, height;
+};
+
+// Colours the indexed images refer to, as pixels with full alpha.
+extern Pixel palette[PALETTE_COLORS];
+
+// Picks one palette for all of images with a median cut over their texels,
+// then converts each image to indices. Replaces the previous palette and
+// every indexed image.
+int build_palette(const TextureImage* const* images, int count);
+void free_palette();
+// Brings the indexed copy of image up to date with its texels against the
+// current palette, for textures swapped in by a reload. Much cheaper than
+// build_palette(), but colours the palette was not built for map to the
+// nearest entry. Returns 1 if the image was converted. May move the
+// IndexedImage structs, so fetch them again afterwards.
+int index_image(const TextureImage* image);
+// Null unless image was passed to the last build_palette or index_image
+// call.
+const IndexedImage* indexed_image(const TextureImage* image);
+// Bytes held by the indexed images.
+size_t indexed_bytes();
+// Closest palette entry to pixel, at 5 bits per channel.
+uint8_t palette_index(Pixel pixel);
+
+#endif
\ No newline at end of file
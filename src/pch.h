@@ -1,16 +1,17 @@
-#ifndef PCH_H
-#define PCH_H
-
-#include <iostream>
-#include <vector>
-#include <cmath>
-#include <fstream>
-#include <sstream>
-#include <map>
-#include <algorithm>
-#include <filesystem>
-#include <sstream>
-
-#include "defs.h"
-
+#ifndef PCH_H
+#define PCH_H
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <map>
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+
+#include "defs.h"
+
 #endif
\ No newline at end of file
@@ -0,0 +1,88 @@
+#ifndef PIXEL_H
+#define PIXEL_H
+
+#include <cstdint>
+
+#include "utils.h"
+
+// Texture and framebuffer pixel: four 8-bit channels in one word, laid out
+// as SDL_PIXELFORMAT_ABGR8888, which puts red in the low byte and alpha in
+// the high one. Code that builds or takes apart a pixel goes through the
+// shifts below rather than spelling out its own.
+typedef uint32_t Pixel;
+
+constexpr int PIXEL_SHIFT_R = 0;
+constexpr int PIXEL_SHIFT_G = 8;
+constexpr int PIXEL_SHIFT_B = 16;
+constexpr int PIXEL_SHIFT_A = 24;
+constexpr Pixel PIXEL_RGB_MASK = ~((Pixel)0xFF << PIXEL_SHIFT_A);
+
+// The helpers below work on two channels at once in the 16-bit halves of
+// the word, which needs every channel on a byte boundary.
+constexpr Pixel PIXEL_EVEN_BYTES = 0x00FF00FFu;
+static_assert(PIXEL_SHIFT_R % 8 == 0 && PIXEL_SHIFT_G % 8 == 0 && PIXEL_SHIFT_B % 8 == 0 && PIXEL_SHIFT_A % 8 == 0,
+              "pixel channels must be whole bytes");
+
+constexpr Pixel pixel_rgba(int r, int g, int b, int a)
+{
+    return ((Pixel)r << PIXEL_SHIFT_R) | ((Pixel)g << PIXEL_SHIFT_G) |
+           ((Pixel)b << PIXEL_SHIFT_B) | ((Pixel)a << PIXEL_SHIFT_A);
+}
+
+// Framebuffer pixels leave alpha at zero.
+constexpr Pixel pixel_rgb(int r, int g, int b)
+{
+    return pixel_rgba(r, g, b, 0);
+}
+
+constexpr Pixel pixel_rgb(RGBA c)
+{
+    return pixel_rgba(c.r, c.g, c.b, 0);
+}
+
+constexpr int pixel_r(Pixel p) { return (p >> PIXEL_SHIFT_R) & 0xFF; }
+constexpr int pixel_g(Pixel p) { return (p >> PIXEL_SHIFT_G) & 0xFF; }
+constexpr int pixel_b(Pixel p) { return (p >> PIXEL_SHIFT_B) & 0xFF; }
+constexpr int pixel_a(Pixel p) { return (p >> PIXEL_SHIFT_A) & 0xFF; }
+
+// Every channel times mul / 256, for mul in [0, 256].
+inline Pixel pixel_scale(Pixel p, int mul)
+{
+    Pixel even = (((p & PIXEL_EVEN_BYTES) * mul) >> 8) & PIXEL_EVEN_BYTES;
+    Pixel odd = (((p >> 8) & PIXEL_EVEN_BYTES) * mul) & ~PIXEL_EVEN_BYTES;
+    return even | odd;
+}
+
+// Every channel of a + (b - a) * t / 256, for t in [0, 256], rounding
+// down. Both products share a 16-bit half without carrying out of it.
+inline Pixel pixel_lerp(Pixel a, Pixel b, int t)
+{
+    Pixel even = (((a & PIXEL_EVEN_BYTES) * (256 - t) + (b & PIXEL_EVEN_BYTES) * t) >> 8) & PIXEL_EVEN_BYTES;
+    Pixel odd = (((a >> 8) & PIXEL_EVEN_BYTES) * (256 - t) + ((b >> 8) & PIXEL_EVEN_BYTES) * t) & ~PIXEL_EVEN_BYTES;
+    return even | odd;
+}
+
+// Every channel of a + b, clamped to 255. A sum that carries into the next
+// byte turns that byte's low bit on, which is spread into a full mask.
+inline Pixel pixel_add_sat(Pixel a, Pixel b)
+{
+    Pixel even = (a & PIXEL_EVEN_BYTES) + (b & PIXEL_EVEN_BYTES);
+    Pixel odd = ((a >> 8) & PIXEL_EVEN_BYTES) + ((b >> 8) & PIXEL_EVEN_BYTES);
+    even |= ((even >> 8) & 0x00010001u) * 0xFF;
+    odd |= ((odd >> 8) & 0x00010001u) * 0xFF;
+    return (even & PIXEL_EVEN_BYTES) | ((odd & PIXEL_EVEN_BYTES) << 8);
+}
+
+// Every channel halved.
+inline Pixel pixel_half(Pixel p)
+{
+    return (p >> 1) & 0x7F7F7F7Fu;
+}
+
+// Alpha as a blend weight in [0, 256], so 255 replaces the background.
+constexpr int pixel_alpha_weight(Pixel p)
+{
+    return pixel_a(p) + (pixel_a(p) >> 7);
+}
+
+#endif
\ No newline at end of file
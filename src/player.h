@@ -1,9 +1,16 @@
-#ifndef PLAYER_H
-#define PLAYER_H
-
-#include <cstdint>
-
-int check_collision(float x, float y);
-void update_player(const uint8_t* keystate);
-
+#ifndef PLAYER_H
+#define PLAYER_H
+
+#include <cstdint>
+
+struct InputFrame;
+
+// Set while the fire buttons are held, so a shot only triggers on press.
+// The server swaps these per client along with the pose in state.
+extern int leftMouseButtonPressed;
+extern int rightMouseButtonPressed;
+
+int check_collision(float x, float y);
+void update_player(const InputFrame& in);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,291 @@
+#include "pch.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define POSTFX_SSE2 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Generators of the glitch, carried from one band of rows to the next.
+struct GlitchState {
+    uint32_t rows;
+    uint32_t lanes[4];
+    uint32_t noise;
+    // First pixel the noise has not reached yet.
+    size_t next;
+};
+
+struct PostFrame {
+    uint32_t* pixels;
+    int width, height;
+    int useSimd;
+    uint32_t seed;
+    GlitchState glitch;
+};
+
+// An effect works on a band of rows [y0, y1). Bands are handed over top to
+// bottom, and every stage in the chain sees a band before the next starts.
+struct PostStage {
+    const char* name;
+    void (*begin)(PostFrame* f);
+    void (*rows)(PostFrame* f, int y0, int y1);
+};
+
+static void glitch_begin(PostFrame* f);
+static void glitch_rows(PostFrame* f, int y0, int y1);
+static void dither_rows(PostFrame* f, int y0, int y1);
+
+static const PostStage stages[POST_EFFECT_COUNT] = {
+    { "glitch", glitch_begin, glitch_rows },
+    { "dither", NULL, dither_rows }
+};
+static int effectEnabled[POST_EFFECT_COUNT];
+static uint32_t frameSeed = 0x6d2b79f5;
+
+static const int bayer[4][4] = {
+    { 0, 32, 8, 40 },
+    { 48, 16, 56, 24 },
+    { 12, 44, 4, 36 },
+    { 60, 28, 52, 20 }
+};
+
+static inline uint32_t xorshift32(uint32_t& s)
+{
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+static inline int lowest_bit(int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, (unsigned long)mask);
+    return (int)index;
+#else
+    return __builtin_ctz((unsigned)mask);
+#endif
+}
+
+void post_enable(PostEffect effect, int enabled)
+{
+    effectEnabled[effect] = enabled;
+}
+
+int post_enabled(PostEffect effect)
+{
+    return effectEnabled[effect];
+}
+
+int post_enable_list(const char* names)
+{
+    std::stringstream ss(names);
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+        int found = 0;
+        for (int i = 0; i < POST_EFFECT_COUNT; i++) {
+            if (name == stages[i].name) {
+                effectEnabled[i] = 1;
+                found = 1;
+            }
+        }
+        if (!found) {
+            std::cerr << "unknown post effect: " << name << std::endl;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int post_tile_rows(int width)
+{
+    return std::max(1, POST_TILE_BYTES / (width * (int)sizeof(uint32_t)));
+}
+
+// Gathers the enabled stages into one chain and runs it band by band, so a
+// band is fetched from memory once and stays in cache while every stage
+// works on it.
+static void run_chain(PostFrame* f, const int* enabled, int tileRows)
+{
+    const PostStage* chain[POST_EFFECT_COUNT];
+    int length = 0;
+    for (int e = 0; e < POST_EFFECT_COUNT; e++) {
+        if (enabled[e])
+            chain[length++] = &stages[e];
+    }
+    if (length == 0)
+        return;
+
+    for (int i = 0; i < length; i++) {
+        if (chain[i]->begin)
+            chain[i]->begin(f);
+    }
+    for (int y0 = 0; y0 < f->height; y0 += tileRows) {
+        int y1 = std::min(f->height, y0 + tileRows);
+        for (int i = 0; i < length; i++)
+            chain[i]->rows(f, y0, y1);
+    }
+}
+
+void post_process(uint32_t* pixels, int width, int height)
+{
+    PostFrame f = { pixels, width, height, 1, xorshift32(frameSeed), {} };
+    run_chain(&f, effectEnabled, post_tile_rows(width));
+}
+
+void post_chain(uint32_t* pixels, int width, int height, const int* enabled, uint32_t seed, int tileRows)
+{
+    PostFrame f = { pixels, width, height, 1, seed, {} };
+    run_chain(&f, enabled, tileRows);
+}
+
+static inline uint32_t dither_pixel(uint32_t color, int offset)
+{
+    uint32_t out = 0;
+    for (int shift = 0; shift < 24; shift += 8) {
+        int c = (color >> shift) & 0xFF;
+        c += (c * offset) >> 6;
+        c = std::min(std::max(c, 0), 255);
+        out |= (uint32_t)(c & 0xE0) << shift;
+    }
+    return out;
+}
+
+static void dither_rows(PostFrame* f, int y0, int y1)
+{
+    for (int y = y0; y < y1; y++) {
+        uint32_t* row = f->pixels + (size_t)y * f->width;
+        const int* offsets = bayer[y & 3];
+        int x = 0;
+
+#ifdef POSTFX_SSE2
+        // Four pixels are one full row of the Bayer matrix, so each half of
+        // the widened register takes a fixed pair of offsets.
+        if (f->useSimd) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i keep = _mm_set1_epi32(0x00E0E0E0);
+            int d0 = offsets[0] - 31, d1 = offsets[1] - 31, d2 = offsets[2] - 31, d3 = offsets[3] - 31;
+            const __m128i offLo = _mm_set_epi16(d1, d1, d1, d1, d0, d0, d0, d0);
+            const __m128i offHi = _mm_set_epi16(d3, d3, d3, d3, d2, d2, d2, d2);
+
+            for (; x + 4 <= f->width; x += 4) {
+                __m128i p = _mm_loadu_si128((const __m128i*)(row + x));
+                __m128i lo = _mm_unpacklo_epi8(p, zero);
+                __m128i hi = _mm_unpackhi_epi8(p, zero);
+                lo = _mm_add_epi16(lo, _mm_srai_epi16(_mm_mullo_epi16(lo, offLo), 6));
+                hi = _mm_add_epi16(hi, _mm_srai_epi16(_mm_mullo_epi16(hi, offHi), 6));
+                p = _mm_and_si128(_mm_packus_epi16(lo, hi), keep);
+                _mm_storeu_si128((__m128i*)(row + x), p);
+            }
+        }
+#endif
+
+        for (; x < f->width; x++)
+            row[x] = dither_pixel(row[x], offsets[x & 3] - 31);
+    }
+}
+
+void post_dither(uint32_t* pixels, int width, int height, int useSimd)
+{
+    PostFrame f = { pixels, width, height, useSimd, 0, {} };
+    dither_rows(&f, 0, height);
+}
+
+// Colour noise for a picked pixel: the low three bytes of r give an offset
+// in [-50, 49] for each channel.
+static inline uint32_t noise_pixel(uint32_t color, uint32_t r)
+{
+    uint32_t out = color & 0xFF000000u;
+    for (int shift = 0; shift < 24; shift += 8) {
+        int noise = (int)((((r >> shift) & 0xFF) * 100) >> 8) - 50;
+        out |= (uint32_t)(((color >> shift) + noise) & 0xFF) << shift;
+    }
+    return out;
+}
+
+// Four generators pick the pixels, a fifth draws the noise for the few that
+// are picked, in pixel order. The lanes advance at the start of each block
+// of 16 pixels and then hold its words: one byte per pixel, picked when
+// below POST_GLITCH_NOISE. The scalar loop and the SSE2 lanes walk the same
+// sequences.
+static void glitch_begin(PostFrame* f)
+{
+    GlitchState& g = f->glitch;
+    g.rows = f->seed | 1;
+    for (int k = 0; k < 4; k++)
+        g.lanes[k] = (f->seed + 0x9E3779B9u * (k + 1)) | 1;
+    g.noise = (f->seed ^ 0xA511E9B3u) | 1;
+    g.next = 0;
+}
+
+static void glitch_noise_scalar(GlitchState& g, uint32_t* pixels, size_t end)
+{
+    for (; g.next < end; g.next++) {
+        int j = (int)(g.next & 15);
+        if (j == 0) {
+            for (int k = 0; k < 4; k++)
+                xorshift32(g.lanes[k]);
+        }
+        if (((g.lanes[j >> 2] >> (8 * (j & 3))) & 0xFF) < (uint32_t)POST_GLITCH_NOISE)
+            pixels[g.next] = noise_pixel(pixels[g.next], xorshift32(g.noise));
+    }
+}
+
+static void glitch_rows(PostFrame* f, int y0, int y1)
+{
+    GlitchState& g = f->glitch;
+
+    // One in five rows slides by up to ten pixels.
+    for (int y = y0; y < y1; y++) {
+        uint32_t r = xorshift32(g.rows);
+        if (r % 10 >= 2)
+            continue;
+
+        int shift = (int)((r >> 8) % 20) - 10;
+        uint32_t* row = f->pixels + (size_t)y * f->width;
+        if (shift > 0 && shift < f->width)
+            memmove(row + shift, row, (f->width - shift) * sizeof(uint32_t));
+        else if (shift < 0 && -shift < f->width)
+            memmove(row, row - shift, (f->width + shift) * sizeof(uint32_t));
+    }
+
+    size_t end = (size_t)y1 * f->width;
+
+#ifdef POSTFX_SSE2
+    if (f->useSimd) {
+        // A block cut by the end of the previous band is finished first.
+        glitch_noise_scalar(g, f->pixels, std::min(end, (g.next + 15) & ~(size_t)15));
+
+        const __m128i below = _mm_set1_epi8(POST_GLITCH_NOISE - 1);
+        __m128i s = _mm_loadu_si128((const __m128i*)g.lanes);
+        for (; g.next + 16 <= end; g.next += 16) {
+            s = _mm_xor_si128(s, _mm_slli_epi32(s, 13));
+            s = _mm_xor_si128(s, _mm_srli_epi32(s, 17));
+            s = _mm_xor_si128(s, _mm_slli_epi32(s, 5));
+
+            // Unsigned byte <= POST_GLITCH_NOISE - 1.
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(s, below), s));
+            while (mask) {
+                int j = lowest_bit(mask);
+                f->pixels[g.next + j] = noise_pixel(f->pixels[g.next + j], xorshift32(g.noise));
+                mask &= mask - 1;
+            }
+        }
+        _mm_storeu_si128((__m128i*)g.lanes, s);
+    }
+#endif
+
+    glitch_noise_scalar(g, f->pixels, end);
+}
+
+void post_glitch(uint32_t* pixels, int width, int height, uint32_t seed, int useSimd)
+{
+    PostFrame f = { pixels, width, height, useSimd, seed, {} };
+    glitch_begin(&f);
+    glitch_rows(&f, 0, height);
+}
@@ -0,0 +1,43 @@
+#ifndef POSTFX_H
+#define POSTFX_H
+
+#include <cstdint>
+
+// Full-frame effects run over the finished image before it is presented,
+// in this order.
+enum PostEffect {
+    POST_GLITCH,
+    POST_DITHER,
+    POST_EFFECT_COUNT
+};
+
+// This many pixels out of 256 get colour noise in the glitch.
+constexpr int POST_GLITCH_NOISE = 5;
+// The chain runs over bands of rows about this large, so a band stays in
+// L1 while every effect works on it.
+constexpr int POST_TILE_BYTES = 16 * 1024;
+
+void post_enable(PostEffect effect, int enabled);
+int post_enabled(PostEffect effect);
+// Enables the effects named in a comma separated list such as
+// "glitch,dither". Returns 0 on an unknown name.
+int post_enable_list(const char* names);
+// Runs every enabled effect over a width x height frame in one sweep of
+// row bands. The glitch is reseeded each call so successive frames differ.
+void post_process(uint32_t* pixels, int width, int height);
+// Rows per band for a frame width.
+int post_tile_rows(int width);
+// The chain with an explicit effect mask, glitch seed and band height.
+// Bands of height rows are the unfused form: one whole sweep per effect.
+// Any band height gives the same pixels.
+void post_chain(uint32_t* pixels, int width, int height, const int* enabled, uint32_t seed, int tileRows);
+
+// The effects on their own. useSimd 0 runs the scalar reference, which
+// gives the same pixels.
+// 4x4 Bayer dither down to 8 levels per channel.
+void post_dither(uint32_t* pixels, int width, int height, int useSimd);
+// Shifts some rows sideways and adds noise to scattered pixels, driven by
+// xorshift generators started from seed.
+void post_glitch(uint32_t* pixels, int width, int height, uint32_t seed, int useSimd);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "pch.h"
+
+static const char* zoneNames[PROF_COUNT] = { "walls", "sky", "floor", "entities", "trail", "weapon", "post", "present" };
+
+static Uint64 zoneStart[PROF_COUNT];
+static Uint64 zoneTicks[PROF_COUNT];
+static uint64_t zonePixels[PROF_COUNT];
+static int frames = 0;
+
+static Uint64 totalTicks[PROF_COUNT];
+static uint64_t totalPixels[PROF_COUNT];
+static int totalFrames = 0;
+
+void profile_begin(ProfileZone zone)
+{
+    zoneStart[zone] = SDL_GetPerformanceCounter();
+}
+
+void profile_end(ProfileZone zone)
+{
+    zoneTicks[zone] += SDL_GetPerformanceCounter() - zoneStart[zone];
+}
+
+void profile_pixels(ProfileZone zone, uint64_t count)
+{
+    zonePixels[zone] += count;
+}
+
+void profile_frame_end()
+{
+    frames++;
+}
+
+float profile_overdraw()
+{
+    if (frames == 0)
+        return 0.0f;
+
+    uint64_t written = 0;
+    for (int i = 0; i < PROF_COUNT; i++)
+        written += zonePixels[i];
+
+    return (float)written / ((float)frames * SCREEN_WIDTH * SCREEN_HEIGHT);
+}
+
+void profile_reset()
+{
+    for (int i = 0; i < PROF_COUNT; i++) {
+        totalTicks[i] += zoneTicks[i];
+        totalPixels[i] += zonePixels[i];
+        zoneTicks[i] = 0;
+        zonePixels[i] = 0;
+    }
+    totalFrames += frames;
+    frames = 0;
+}
+
+void profile_report()
+{
+    profile_reset();
+    if (totalFrames == 0)
+        return;
+
+    double freq = (double)SDL_GetPerformanceFrequency();
+    const double screenPixels = (double)SCREEN_WIDTH * SCREEN_HEIGHT;
+    double overdraw = 0.0;
+
+    printf("%-10s %10s %10s\n", "pass", "ms/frame", "writes/px");
+    for (int i = 0; i < PROF_COUNT; i++) {
+        double ms = totalTicks[i] * 1000.0 / freq / totalFrames;
+        double writes = totalPixels[i] / screenPixels / totalFrames;
+        overdraw += writes;
+        printf("%-10s %10.3f %10.3f\n", zoneNames[i], ms, writes);
+    }
+    printf("%-10s %10s %10.3f\n", "overdraw", "", overdraw);
+}
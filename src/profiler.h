@@ -0,0 +1,28 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+
+enum ProfileZone {
+    PROF_WALLS,
+    PROF_SKY,
+    PROF_FLOOR,
+    PROF_ENTITIES,
+    PROF_TRAIL,
+    PROF_WEAPON,
+    PROF_POST,
+    PROF_PRESENT,
+    PROF_COUNT
+};
+
+void profile_begin(ProfileZone zone);
+void profile_end(ProfileZone zone);
+void profile_pixels(ProfileZone zone, uint64_t count);
+void profile_frame_end();
+
+// Framebuffer writes per screen pixel, averaged since the last reset.
+float profile_overdraw();
+void profile_reset();
+void profile_report();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "pch.h"
+
+const ProjectileInfo projectileInfo[PROJECTILE_TYPE_COUNT] = {
+    // speed radius lifetime destructive light
+    { 8.0f, 0.10f, 4.0f, 1, 1.0f, { 255, 160, 60 }, 2.0f },
+    { 5.0f, 0.08f, 5.0f, 0, 0.6f, { 90, 160, 255 }, 1.0f },
+};
+
+ProjectilePool projectiles;
+
+static const int PROJECTILE_GRAIN = 512;
+
+enum ProjectileOutcome {
+    OUTCOME_FLYING,
+    OUTCOME_EXPIRED,
+    OUTCOME_WALL,
+    OUTCOME_OBJECT,
+    OUTCOME_ACTOR,
+    OUTCOME_PLAYER
+};
+
+// Per-update scratch, indexed like live[].
+static Ray pathRays[PROJECTILE_CAPACITY];
+static RayHit pathHits[PROJECTILE_CAPACITY];
+static uint8_t outcome[PROJECTILE_CAPACITY];
+static int outcomeId[PROJECTILE_CAPACITY];
+static int killedActors[PROJECTILE_CAPACITY];
+
+void clear_projectiles()
+{
+    ProjectilePool& p = projectiles;
+    for (int i = 0; i < PROJECTILE_CAPACITY; i++)
+        p.nextFree[i] = i + 1;
+    p.nextFree[PROJECTILE_CAPACITY - 1] = -1;
+    p.freeHead = 0;
+    p.liveCount = 0;
+}
+
+int spawn_projectile(int type, float x, float y, float dirX, float dirY)
+{
+    ProjectilePool& p = projectiles;
+    int slot = p.freeHead;
+    if (slot < 0)
+        return -1;
+
+    p.freeHead = p.nextFree[slot];
+    p.x[slot] = x;
+    p.y[slot] = y;
+    p.dirX[slot] = dirX;
+    p.dirY[slot] = dirY;
+    p.life[slot] = projectileInfo[type].lifetime;
+    p.type[slot] = (uint8_t)type;
+
+    p.live[p.liveCount] = slot;
+    p.liveIndex[slot] = p.liveCount;
+    p.liveCount++;
+    return slot;
+}
+
+void free_projectile(int slot)
+{
+    ProjectilePool& p = projectiles;
+    int index = p.liveIndex[slot];
+    int last = p.live[--p.liveCount];
+    p.live[index] = last;
+    p.liveIndex[last] = index;
+
+    p.nextFree[slot] = p.freeHead;
+    p.freeHead = slot;
+}
+
+// Distance along a unit ray at which it enters a circle, or -1.
+static inline float ray_enters_circle(const Ray& ray, float cx, float cy, float radius)
+{
+    float ox = cx - ray.x;
+    float oy = cy - ray.y;
+    float along = ox * ray.dirX + oy * ray.dirY;
+    float side = ox * ray.dirY - oy * ray.dirX;
+    if (side * side > radius * radius)
+        return -1.0f;
+
+    float half = sqrtf(radius * radius - side * side);
+    if (along + half < 0.0f)
+        return -1.0f;
+    return std::max(along - half, 0.0f);
+}
+
+struct ProjectileStep {
+    float dt;
+    float playerX, playerY;
+};
+
+// Traces and classifies projectiles live[begin, end). Writes only their own
+// scratch slots and positions; map and actor changes wait for the serial pass.
+static void step_projectile_range(int begin, int end, void* ctx)
+{
+    const ProjectileStep& s = *(const ProjectileStep*)ctx;
+    ProjectilePool& p = projectiles;
+
+    for (int k = begin; k < end; k++) {
+        int slot = p.live[k];
+        pathRays[k] = { p.x[slot], p.y[slot], p.dirX[slot], p.dirY[slot], projectileInfo[p.type[slot]].speed * s.dt };
+    }
+    trace_rays(&pathRays[begin], end - begin, RAY_STOP_WALLS | RAY_STOP_OBJECTS, &pathHits[begin]);
+
+    for (int k = begin; k < end; k++) {
+        int slot = p.live[k];
+        const ProjectileInfo& info = projectileInfo[p.type[slot]];
+        const Ray& ray = pathRays[k];
+        const RayHit& hit = pathHits[k];
+
+        float travel = ray.maxDist;
+        outcome[k] = OUTCOME_FLYING;
+        if (hit.hit) {
+            travel = hit.distance;
+            outcome[k] = (hit.entity >= 0) ? OUTCOME_OBJECT : OUTCOME_WALL;
+            outcomeId[k] = hit.entity;
+        }
+
+        Ray reach = ray;
+        reach.maxDist = travel;
+        if (info.destructive) {
+            float actorDist;
+            int entry = spatial_raycast(reach, SPATIAL_MASK(SPATIAL_ACTOR), &actorDist);
+            if (entry >= 0) {
+                travel = actorDist;
+                outcome[k] = OUTCOME_ACTOR;
+                outcomeId[k] = spatial.entries[entry].id;
+            }
+        }
+        else {
+            float playerDist = ray_enters_circle(reach, s.playerX, s.playerY, PLAYER_RADIUS + info.radius);
+            if (playerDist >= 0.0f && playerDist < travel) {
+                travel = playerDist;
+                outcome[k] = OUTCOME_PLAYER;
+            }
+        }
+
+        p.x[slot] += p.dirX[slot] * travel;
+        p.y[slot] += p.dirY[slot] * travel;
+        p.life[slot] -= s.dt;
+        if (outcome[k] == OUTCOME_FLYING && p.life[slot] <= 0.0f)
+            outcome[k] = OUTCOME_EXPIRED;
+    }
+}
+
+void update_projectiles(float dt)
+{
+    ProjectilePool& p = projectiles;
+    ProjectileStep s = { dt, state.pos.x, state.pos.y };
+
+    // Actor ids in the grid must match the actor arrays, which a shot may
+    // have reshuffled since the last rebuild.
+    rebuild_spatial();
+    parallel_for(p.liveCount, PROJECTILE_GRAIN, step_projectile_range, &s);
+
+    // Walk backwards so freeing a slot only moves an entry that has already
+    // been handled into the current position.
+    int killed = 0;
+    for (int k = p.liveCount - 1; k >= 0; k--) {
+        if (outcome[k] == OUTCOME_FLYING)
+            continue;
+
+        if (outcome[k] == OUTCOME_OBJECT && projectileInfo[p.type[p.live[k]]].destructive
+            && MAPDATA[outcomeId[k]] == 2) {
+            MAPDATA[outcomeId[k]] = 0;
+            flow_field_cell_changed(outcomeId[k]);
+            pvs_cell_changed(outcomeId[k]);
+        }
+        else if (outcome[k] == OUTCOME_ACTOR) {
+            killedActors[killed++] = outcomeId[k];
+        }
+        free_projectile(p.live[k]);
+    }
+
+    // Actor ids come from the grid snapshot; removing the highest first
+    // keeps the lower ones valid.
+    std::sort(killedActors, killedActors + killed, [](int a, int b) { return a > b; });
+    for (int i = 0; i < killed; i++) {
+        if (i == 0 || killedActors[i] != killedActors[i - 1])
+            remove_actor(killedActors[i]);
+    }
+}
+
+void add_projectile_lights()
+{
+    const ProjectilePool& p = projectiles;
+    for (int k = 0; k < p.liveCount; k++) {
+        int slot = p.live[k];
+        const ProjectileInfo& info = projectileInfo[p.type[slot]];
+        add_dynamic_light(p.x[slot], p.y[slot], info.lightRadius, info.lightColor, info.lightIntensity, CONSTANT);
+    }
+}
+
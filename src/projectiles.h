@@ -0,0 +1,62 @@
+#ifndef PROJECTILES_H
+#define PROJECTILES_H
+
+#include <cstdint>
+
+#include "utils.h"
+
+constexpr int PROJECTILE_CAPACITY = 16384;
+
+enum ProjectileType {
+    PROJECTILE_ROCKET,
+    PROJECTILE_BOLT,
+    PROJECTILE_TYPE_COUNT
+};
+
+struct ProjectileInfo {
+    float speed;
+    float radius;
+    float lifetime;
+    // Rockets blow up objects and actors; bolts only stop.
+    int destructive;
+    float lightRadius;
+    RGBA lightColor;
+    float lightIntensity;
+};
+
+extern const ProjectileInfo projectileInfo[PROJECTILE_TYPE_COUNT];
+
+// Fixed-capacity structure-of-arrays pool. Free slots are chained through
+// nextFree; live slots are also listed densely in live[] so updates only
+// walk what is in flight.
+struct ProjectilePool {
+    float x[PROJECTILE_CAPACITY];
+    float y[PROJECTILE_CAPACITY];
+    float dirX[PROJECTILE_CAPACITY];
+    float dirY[PROJECTILE_CAPACITY];
+    float life[PROJECTILE_CAPACITY];
+    uint8_t type[PROJECTILE_CAPACITY];
+
+    int nextFree[PROJECTILE_CAPACITY];
+    int freeHead;
+    int live[PROJECTILE_CAPACITY];
+    int liveIndex[PROJECTILE_CAPACITY];
+    int liveCount;
+};
+
+extern ProjectilePool projectiles;
+
+void clear_projectiles();
+// Returns the slot, or -1 when the pool is full.
+int spawn_projectile(int type, float x, float y, float dirX, float dirY);
+void free_projectile(int slot);
+
+// Moves every projectile by dt, hit-testing the path it covers against the
+// map and the actors. Hits are applied after the parallel part finishes.
+void update_projectiles(float dt);
+
+// Adds one light per live projectile. dynamicLights keeps its capacity
+// across frames, so this does not allocate once warmed up.
+void add_projectile_lights();
+
+#endif
\ No newline at end of file
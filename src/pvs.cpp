@@ -0,0 +1,509 @@
+#include "pch.h"
+
+#include <chrono>
+
+Pvs pvs;
+
+// Gaps between walls and the two end cells are widened by this much, so a
+// line the float DDA lets graze past a wall corner is always in the set.
+static const double LINE_EPS = 1e-3;
+// Bounds on the line sets worked with below. A pair that would need more is
+// counted as visible.
+static const int LINE_SET_VERTS = 48;
+static const int LINE_SETS = 32;
+
+// Convex set of lines v = m * u + c, as the polygon of their (m, c).
+struct LineSet {
+    int count;
+    double m[LINE_SET_VERTS], c[LINE_SET_VERTS];
+};
+
+static std::vector<int> pending;
+static std::vector<int> pendingNext;
+static std::vector<Ray> rays;
+static std::vector<RayHit> hits;
+
+static int is_opaque(int tile)
+{
+    return tile != 0 && tile != 2 && tile != 3;
+}
+
+static int window_bit(int a, int b)
+{
+    int dx = b % pvs.size - a % pvs.size;
+    int dy = b / pvs.size - a / pvs.size;
+    return (dy + PVS_RADIUS) * PVS_SIDE + dx + PVS_RADIUS;
+}
+
+static void set_bit(int a, int b, int visible)
+{
+    int bit = window_bit(a, b);
+    uint64_t& word = pvs.bits[(size_t)a * PVS_WORDS + (bit >> 6)];
+    uint64_t mask = 1ull << (bit & 63);
+    word = visible ? (word | mask) : (word & ~mask);
+}
+
+static void set_pair(int a, int b, int visible)
+{
+    set_bit(a, b, visible);
+    set_bit(b, a, visible);
+}
+
+// Lines always run from the lower cell index so a pair traces the same way
+// whichever of its cells is being updated.
+static void add_ray(int a, int b)
+{
+    if (b < a)
+        std::swap(a, b);
+    float x = a % pvs.size + 0.5f, y = a / pvs.size + 0.5f;
+    float dx = b % pvs.size - a % pvs.size, dy = b / pvs.size - a / pvs.size;
+    float dist = sqrtf(dx * dx + dy * dy);
+    rays.push_back({ x, y, dx / dist, dy / dist, dist });
+}
+
+// Keeps the lines of in with a * m + b * c <= d. Returns 0 when none are
+// left.
+static int clip_lines(const LineSet& in, double a, double b, double d, LineSet& out)
+{
+    out.count = 0;
+    for (int i = 0; i < in.count; i++) {
+        int j = (i + 1) % in.count;
+        double fi = a * in.m[i] + b * in.c[i] - d;
+        double fj = a * in.m[j] + b * in.c[j] - d;
+        if (fi <= 0.0) {
+            out.m[out.count] = in.m[i];
+            out.c[out.count++] = in.c[i];
+        }
+        if ((fi < 0.0 && fj > 0.0) || (fi > 0.0 && fj < 0.0)) {
+            double t = fi / (fi - fj);
+            out.m[out.count] = in.m[i] + t * (in.m[j] - in.m[i]);
+            out.c[out.count++] = in.c[i] + t * (in.c[j] - in.c[i]);
+        }
+    }
+    return out.count > 0;
+}
+
+// The map seen in one of four frames, each covering the lines whose slope
+// in it is within [0, 1]: x major rising, x major falling, and the same
+// with the axes swapped. Cell (u, v) of the frame is cell (x, y) here.
+static void frame_cell(int frame, int u, int v, int& x, int& y)
+{
+    switch (frame) {
+    case 0: x = u; y = v; break;
+    case 1: x = u; y = -1 - v; break;
+    case 2: x = v; y = u; break;
+    default: x = -1 - v; y = u; break;
+    }
+}
+
+static int frame_open(int frame, int u, int v)
+{
+    int x, y;
+    frame_cell(frame, u, v, x, y);
+    return x >= 0 && y >= 0 && x < pvs.size && y < pvs.size && !pvs.opaque[y * pvs.size + x];
+}
+
+// Whether some line of slope [0, 1] in the frame passes through both cells
+// and through open cells in every column between them. Such a line leaves
+// the nearer cell's column through it or the cell above, and enters the
+// farther one's through it or the cell below.
+static int frame_sees(int frame, int a, int b)
+{
+    // Inverse of frame_cell() for the two end cells.
+    int au, av, bu, bv;
+    int ax = a % pvs.size, ay = a / pvs.size, bx = b % pvs.size, by = b / pvs.size;
+    switch (frame) {
+    case 0: au = ax; av = ay; bu = bx; bv = by; break;
+    case 1: au = ax; av = -1 - ay; bu = bx; bv = -1 - by; break;
+    case 2: au = ay; av = ax; bu = by; bv = bx; break;
+    default: au = ay; av = -1 - ax; bu = by; bv = -1 - bx; break;
+    }
+    if (bu < au) {
+        std::swap(au, bu);
+        std::swap(av, bv);
+    }
+
+    // Both cells: the line's lowest point over the cell's column is below
+    // its top and its highest point above its bottom.
+    double bound = 4.0 * pvs.size + 8.0;
+    LineSet sets[2][LINE_SETS], scratch;
+    sets[0][0] = { 4, { 0.0, 1.0, 1.0, 0.0 }, { -bound, -bound, bound, bound } };
+    if (!clip_lines(sets[0][0], au, 1.0, av + 1 + LINE_EPS, scratch) ||
+        !clip_lines(scratch, -(au + 1.0), -1.0, -(av - LINE_EPS), sets[0][0]) ||
+        !clip_lines(sets[0][0], bu, 1.0, bv + 1 + LINE_EPS, scratch) ||
+        !clip_lines(scratch, -(bu + 1.0), -1.0, -(bv - LINE_EPS), sets[0][0]))
+        return 0;
+    if (bu > au && !frame_open(frame, au, av + 1)) {
+        if (!clip_lines(sets[0][0], au + 1.0, 1.0, av + 1 + LINE_EPS, scratch))
+            return 0;
+        sets[0][0] = scratch;
+    }
+    if (bu > au && !frame_open(frame, bu, bv - 1)) {
+        if (!clip_lines(sets[0][0], -(double)bu, -1.0, -(bv - LINE_EPS), scratch))
+            return 0;
+        sets[0][0] = scratch;
+    }
+
+    // Lines through different runs of open cells in a column split into
+    // separate sets.
+    int count = 1, cur = 0;
+    for (int i = au + 1; i < bu; i++) {
+        int next = 0;
+        for (int s = 0; s < count; s++) {
+            const LineSet& set = sets[cur][s];
+            double lo = 1e30, hi = -1e30;
+            for (int k = 0; k < set.count; k++) {
+                lo = std::min(lo, set.m[k] * i + set.c[k]);
+                hi = std::max(hi, set.m[k] * (i + 1) + set.c[k]);
+            }
+
+            int r = (int)floor(lo - LINE_EPS), last = (int)floor(hi + LINE_EPS);
+            while (r <= last) {
+                if (!frame_open(frame, i, r)) {
+                    r++;
+                    continue;
+                }
+                int r0 = r, r1 = r;
+                while (frame_open(frame, i, r0 - 1))
+                    r0--;
+                while (frame_open(frame, i, r1 + 1))
+                    r1++;
+                r = r1 + 1;
+
+                if (next == LINE_SETS)
+                    return 1;
+                if (clip_lines(set, -(double)i, -1.0, -(r0 - LINE_EPS), scratch) &&
+                    clip_lines(scratch, i + 1.0, 1.0, r1 + 1 + LINE_EPS, sets[cur ^ 1][next]))
+                    next++;
+            }
+        }
+        if (next == 0)
+            return 0;
+        count = next;
+        cur ^= 1;
+    }
+    return 1;
+}
+
+// Whether any segment from a point of cell a to a point of cell b misses
+// every wall.
+static int cells_see(int a, int b)
+{
+    for (int frame = 0; frame < 4; frame++) {
+        if (frame_sees(frame, a, b))
+            return 1;
+    }
+    return 0;
+}
+
+// Marks which of the cells in targets see cell a. Centre to centre lines
+// settle most pairs in one batch; only the rest go through the exact test.
+static void trace_pairs(int a, const std::vector<int>& targets)
+{
+    pending.clear();
+    rays.clear();
+    for (int b : targets)
+        add_ray(a, b);
+    hits.resize(rays.size());
+    trace_rays(rays.data(), (int)rays.size(), RAY_STOP_WALLS, hits.data());
+    for (size_t i = 0; i < targets.size(); i++) {
+        if (!hits[i].hit)
+            set_pair(a, targets[i], 1);
+        else
+            pending.push_back(targets[i]);
+    }
+
+    for (int b : pending)
+        set_pair(a, b, cells_see(a, b));
+}
+
+// Open cells in the window around a with a larger index, so each pair is
+// traced once and stored both ways.
+static void later_targets(int a, std::vector<int>& out)
+{
+    out.clear();
+    int ax = a % pvs.size, ay = a / pvs.size;
+    int x0 = std::max(0, ax - PVS_RADIUS), x1 = std::min(pvs.size - 1, ax + PVS_RADIUS);
+    int y1 = std::min(pvs.size - 1, ay + PVS_RADIUS);
+    for (int y = ay; y <= y1; y++) {
+        for (int x = (y == ay ? ax + 1 : x0); x <= x1; x++) {
+            if (!pvs.opaque[y * pvs.size + x])
+                out.push_back(y * pvs.size + x);
+        }
+    }
+}
+
+// Targets of the cell a sliced build is working through. A cell can take
+// a millisecond on its own, so slices end between chunks of its targets.
+static const int BUILD_CHUNK = 8;
+static std::vector<int> buildTargets;
+static std::vector<int> buildChunk;
+static size_t buildNext = 0;
+static int buildCell = -1;
+
+void begin_pvs_build()
+{
+    pvs.size = MAP_SIZE;
+    int cells = MAP_SIZE * MAP_SIZE;
+    pvs.bits.assign((size_t)cells * PVS_WORDS, 0);
+    pvs.opaque.resize(cells);
+    for (int i = 0; i < cells; i++)
+        pvs.opaque[i] = (uint8_t)is_opaque(MAPDATA[i]);
+    pvs.cursor = 0;
+    pvs.complete = 0;
+    buildTargets.clear();
+    buildNext = 0;
+}
+
+int continue_pvs_build(double budgetMs)
+{
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    int cells = pvs.size * pvs.size;
+    // Stops early rather than start a chunk that would likely overrun;
+    // neighbouring chunks take about as long as each other. One chunk is
+    // always traced so the build cannot stall.
+    double spent = 0.0, last = 0.0;
+    int traced = 0;
+    while (!traced || spent + last <= budgetMs) {
+        if (buildNext == buildTargets.size()) {
+            while (pvs.cursor < cells && pvs.opaque[pvs.cursor])
+                pvs.cursor++;
+            if (pvs.cursor == cells)
+                break;
+            buildCell = pvs.cursor++;
+            set_bit(buildCell, buildCell, 1);
+            later_targets(buildCell, buildTargets);
+            buildNext = 0;
+        }
+
+        size_t end = std::min(buildTargets.size(), buildNext + BUILD_CHUNK);
+        buildChunk.assign(buildTargets.begin() + buildNext, buildTargets.begin() + end);
+        buildNext = end;
+        trace_pairs(buildCell, buildChunk);
+        traced = 1;
+
+        double now = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        last = now - spent;
+        spent = now;
+    }
+    pvs.complete = pvs.cursor == cells && buildNext == buildTargets.size();
+    return pvs.complete;
+}
+
+void build_pvs()
+{
+    begin_pvs_build();
+    continue_pvs_build(1e30);
+}
+
+static float segment_distance(float px, float py, float ax, float ay, float bx, float by)
+{
+    float dx = bx - ax, dy = by - ay;
+    float lenSq = dx * dx + dy * dy;
+    float t = lenSq > 0.0f ? ((px - ax) * dx + (py - ay) * dy) / lenSq : 0.0f;
+    t = std::max(0.0f, std::min(1.0f, t));
+    float ex = ax + dx * t - px, ey = ay + dy * t - py;
+    return sqrtf(ex * ex + ey * ey);
+}
+
+void pvs_cell_changed(int cell)
+{
+    if (pvs.size != MAP_SIZE || cell < 0 || cell >= MAP_SIZE * MAP_SIZE)
+        return;
+    int nowOpaque = is_opaque(MAPDATA[cell]);
+    if (nowOpaque == pvs.opaque[cell])
+        return;
+    if (!pvs.complete) {
+        begin_pvs_build();
+        return;
+    }
+    pvs.opaque[cell] = (uint8_t)nowOpaque;
+
+    const int size = pvs.size;
+    int cx = cell % size, cy = cell / size;
+
+    // The changed cell's own pairs.
+    std::vector<int> targets;
+    for (int y = std::max(0, cy - PVS_RADIUS); y <= std::min(size - 1, cy + PVS_RADIUS); y++) {
+        for (int x = std::max(0, cx - PVS_RADIUS); x <= std::min(size - 1, cx + PVS_RADIUS); x++) {
+            int b = y * size + x;
+            if (b == cell)
+                continue;
+            set_pair(cell, b, 0);
+            if (!nowOpaque && !pvs.opaque[b])
+                targets.push_back(b);
+        }
+    }
+    set_bit(cell, cell, !nowOpaque);
+    trace_pairs(cell, targets);
+
+    // Every segment between two cells lies within about 0.71 of the line
+    // between their centres, so only pairs whose centre line passes within
+    // 1.5 of the changed cell's centre can have been affected.
+    const int reach = PVS_RADIUS + 2;
+    const float ccx = cx + 0.5f, ccy = cy + 0.5f;
+    for (int ay = std::max(0, cy - reach); ay <= std::min(size - 1, cy + reach); ay++) {
+        for (int ax = std::max(0, cx - reach); ax <= std::min(size - 1, cx + reach); ax++) {
+            int a = ay * size + ax;
+            if (a == cell || pvs.opaque[a])
+                continue;
+
+            later_targets(a, pendingNext);
+            targets.clear();
+            for (int b : pendingNext) {
+                if (b == cell)
+                    continue;
+                int bx = b % size, by = b / size;
+                if (cx < std::min(ax, bx) - 2 || cx > std::max(ax, bx) + 2 ||
+                    cy < std::min(ay, by) - 2 || cy > std::max(ay, by) + 2)
+                    continue;
+                if (segment_distance(ccx, ccy, ax + 0.5f, ay + 0.5f, bx + 0.5f, by + 0.5f) > 1.5f)
+                    continue;
+                targets.push_back(b);
+            }
+            trace_pairs(a, targets);
+        }
+    }
+}
+
+static const char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int get_bit(int a, int bit)
+{
+    return (int)(pvs.bits[(size_t)a * PVS_WORDS + (bit >> 6)] >> (bit & 63)) & 1;
+}
+
+// Neighbouring cells see mostly the same cells, so each bit is stored as
+// its difference from the left neighbour's bit for the same target.
+static int predicted_bit(int a, int bit)
+{
+    if (a % pvs.size == 0 || pvs.opaque[a - 1] || bit % PVS_SIDE == PVS_SIDE - 1)
+        return 0;
+    return get_bit(a - 1, bit + 1);
+}
+
+// Calls fn(bit) for every bit the file stores: pairs of open cells, each
+// once from its lower index. Everything else follows from the map or from
+// symmetry.
+template <typename Fn>
+static void for_each_stored_bit(int a, Fn fn)
+{
+    int ax = a % pvs.size, ay = a / pvs.size;
+    int x0 = std::max(0, ax - PVS_RADIUS), x1 = std::min(pvs.size - 1, ax + PVS_RADIUS);
+    int y1 = std::min(pvs.size - 1, ay + PVS_RADIUS);
+    for (int y = ay; y <= y1; y++) {
+        for (int x = (y == ay ? ax + 1 : x0); x <= x1; x++) {
+            if (!pvs.opaque[y * pvs.size + x])
+                fn((y - ay + PVS_RADIUS) * PVS_SIDE + x - ax + PVS_RADIUS);
+        }
+    }
+}
+
+std::string encode_pvs()
+{
+    // Runs alternate between predicted and mispredicted bits, starting with
+    // predicted.
+    std::vector<uint8_t> bytes;
+    uint32_t run = 0;
+    int current = 0;
+    for (int a = 0; a < pvs.size * pvs.size; a++) {
+        if (pvs.opaque[a])
+            continue;
+        for_each_stored_bit(a, [&](int bit) {
+            int v = get_bit(a, bit) ^ predicted_bit(a, bit);
+            if (v != current) {
+                net_put_varint(bytes, run);
+                run = 0;
+                current = v;
+            }
+            run++;
+        });
+    }
+    net_put_varint(bytes, run);
+
+    std::ostringstream out;
+    out << PVS_RADIUS << ' ' << pvs.size << ' ' << std::hex << map_checksum(MAPDATA, MAP_SIZE) << ' ';
+    for (size_t i = 0; i < bytes.size(); i += 3) {
+        uint32_t v = bytes[i] << 16;
+        if (i + 1 < bytes.size()) v |= bytes[i + 1] << 8;
+        if (i + 2 < bytes.size()) v |= bytes[i + 2];
+        out << base64Chars[(v >> 18) & 63] << base64Chars[(v >> 12) & 63];
+        out << (i + 1 < bytes.size() ? base64Chars[(v >> 6) & 63] : '=');
+        out << (i + 2 < bytes.size() ? base64Chars[v & 63] : '=');
+    }
+    return out.str();
+}
+
+int decode_pvs(const std::string& text)
+{
+    std::istringstream in(text);
+    int radius = 0, size = 0;
+    uint32_t checksum = 0;
+    std::string data;
+    in >> radius >> size >> std::hex >> checksum >> data;
+    if (!in || radius != PVS_RADIUS || size != MAP_SIZE || checksum != map_checksum(MAPDATA, MAP_SIZE))
+        return 0;
+
+    std::vector<uint8_t> bytes;
+    uint32_t v = 0;
+    int bitsHeld = 0;
+    for (char ch : data) {
+        const char* p = strchr(base64Chars, ch);
+        if (ch == '=' || !p || !ch)
+            break;
+        v = (v << 6) | (uint32_t)(p - base64Chars);
+        bitsHeld += 6;
+        if (bitsHeld >= 8) {
+            bitsHeld -= 8;
+            bytes.push_back((uint8_t)(v >> bitsHeld));
+        }
+    }
+
+    int cells = size * size;
+    pvs.size = size;
+    pvs.bits.assign((size_t)cells * PVS_WORDS, 0);
+    pvs.opaque.resize(cells);
+    for (int i = 0; i < cells; i++)
+        pvs.opaque[i] = (uint8_t)is_opaque(MAPDATA[i]);
+
+    // Cells come out in index order, so the left neighbour's bits are in
+    // place before they are used as the prediction.
+    NetReader r = { bytes.data(), (int)bytes.size(), 0, 0 };
+    uint32_t left = net_get_varint(r);
+    int current = 0, ok = 1;
+    for (int a = 0; a < cells && ok; a++) {
+        if (pvs.opaque[a])
+            continue;
+        set_bit(a, a, 1);
+        for_each_stored_bit(a, [&](int bit) {
+            while (left == 0 && ok) {
+                left = net_get_varint(r);
+                current ^= 1;
+                ok = !r.overflow;
+            }
+            left--;
+            if (current ^ predicted_bit(a, bit))
+                pvs.bits[(size_t)a * PVS_WORDS + (bit >> 6)] |= 1ull << (bit & 63);
+        });
+    }
+    if (!ok || left != 0 || r.pos != r.size) {
+        pvs.size = 0;
+        return 0;
+    }
+
+    for (int a = 0; a < cells; a++) {
+        if (pvs.opaque[a])
+            continue;
+        int ax = a % size, ay = a / size;
+        for_each_stored_bit(a, [&](int bit) {
+            if (get_bit(a, bit)) {
+                int b = (ay + bit / PVS_SIDE - PVS_RADIUS) * size + ax + bit % PVS_SIDE - PVS_RADIUS;
+                set_bit(b, a, 1);
+            }
+        });
+    }
+    pvs.cursor = cells;
+    pvs.complete = 1;
+    return 1;
+}
@@ -0,0 +1,64 @@
+#ifndef PVS_H
+#define PVS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern int MAP_SIZE;
+
+// Cells farther apart than this on either axis are never visible to each
+// other; the renderer draws sprites out to 15 cells.
+constexpr int PVS_RADIUS = 16;
+constexpr int PVS_SIDE = 2 * PVS_RADIUS + 1;
+constexpr int PVS_WORDS = (PVS_SIDE * PVS_SIDE + 63) / 64;
+
+// Cell-to-cell potentially visible set. Every cell owns a bitset over the
+// PVS_SIDE x PVS_SIDE window centred on it; a bit is set when some segment
+// from a point of one cell to a point of the other passes no wall. The test
+// is exact up to a small margin on the visible side, so the set never drops
+// a clear line. Only walls block sight, as in the sprite and hitscan traces.
+struct Pvs {
+    int size = 0;
+    std::vector<uint64_t> bits;
+    // Wall flags the set was computed against, to tell which edits matter.
+    std::vector<uint8_t> opaque;
+    // Next cell to trace while a sliced build is under way.
+    int cursor = 0;
+    int complete = 0;
+};
+
+extern Pvs pvs;
+
+void build_pvs();
+// The same build spread over several frames: begin_pvs_build resets the
+// set, and each continue_pvs_build call traces cells for up to about
+// budgetMs. Everything counts as visible until the last call returns 1.
+void begin_pvs_build();
+int continue_pvs_build(double budgetMs);
+// Updates the set after MAPDATA[cell] changed. Only pairs whose lines can
+// cross the cell are retraced, and nothing happens unless the cell started
+// or stopped blocking sight. An unfinished sliced build starts over.
+void pvs_cell_changed(int cell);
+
+// Compact text form for the map file: run lengths of the bitsets as
+// varints, base64 encoded, tagged with the map checksum.
+std::string encode_pvs();
+// Returns 0 if text does not belong to the map in MAPDATA.
+int decode_pvs(const std::string& text);
+
+// Whether anything in cell b can be seen from cell a. Without a complete
+// set for the current map everything counts as visible.
+inline int pvs_visible(int a, int b)
+{
+    if (pvs.size != MAP_SIZE || !pvs.complete)
+        return 1;
+    int dx = b % pvs.size - a % pvs.size;
+    int dy = b / pvs.size - a / pvs.size;
+    if (dx < -PVS_RADIUS || dx > PVS_RADIUS || dy < -PVS_RADIUS || dy > PVS_RADIUS)
+        return 0;
+    int bit = (dy + PVS_RADIUS) * PVS_SIDE + dx + PVS_RADIUS;
+    return (int)(pvs.bits[(size_t)a * PVS_WORDS + (bit >> 6)] >> (bit & 63)) & 1;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,558 @@
+#include "pch.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RAYCAST_SSE2 1
+#endif
+
+// What a tile stops: 0 is open floor, 3 the spawn marker, 2 a destructible
+// object and anything else is a wall.
+static inline int tile_class(int tile)
+{
+    if (tile == 2)
+        return RAY_STOP_OBJECTS;
+    return (tile && tile != 3) ? RAY_STOP_WALLS : 0;
+}
+
+void cast_wall_scalar(const CameraTable& cam, int x, WallHit* out)
+{
+    float rayDirX = cam.rayDirX[x];
+    float rayDirY = cam.rayDirY[x];
+
+    int mapX = (int)state.pos.x;
+    int mapY = (int)state.pos.y;
+
+    float deltaDistX = cam.deltaDistX[x];
+    float deltaDistY = cam.deltaDistY[x];
+
+    float sideDistX, sideDistY;
+    int stepX = cam.stepX[x];
+    int stepY = cam.stepY[x];
+
+    sideDistX = (rayDirX < 0)
+        ? (state.pos.x - mapX) * deltaDistX
+        : (mapX + 1.0f - state.pos.x) * deltaDistX;
+
+    sideDistY = (rayDirY < 0)
+        ? (state.pos.y - mapY) * deltaDistY
+        : (mapY + 1.0f - state.pos.y) * deltaDistY;
+
+    int hit = 0, side = 0;
+    while (!hit) {
+        if (sideDistX < sideDistY) {
+            sideDistX += deltaDistX;
+            mapX += stepX;
+            side = 0;
+        } else {
+            sideDistY += deltaDistY;
+            mapY += stepY;
+            side = 1;
+        }
+
+        if (mapX < 0 || mapX >= (int)MAP_SIZE || mapY < 0 || mapY >= (int)MAP_SIZE)
+            break;
+
+        if (tile_class(MAPDATA[mapY * MAP_SIZE + mapX]) & RAY_STOP_WALLS)
+            hit = 1;
+    }
+
+    out->rayDirX = rayDirX;
+    out->rayDirY = rayDirY;
+    out->perpWallDist = (side == 0)
+        ? (sideDistX - deltaDistX)
+        : (sideDistY - deltaDistY);
+    out->mapX = mapX;
+    out->mapY = mapY;
+    out->side = side;
+    out->hit = hit;
+}
+
+// Distance along the ray to the first grid line on either side of a fixed
+// position, for a ray with the given direction and grid line spacing.
+static inline int fixed_side_dist(int pos, int rayDir, int delta)
+{
+    int frac = pos & (FIXED_ONE - 1);
+    if (rayDir >= 0)
+        frac = FIXED_ONE - frac;
+    return (int)(((int64_t)frac * delta) >> FIXED_SHIFT);
+}
+
+static inline void fixed_wall_hit(const CameraTable& cam, int x, int mapX, int mapY, int side, int dist,
+                                  int hit, WallHit* out)
+{
+    out->rayDirXFixed = cam.rayDirXFixed[x];
+    out->rayDirYFixed = cam.rayDirYFixed[x];
+    out->perpWallDistFixed = dist;
+    out->rayDirX = cam.rayDirXFixed[x] / (float)FIXED_ONE;
+    out->rayDirY = cam.rayDirYFixed[x] / (float)FIXED_ONE;
+    out->perpWallDist = dist / (float)FIXED_ONE;
+    out->mapX = mapX;
+    out->mapY = mapY;
+    out->side = side;
+    out->hit = hit;
+}
+
+void cast_wall_fixed(const CameraTable& cam, int x, WallHit* out)
+{
+    int posX = to_fixed(state.pos.x);
+    int posY = to_fixed(state.pos.y);
+    int rayDirX = cam.rayDirXFixed[x];
+    int rayDirY = cam.rayDirYFixed[x];
+
+    int mapX = posX >> FIXED_SHIFT;
+    int mapY = posY >> FIXED_SHIFT;
+
+    int deltaDistX = cam.deltaDistXFixed[x];
+    int deltaDistY = cam.deltaDistYFixed[x];
+    int stepX = (rayDirX < 0) ? -1 : 1;
+    int stepY = (rayDirY < 0) ? -1 : 1;
+
+    int sideDistX = fixed_side_dist(posX, rayDirX, deltaDistX);
+    int sideDistY = fixed_side_dist(posY, rayDirY, deltaDistY);
+
+    int hit = 0, side = 0;
+    while (!hit) {
+        if (sideDistX < sideDistY) {
+            sideDistX += deltaDistX;
+            mapX += stepX;
+            side = 0;
+        } else {
+            sideDistY += deltaDistY;
+            mapY += stepY;
+            side = 1;
+        }
+
+        if (mapX < 0 || mapX >= MAP_SIZE || mapY < 0 || mapY >= MAP_SIZE)
+            break;
+
+        if (tile_class(MAPDATA[mapY * MAP_SIZE + mapX]) & RAY_STOP_WALLS)
+            hit = 1;
+    }
+
+    int dist = (side == 0) ? (sideDistX - deltaDistX) : (sideDistY - deltaDistY);
+    fixed_wall_hit(cam, x, mapX, mapY, side, dist, hit, out);
+}
+
+static void trace_ray_scalar(const Ray& ray, int stopMask, RayHit* out)
+{
+    int mapX = (int)ray.x;
+    int mapY = (int)ray.y;
+
+    float deltaDistX = (ray.dirX == 0) ? 1e30f : fabsf(1.0f / ray.dirX);
+    float deltaDistY = (ray.dirY == 0) ? 1e30f : fabsf(1.0f / ray.dirY);
+    int stepX = (ray.dirX < 0) ? -1 : 1;
+    int stepY = (ray.dirY < 0) ? -1 : 1;
+
+    float sideDistX = (ray.dirX < 0)
+        ? (ray.x - mapX) * deltaDistX
+        : (mapX + 1.0f - ray.x) * deltaDistX;
+    float sideDistY = (ray.dirY < 0)
+        ? (ray.y - mapY) * deltaDistY
+        : (mapY + 1.0f - ray.y) * deltaDistY;
+
+    int hit = 0, side = 0, tile = 0;
+    float distance = 0.0f;
+    while (1) {
+        if (sideDistX < sideDistY) {
+            sideDistX += deltaDistX;
+            mapX += stepX;
+            side = 0;
+        } else {
+            sideDistY += deltaDistY;
+            mapY += stepY;
+            side = 1;
+        }
+
+        distance = (side == 0) ? (sideDistX - deltaDistX) : (sideDistY - deltaDistY);
+        if (distance > ray.maxDist)
+            break;
+
+        if (mapX < 0 || mapX >= MAP_SIZE || mapY < 0 || mapY >= MAP_SIZE)
+            break;
+
+        tile = MAPDATA[mapY * MAP_SIZE + mapX];
+        if (tile_class(tile) & stopMask) {
+            hit = 1;
+            break;
+        }
+    }
+
+    out->cellX = mapX;
+    out->cellY = mapY;
+    out->distance = distance;
+    out->side = side;
+    out->hit = hit;
+    out->tile = hit ? tile : 0;
+    out->entity = (hit && tile_class(tile) == RAY_STOP_OBJECTS) ? mapY * MAP_SIZE + mapX : -1;
+}
+
+#if RAYCAST_SSE2
+static inline __m128 select_ps(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// DDA state for RAY_PACKET rays marched in lockstep.
+struct RayLanes {
+    __m128 sideX, sideY;
+    __m128 deltaX, deltaY;
+    __m128i stepX, stepY;
+    __m128i mapX, mapY;
+    __m128i side;
+};
+
+struct LaneResult {
+    alignas(16) float distance[RAY_PACKET];
+    alignas(16) int mapX[RAY_PACKET];
+    alignas(16) int mapY[RAY_PACKET];
+    alignas(16) int side[RAY_PACKET];
+    int tile[RAY_PACKET];
+    int hitBits;
+};
+
+static inline void init_lanes(RayLanes& l, __m128 posX, __m128 posY, __m128i mapX, __m128i mapY,
+                              __m128 negX, __m128 negY)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 mapXf = _mm_cvtepi32_ps(mapX);
+    __m128 mapYf = _mm_cvtepi32_ps(mapY);
+
+    l.sideX = select_ps(negX,
+        _mm_mul_ps(_mm_sub_ps(posX, mapXf), l.deltaX),
+        _mm_mul_ps(_mm_sub_ps(_mm_add_ps(mapXf, one), posX), l.deltaX));
+    l.sideY = select_ps(negY,
+        _mm_mul_ps(_mm_sub_ps(posY, mapYf), l.deltaY),
+        _mm_mul_ps(_mm_sub_ps(_mm_add_ps(mapYf, one), posY), l.deltaY));
+    l.mapX = mapX;
+    l.mapY = mapY;
+    l.side = _mm_setzero_si128();
+}
+
+// Steps every lane exactly as the scalar DDA does until each one either hits
+// a tile in stopMask, leaves the map or (with limitDist) passes maxDist.
+// While all lanes sit in the same cell the packet shares a single bounds
+// check and MAPDATA lookup; once they diverge each lane is tested on its own
+// and finished lanes are masked out until the whole packet is done.
+static inline void march_lanes(RayLanes& l, int stopMask, int limitDist, __m128 maxDist, LaneResult& res)
+{
+    const __m128i oneI = _mm_set1_epi32(1);
+    const __m128i laneBits = _mm_set_epi32(8, 4, 2, 1);
+    const int allLanes = (1 << RAY_PACKET) - 1;
+
+    int activeBits = allLanes;
+    int hitBits = 0;
+    __m128 active = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+    for (int i = 0; i < RAY_PACKET; i++)
+        res.tile[i] = 0;
+
+    while (activeBits) {
+        __m128 takeX = _mm_and_ps(_mm_cmplt_ps(l.sideX, l.sideY), active);
+        __m128 takeY = _mm_andnot_ps(takeX, active);
+
+        l.sideX = select_ps(takeX, _mm_add_ps(l.sideX, l.deltaX), l.sideX);
+        l.sideY = select_ps(takeY, _mm_add_ps(l.sideY, l.deltaY), l.sideY);
+        l.mapX = _mm_add_epi32(l.mapX, _mm_and_si128(l.stepX, _mm_castps_si128(takeX)));
+        l.mapY = _mm_add_epi32(l.mapY, _mm_and_si128(l.stepY, _mm_castps_si128(takeY)));
+        l.side = _mm_andnot_si128(_mm_castps_si128(takeX), l.side);
+        l.side = _mm_or_si128(l.side, _mm_and_si128(_mm_castps_si128(takeY), oneI));
+
+        if (limitDist) {
+            __m128 sideMask = _mm_castsi128_ps(_mm_cmpeq_epi32(l.side, _mm_setzero_si128()));
+            __m128 dist = select_ps(sideMask, _mm_sub_ps(l.sideX, l.deltaX), _mm_sub_ps(l.sideY, l.deltaY));
+            activeBits &= ~_mm_movemask_ps(_mm_cmpgt_ps(dist, maxDist));
+        }
+
+        _mm_store_si128((__m128i*)res.mapX, l.mapX);
+        _mm_store_si128((__m128i*)res.mapY, l.mapY);
+
+        __m128i sameCell = _mm_and_si128(
+            _mm_cmpeq_epi32(l.mapX, _mm_shuffle_epi32(l.mapX, 0)),
+            _mm_cmpeq_epi32(l.mapY, _mm_shuffle_epi32(l.mapY, 0)));
+
+        if (activeBits == allLanes && _mm_movemask_epi8(sameCell) == 0xFFFF) {
+            int mx = res.mapX[0], my = res.mapY[0];
+            if (mx < 0 || mx >= MAP_SIZE || my < 0 || my >= MAP_SIZE) {
+                activeBits = 0;
+            } else {
+                int tile = MAPDATA[my * MAP_SIZE + mx];
+                if (tile_class(tile) & stopMask) {
+                    for (int i = 0; i < RAY_PACKET; i++)
+                        res.tile[i] = tile;
+                    hitBits = allLanes;
+                    activeBits = 0;
+                }
+            }
+        } else {
+            for (int i = 0; i < RAY_PACKET; i++) {
+                if (!(activeBits & (1 << i)))
+                    continue;
+
+                int mx = res.mapX[i], my = res.mapY[i];
+                if (mx < 0 || mx >= MAP_SIZE || my < 0 || my >= MAP_SIZE) {
+                    activeBits &= ~(1 << i);
+                    continue;
+                }
+
+                int tile = MAPDATA[my * MAP_SIZE + mx];
+                if (tile_class(tile) & stopMask) {
+                    res.tile[i] = tile;
+                    activeBits &= ~(1 << i);
+                    hitBits |= 1 << i;
+                }
+            }
+        }
+
+        __m128i bits = _mm_and_si128(_mm_set1_epi32(activeBits), laneBits);
+        active = _mm_castsi128_ps(_mm_cmpeq_epi32(bits, laneBits));
+    }
+
+    __m128 sideMask = _mm_castsi128_ps(_mm_cmpeq_epi32(l.side, _mm_setzero_si128()));
+    _mm_store_ps(res.distance, select_ps(sideMask, _mm_sub_ps(l.sideX, l.deltaX), _mm_sub_ps(l.sideY, l.deltaY)));
+    _mm_store_si128((__m128i*)res.mapX, l.mapX);
+    _mm_store_si128((__m128i*)res.mapY, l.mapY);
+    _mm_store_si128((__m128i*)res.side, l.side);
+    res.hitBits = hitBits;
+}
+#endif
+
+// Marches the RAY_PACKET adjacent columns starting at x (a multiple of
+// RAY_PACKET) in lockstep. Every lane reads the same camera table entries and
+// performs the same float operations as cast_wall_scalar(), so hits and
+// perpWallDist match bit for bit.
+void cast_walls_packet(const CameraTable& cam, int x, WallHit* out)
+{
+#if RAYCAST_SSE2
+    const __m128 zero = _mm_setzero_ps();
+
+    RayLanes l;
+    l.deltaX = _mm_load_ps(&cam.deltaDistX[x]);
+    l.deltaY = _mm_load_ps(&cam.deltaDistY[x]);
+    l.stepX = _mm_load_si128((const __m128i*)&cam.stepX[x]);
+    l.stepY = _mm_load_si128((const __m128i*)&cam.stepY[x]);
+
+    init_lanes(l, _mm_set1_ps(state.pos.x), _mm_set1_ps(state.pos.y),
+               _mm_set1_epi32((int)state.pos.x), _mm_set1_epi32((int)state.pos.y),
+               _mm_cmplt_ps(_mm_load_ps(&cam.rayDirX[x]), zero),
+               _mm_cmplt_ps(_mm_load_ps(&cam.rayDirY[x]), zero));
+
+    LaneResult res;
+    march_lanes(l, RAY_STOP_WALLS, 0, zero, res);
+
+    for (int i = 0; i < RAY_PACKET; i++) {
+        out[i].rayDirX = cam.rayDirX[x + i];
+        out[i].rayDirY = cam.rayDirY[x + i];
+        out[i].perpWallDist = res.distance[i];
+        out[i].mapX = res.mapX[i];
+        out[i].mapY = res.mapY[i];
+        out[i].side = res.side[i];
+        out[i].hit = (res.hitBits >> i) & 1;
+    }
+#else
+    for (int i = 0; i < RAY_PACKET; i++)
+        cast_wall_scalar(cam, x + i, &out[i]);
+#endif
+}
+
+// RAY_PACKET columns of the fixed-point DDA in the 32-bit lanes of one
+// register. The side distances start out in scalar code, which needs a
+// 64-bit product; the march itself is adds, compares and masks and gives
+// the same hits as cast_wall_fixed().
+void cast_walls_fixed_packet(const CameraTable& cam, int x, WallHit* out)
+{
+#if RAYCAST_SSE2
+    const __m128i oneI = _mm_set1_epi32(1);
+    const __m128i laneBits = _mm_set_epi32(8, 4, 2, 1);
+    const int allLanes = (1 << RAY_PACKET) - 1;
+
+    int posX = to_fixed(state.pos.x);
+    int posY = to_fixed(state.pos.y);
+    alignas(16) int sideX[RAY_PACKET], sideY[RAY_PACKET];
+    for (int i = 0; i < RAY_PACKET; i++) {
+        sideX[i] = fixed_side_dist(posX, cam.rayDirXFixed[x + i], cam.deltaDistXFixed[x + i]);
+        sideY[i] = fixed_side_dist(posY, cam.rayDirYFixed[x + i], cam.deltaDistYFixed[x + i]);
+    }
+
+    __m128i sideDistX = _mm_load_si128((const __m128i*)sideX);
+    __m128i sideDistY = _mm_load_si128((const __m128i*)sideY);
+    __m128i deltaX = _mm_load_si128((const __m128i*)&cam.deltaDistXFixed[x]);
+    __m128i deltaY = _mm_load_si128((const __m128i*)&cam.deltaDistYFixed[x]);
+    __m128i stepX = _mm_or_si128(_mm_srai_epi32(_mm_load_si128((const __m128i*)&cam.rayDirXFixed[x]), 31), oneI);
+    __m128i stepY = _mm_or_si128(_mm_srai_epi32(_mm_load_si128((const __m128i*)&cam.rayDirYFixed[x]), 31), oneI);
+    __m128i mapX = _mm_set1_epi32(posX >> FIXED_SHIFT);
+    __m128i mapY = _mm_set1_epi32(posY >> FIXED_SHIFT);
+    __m128i side = _mm_setzero_si128();
+
+    alignas(16) int mx[RAY_PACKET], my[RAY_PACKET];
+    int activeBits = allLanes;
+    int hitBits = 0;
+    __m128i active = _mm_set1_epi32(-1);
+
+    while (activeBits) {
+        __m128i takeX = _mm_and_si128(_mm_cmplt_epi32(sideDistX, sideDistY), active);
+        __m128i takeY = _mm_andnot_si128(takeX, active);
+
+        sideDistX = _mm_add_epi32(sideDistX, _mm_and_si128(deltaX, takeX));
+        sideDistY = _mm_add_epi32(sideDistY, _mm_and_si128(deltaY, takeY));
+        mapX = _mm_add_epi32(mapX, _mm_and_si128(stepX, takeX));
+        mapY = _mm_add_epi32(mapY, _mm_and_si128(stepY, takeY));
+        side = _mm_or_si128(_mm_andnot_si128(takeX, side), _mm_and_si128(takeY, oneI));
+
+        _mm_store_si128((__m128i*)mx, mapX);
+        _mm_store_si128((__m128i*)my, mapY);
+
+        // As in march_lanes(), a packet still in one cell shares its lookup.
+        __m128i sameCell = _mm_and_si128(_mm_cmpeq_epi32(mapX, _mm_shuffle_epi32(mapX, 0)),
+                                         _mm_cmpeq_epi32(mapY, _mm_shuffle_epi32(mapY, 0)));
+        if (activeBits == allLanes && _mm_movemask_epi8(sameCell) == 0xFFFF) {
+            if (mx[0] < 0 || mx[0] >= MAP_SIZE || my[0] < 0 || my[0] >= MAP_SIZE) {
+                activeBits = 0;
+            } else if (tile_class(MAPDATA[my[0] * MAP_SIZE + mx[0]]) & RAY_STOP_WALLS) {
+                hitBits = allLanes;
+                activeBits = 0;
+            }
+        } else {
+            for (int i = 0; i < RAY_PACKET; i++) {
+                if (!(activeBits & (1 << i)))
+                    continue;
+
+                if (mx[i] < 0 || mx[i] >= MAP_SIZE || my[i] < 0 || my[i] >= MAP_SIZE) {
+                    activeBits &= ~(1 << i);
+                } else if (tile_class(MAPDATA[my[i] * MAP_SIZE + mx[i]]) & RAY_STOP_WALLS) {
+                    activeBits &= ~(1 << i);
+                    hitBits |= 1 << i;
+                }
+            }
+        }
+
+        __m128i bits = _mm_and_si128(_mm_set1_epi32(activeBits), laneBits);
+        active = _mm_cmpeq_epi32(bits, laneBits);
+    }
+
+    __m128i sideIsX = _mm_cmpeq_epi32(side, _mm_setzero_si128());
+    __m128i dist = _mm_or_si128(_mm_and_si128(sideIsX, _mm_sub_epi32(sideDistX, deltaX)),
+                                _mm_andnot_si128(sideIsX, _mm_sub_epi32(sideDistY, deltaY)));
+    alignas(16) int distance[RAY_PACKET], sides[RAY_PACKET];
+    _mm_store_si128((__m128i*)distance, dist);
+    _mm_store_si128((__m128i*)sides, side);
+    _mm_store_si128((__m128i*)mx, mapX);
+    _mm_store_si128((__m128i*)my, mapY);
+
+    for (int i = 0; i < RAY_PACKET; i++)
+        fixed_wall_hit(cam, x + i, mx[i], my[i], sides[i], distance[i], (hitBits >> i) & 1, &out[i]);
+#else
+    for (int i = 0; i < RAY_PACKET; i++)
+        cast_wall_fixed(cam, x + i, &out[i]);
+#endif
+}
+
+void cast_walls(const CameraTable& cam, WallHit* hits, int usePacket, int useFixed)
+{
+    int x = 0;
+    if (usePacket) {
+        for (; x + RAY_PACKET <= cam.width; x += RAY_PACKET) {
+            if (useFixed)
+                cast_walls_fixed_packet(cam, x, &hits[x]);
+            else
+                cast_walls_packet(cam, x, &hits[x]);
+        }
+    }
+    for (; x < cam.width; x++) {
+        if (useFixed)
+            cast_wall_fixed(cam, x, &hits[x]);
+        else
+            cast_wall_scalar(cam, x, &hits[x]);
+    }
+}
+
+#if RAYCAST_SSE2
+static void trace_ray_packet(const Ray* rays, int stopMask, RayHit* out)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 farDist = _mm_set1_ps(1e30f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128i oneI = _mm_set1_epi32(1);
+
+    alignas(16) float px[RAY_PACKET], py[RAY_PACKET], dx[RAY_PACKET], dy[RAY_PACKET], maxDist[RAY_PACKET];
+    alignas(16) int mx[RAY_PACKET], my[RAY_PACKET];
+    for (int i = 0; i < RAY_PACKET; i++) {
+        px[i] = rays[i].x;
+        py[i] = rays[i].y;
+        dx[i] = rays[i].dirX;
+        dy[i] = rays[i].dirY;
+        maxDist[i] = rays[i].maxDist;
+        mx[i] = (int)rays[i].x;
+        my[i] = (int)rays[i].y;
+    }
+
+    __m128 dirX = _mm_load_ps(dx);
+    __m128 dirY = _mm_load_ps(dy);
+    __m128 negX = _mm_cmplt_ps(dirX, zero);
+    __m128 negY = _mm_cmplt_ps(dirY, zero);
+
+    RayLanes l;
+    l.deltaX = select_ps(_mm_cmpeq_ps(dirX, zero), farDist, _mm_and_ps(_mm_div_ps(one, dirX), absMask));
+    l.deltaY = select_ps(_mm_cmpeq_ps(dirY, zero), farDist, _mm_and_ps(_mm_div_ps(one, dirY), absMask));
+    l.stepX = _mm_or_si128(_mm_castps_si128(negX), oneI);
+    l.stepY = _mm_or_si128(_mm_castps_si128(negY), oneI);
+
+    init_lanes(l, _mm_load_ps(px), _mm_load_ps(py),
+               _mm_load_si128((const __m128i*)mx), _mm_load_si128((const __m128i*)my),
+               negX, negY);
+
+    LaneResult res;
+    march_lanes(l, stopMask, 1, _mm_load_ps(maxDist), res);
+
+    for (int i = 0; i < RAY_PACKET; i++) {
+        int hit = (res.hitBits >> i) & 1;
+        out[i].cellX = res.mapX[i];
+        out[i].cellY = res.mapY[i];
+        out[i].distance = res.distance[i];
+        out[i].side = res.side[i];
+        out[i].hit = hit;
+        out[i].tile = hit ? res.tile[i] : 0;
+        out[i].entity = (hit && tile_class(res.tile[i]) == RAY_STOP_OBJECTS)
+            ? res.mapY[i] * MAP_SIZE + res.mapX[i]
+            : -1;
+    }
+}
+#endif
+
+#if RAYCAST_SSE2
+// Lockstep marching only pays off when the rays walk mostly the same cells:
+// a shared starting cell and directions within about 25 degrees.
+static int is_coherent(const Ray* rays)
+{
+    int mapX = (int)rays[0].x, mapY = (int)rays[0].y;
+    float len0 = sqrtf(rays[0].dirX * rays[0].dirX + rays[0].dirY * rays[0].dirY);
+
+    for (int i = 1; i < RAY_PACKET; i++) {
+        if ((int)rays[i].x != mapX || (int)rays[i].y != mapY)
+            return 0;
+
+        float len = sqrtf(rays[i].dirX * rays[i].dirX + rays[i].dirY * rays[i].dirY);
+        float dot = rays[0].dirX * rays[i].dirX + rays[0].dirY * rays[i].dirY;
+        if (dot < 0.9f * len0 * len)
+            return 0;
+    }
+    return 1;
+}
+#endif
+
+void trace_rays(const Ray* rays, int count, int stopMask, RayHit* hits)
+{
+    int i = 0;
+#if RAYCAST_SSE2
+    for (; i + RAY_PACKET <= count; i += RAY_PACKET) {
+        if (is_coherent(&rays[i])) {
+            trace_ray_packet(&rays[i], stopMask, &hits[i]);
+        } else {
+            for (int j = 0; j < RAY_PACKET; j++)
+                trace_ray_scalar(rays[i + j], stopMask, &hits[i + j]);
+        }
+    }
+#endif
+    for (; i < count; i++)
+        trace_ray_scalar(rays[i], stopMask, &hits[i]);
+}
@@ -0,0 +1,59 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include "camera.h"
+
+struct WallHit {
+    float rayDirX, rayDirY;
+    float perpWallDist;
+    int mapX, mapY;
+    int side;
+    int hit;
+    // 16.16 forms of rayDir and perpWallDist, only set by the fixed-point
+    // casts.
+    int rayDirXFixed, rayDirYFixed;
+    int perpWallDistFixed;
+};
+
+// A hitscan query: origin, direction and the farthest distance (in units of
+// the direction's length) at which a hit still counts.
+struct Ray {
+    float x, y;
+    float dirX, dirY;
+    float maxDist;
+};
+
+struct RayHit {
+    int cellX, cellY;
+    float distance;
+    int side;
+    int hit;
+    // Tile value of the hit cell, 0 on a miss.
+    int tile;
+    // Cell index of the destructible object that was hit, -1 otherwise.
+    int entity;
+};
+
+// Which tiles stop a ray in trace_rays().
+enum RayStop {
+    RAY_STOP_WALLS = 1,
+    RAY_STOP_OBJECTS = 2
+};
+
+// Number of rays marched together by the packet tracers.
+constexpr int RAY_PACKET = 4;
+
+void cast_wall_scalar(const CameraTable& cam, int x, WallHit* out);
+void cast_walls_packet(const CameraTable& cam, int x, WallHit* out);
+// The same DDA in 16.16 integers from the fixed columns of the camera
+// table. Hits the same cells as the float cast except where a ray passes
+// within rounding distance of a grid corner.
+void cast_wall_fixed(const CameraTable& cam, int x, WallHit* out);
+void cast_walls_fixed_packet(const CameraTable& cam, int x, WallHit* out);
+void cast_walls(const CameraTable& cam, WallHit* hits, int usePacket, int useFixed);
+
+// Traces count independent rays through the map grid with the same packet
+// DDA the wall pass uses. Never allocates and never modifies MAPDATA.
+void trace_rays(const Ray* rays, int count, int stopMask, RayHit* hits);
+
+#endif
\ No newline at end of file
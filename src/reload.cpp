@@ -0,0 +1,232 @@
+#include "pch.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// A changed file, loaded and waiting to be swapped in.
+struct ReloadItem {
+    std::string name;
+    int isMap;
+    TextureImage image;
+    MapSource map;
+};
+
+static std::thread watcher;
+static std::atomic<int> stopping(0);
+static int running = 0;
+static std::string watchDir;
+static std::string watchMap;
+#ifdef __linux__
+static int notifyFd = -1;
+#endif
+
+static std::mutex lock;
+static std::vector<ReloadItem> ready;
+// Images swapped out by the render thread, freed by the watcher.
+static std::vector<TextureImage> retired;
+static ReloadStats stats;
+
+static std::string asset_path(const std::string& name)
+{
+    return (std::filesystem::path(watchDir) / name).string();
+}
+
+static void load_changed(const std::vector<std::string>& names)
+{
+    for (const std::string& name : names) {
+        ReloadItem item;
+        item.name = name;
+        item.isMap = name == watchMap;
+        memset(&item.image, 0, sizeof(item.image));
+        if (item.isMap) {
+            std::ifstream file(asset_path(name));
+            if (!file.is_open() || !parse_map(file, &item.map)) {
+                std::cerr << "err reloading map file " << name << std::endl;
+                continue;
+            }
+        }
+        else if (!texture_uses_file(name.c_str()) || !decode_texture(asset_path(name).c_str(), &item.image)) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+        ready.push_back(std::move(item));
+    }
+}
+
+static void free_retired()
+{
+    std::vector<TextureImage> done;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        done.swap(retired);
+    }
+    for (TextureImage& image : done)
+        free_texture_image(&image);
+}
+
+#ifdef __linux__
+// Names from every event waiting on the inotify descriptor.
+static void read_events(std::vector<std::string>& names)
+{
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+        ssize_t size = read(notifyFd, buffer, sizeof(buffer));
+        if (size <= 0)
+            return;
+        for (char* p = buffer; p < buffer + size;) {
+            const inotify_event* ev = (const inotify_event*)p;
+            if (ev->len > 0 && std::find(names.begin(), names.end(), ev->name) == names.end())
+                names.push_back(ev->name);
+            p += sizeof(inotify_event) + ev->len;
+        }
+    }
+}
+
+static void watch_loop()
+{
+    // Decoding a big image takes several milliseconds. On a single core it
+    // would preempt the render thread mid-frame, so the watcher only gets
+    // time nothing else wants.
+    sched_param param = {};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+
+    pollfd p = { notifyFd, POLLIN, 0 };
+    while (!stopping) {
+        int n = poll(&p, 1, 100);
+        free_retired();
+        if (n <= 0)
+            continue;
+
+        // Saving can take several writes; wait for the directory to go
+        // quiet before loading anything.
+        std::vector<std::string> names;
+        do {
+            read_events(names);
+        } while (!stopping && poll(&p, 1, 50) > 0);
+        load_changed(names);
+    }
+}
+#else
+static void watch_loop()
+{
+    std::vector<std::string> names = texture_files();
+    names.push_back(watchMap);
+
+    std::vector<std::filesystem::file_time_type> times(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        std::error_code ec;
+        times[i] = std::filesystem::last_write_time(asset_path(names[i]), ec);
+    }
+
+    while (!stopping) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        free_retired();
+        std::vector<std::string> changed;
+        for (size_t i = 0; i < names.size(); i++) {
+            std::error_code ec;
+            std::filesystem::file_time_type t = std::filesystem::last_write_time(asset_path(names[i]), ec);
+            if (!ec && t != times[i]) {
+                times[i] = t;
+                changed.push_back(names[i]);
+            }
+        }
+        load_changed(changed);
+    }
+}
+#endif
+
+int reload_start(const char* dir, const char* mapFile)
+{
+    reload_stop();
+    watchDir = dir;
+    watchMap = mapFile;
+
+#ifdef __linux__
+    notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notifyFd < 0 || inotify_add_watch(notifyFd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        std::cerr << "err watching " << dir << " for changes" << std::endl;
+        if (notifyFd >= 0)
+            close(notifyFd);
+        notifyFd = -1;
+        return 0;
+    }
+#endif
+
+    stats = ReloadStats();
+    stopping = 0;
+    watcher = std::thread(watch_loop);
+    running = 1;
+    return 1;
+}
+
+void reload_stop()
+{
+    if (!running)
+        return;
+    stopping = 1;
+    watcher.join();
+    running = 0;
+#ifdef __linux__
+    close(notifyFd);
+    notifyFd = -1;
+#endif
+
+    for (ReloadItem& item : ready)
+        free_texture_image(&item.image);
+    ready.clear();
+    free_retired();
+}
+
+void reload_poll()
+{
+    if (!running)
+        return;
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<ReloadItem> items;
+    {
+        std::unique_lock<std::mutex> guard(lock, std::try_to_lock);
+        if (guard.owns_lock())
+            items.swap(ready);
+    }
+
+    for (ReloadItem& item : items) {
+        if (item.isMap) {
+            apply_map(item.map, 1);
+            stats.maps++;
+        }
+        else if (swap_texture(item.name.c_str(), &item.image)) {
+            stats.textures++;
+        }
+        else {
+            continue;
+        }
+        stats.names.push_back(item.name);
+    }
+    if (!items.empty()) {
+        std::lock_guard<std::mutex> guard(lock);
+        for (ReloadItem& item : items)
+            retired.push_back(item.image);
+    }
+
+    // A frame that swapped something in has used its share already.
+    if (items.empty() && pvs.size == MAP_SIZE && !pvs.complete)
+        continue_pvs_build(RELOAD_PVS_SLICE_MS);
+    stats.maxPollMs = std::max(stats.maxPollMs,
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+ReloadStats reload_stats()
+{
+    return stats;
+}
@@ -0,0 +1,37 @@
+#ifndef RELOAD_H
+#define RELOAD_H
+
+#include <string>
+#include <vector>
+
+// Render thread time per frame that applying reloaded assets should stay
+// under. Swaps are pointer exchanges. A texture swap bumps
+// texture_generation(), and the next render() rebuilds what it derives from
+// the images: the sky panorama and the weapon mask. Rebuilding a stale
+// visibility set is the expensive part, and its slices aim at a quarter of
+// the budget to leave room for the chunk that runs over and for the cache
+// misses the slice leaves the frame with.
+constexpr double RELOAD_BUDGET_MS = 1.0;
+constexpr double RELOAD_PVS_SLICE_MS = 0.25;
+
+struct ReloadStats {
+    int textures;
+    int maps;
+    // Longest reload_poll() call.
+    double maxPollMs;
+    // Files swapped in, oldest first. Kept here rather than printed, since
+    // reload_poll() runs inside the frame.
+    std::vector<std::string> names;
+};
+
+// Watches dir for writes to the texture files and to mapFile, and loads
+// changed ones on a background thread. Uses inotify on Linux and polls
+// modification times elsewhere.
+int reload_start(const char* dir, const char* mapFile);
+void reload_stop();
+// Swaps in whatever finished loading since the last call. Call between
+// frames; it never waits for the watcher thread.
+void reload_poll();
+ReloadStats reload_stats();
+
+#endif
\ No newline at end of file
@@ -1,642 +1,1086 @@
-﻿#include "pch.h"
-
-RGBA skyColor = { 255, 255, 255, 255 };
-#define FOG_DENSITY 0.2f
-
-static RGBA apply_fog(RGBA color, float distance)
-{
-#if 1
-    float fog_factor = std::min(1.0f, clamp(distance * FOG_DENSITY, 0.0f, 1.0f));
-    color.r = static_cast<uint8_t>(color.r * (1 - fog_factor));
-    color.g = static_cast<uint8_t>(color.g * (1 - fog_factor));
-    color.b = static_cast<uint8_t>(color.b * (1 - fog_factor));
-#endif
-    return color;
-}
-
-static int trace(float startX, float startY, float dirX, float dirY, float maxDist)
-{
-    v3 mapPos = {
-        static_cast<float>((int)startX),
-        static_cast<float>((int)startY),
-        0.0f
-    };
-
-    v3 deltaDist = { fabsf(1.0f / dirX), fabsf(1.0f / dirY), 0 };
-    v3 step = {
-        static_cast<float>((dirX < 0) ? -1 : 1),
-        static_cast<float>((dirY < 0) ? -1 : 1),
-        0.0f
-    };
-
-    v3 sideDist = {
-        (dirX < 0) ? (startX - mapPos.x) * deltaDist.x
-                   : (mapPos.x + 1 - startX) * deltaDist.x,
-        (dirY < 0) ? (startY - mapPos.y) * deltaDist.y
-                   : (mapPos.y + 1 - startY) * deltaDist.y,
-        0
-    };
-
-    while (maxDist > 0) {
-        if (sideDist.x < sideDist.y) {
-            sideDist.x += deltaDist.x;
-            mapPos.x += step.x;
-        } else {
-            sideDist.y += deltaDist.y;
-            mapPos.y += step.y;
-        }
-
-        if (MAPDATA[(int)mapPos.y * MAP_SIZE + (int)mapPos.x] == 1) {
-            return 0;
-        }
-        maxDist -= 1.0f;
-    }
-
-    return 1;
-}
-
-static int is_visible(float targetX, float targetY)
-{
-    float deltaX = targetX - state.pos.x;
-    float deltaY = targetY - state.pos.y;
-    float distSq = deltaX * deltaX + deltaY * deltaY;
-
-    const float maxViewDistSq = 15.0f * 15.0f;
-    if (distSq > maxViewDistSq)
-        return 0;
-
-    float invDist = 1.0f / sqrtf(distSq);
-    return trace(state.pos.x, state.pos.y, deltaX * invDist, deltaY * invDist, sqrtf(distSq));
-}
-
-static void update_dynamic_lights(float deltaTime)
-{
-    for (DLight& light : dynamicLights) {
-        light.time += deltaTime;
-
-        const char flickerPattern[] = "mmamammmmammamamaaamammma";
-        int patternLength = sizeof(flickerPattern) - 1;
-        int patternIndex = (int)(light.time * 10) % patternLength;
-
-        switch (light.pattern) {
-        case CONSTANT:
-            break;
-        case PULSE:
-            light.intensity = 0.5f + 0.5f * sin(light.time * 2.0f);
-            break;
-        case FLICKER:
-            if (flickerPattern[patternIndex] == 'm') {
-                light.intensity = 1.0f;
-            } else {
-                light.intensity = 0.0f;
-            }
-            break;
-        }
-    }
-}
-
-static RGBA apply_dynamic_lights(RGBA color, float pixelX, float pixelY)
-{
-    for (const DLight& light : dynamicLights) {
-        float dx = pixelX - light.x;
-        float dy = pixelY - light.y;
-        float dist2 = dx * dx + dy * dy;
-        float radius2 = light.radius * light.radius;
-
-        if (dist2 < radius2) {
-            float influence = ((radius2 - dist2) * (radius2 - dist2)) / radius2;
-
-            color.r = clamp(color.r + (light.color.r * influence) / radius2, 0.0f, 255.0f);
-            color.g = clamp(color.g + (light.color.g * influence) / radius2, 0.0f, 255.0f);
-            color.b = clamp(color.b + (light.color.b * influence) / radius2, 0.0f, 255.0f);
-        }
-    }
-    return color;
-}
-
-static RGBA apply_tonemap(RGBA color)
-{
-#if 1
-    float influenceFactor = 1.0f * 0.5f;
-    float brightness = (color.r + color.g + color.b) / 3.0f;
-    float skyBrightness = (skyColor.r + skyColor.g + skyColor.b) / 3.0f;
-    float skyBrightnessFactor = 1.0f - (skyBrightness / 255.0f);
-    influenceFactor *= skyBrightnessFactor;
-    float threshold = 20.0f;
-    if (brightness < threshold) {
-        return color;
-    }
-
-    color.r = static_cast<uint8_t>(color.r * (1 - influenceFactor) + skyColor.r * influenceFactor);
-    color.g = static_cast<uint8_t>(color.g * (1 - influenceFactor) + skyColor.g * influenceFactor);
-    color.b = static_cast<uint8_t>(color.b * (1 - influenceFactor) + skyColor.b * influenceFactor);
-#endif
-
-    return color;
-}
-
-void apply_dither()
-{
-    static const uint8_t bayer_matrix[4][4] = {
-        { 0, 32, 8, 40 },
-        { 48, 16, 56, 24 },
-        { 12, 44, 4, 36 },
-        { 60, 28, 52, 20 }
-    };
-
-    for (int y = 0; y < SCREEN_HEIGHT; y++) {
-        for (int x = 0; x < SCREEN_WIDTH; x++) {
-            uint32_t color = state.pixels[y * SCREEN_WIDTH + x];
-
-            uint8_t r = (color >> 16) & 0xFF;
-            uint8_t g = (color >> 8) & 0xFF;
-            uint8_t b = color & 0xFF;
-
-            uint8_t bayerValue = bayer_matrix[y & 3][x & 3];
-            int dither_offset = bayerValue - 31;
-
-            r = clamp(r + (r * dither_offset >> 6), 0, 255);
-            g = clamp(g + (g * dither_offset >> 6), 0, 255);
-            b = clamp(b + (b * dither_offset >> 6), 0, 255);
-
-            r = (r / 32) * 32;
-            g = (g / 32) * 32;
-            b = (b / 32) * 32;
-
-            state.pixels[y * SCREEN_WIDTH + x] = (r << 16) | (g << 8) | b;
-        }
-    }
-}
-
-void apply_glitch()
-{
-    for (int y = 0; y < SCREEN_HEIGHT; y++) {
-        if (rand() % 10 < 2) {
-            int shift = (rand() % 20) - 10;
-            for (int x = SCREEN_WIDTH - 1; x >= 0; x--) {
-                int newX = x + shift;
-                if (newX >= 0 && newX < SCREEN_WIDTH) {
-                    state.pixels[y * SCREEN_WIDTH + newX] = state.pixels[y * SCREEN_WIDTH + x];
-                }
-            }
-        }
-    }
-
-    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
-        if (rand() % 50 == 0) {
-            uint32_t color = state.pixels[i];
-            uint8_t r = (color >> 16) & 0xFF;
-            uint8_t g = (color >> 8) & 0xFF;
-            uint8_t b = color & 0xFF;
-
-            r = (r + rand() % 100 - 50) & 0xFF;
-            g = (g + rand() % 100 - 50) & 0xFF;
-            b = (b + rand() % 100 - 50) & 0xFF;
-
-            state.pixels[i] = (r << 16) | (g << 8) | b;
-        }
-    }
-}
-
-static void onerender()
-{
-    SDL_UpdateTexture(state.texture, NULL, state.pixels, SCREEN_WIDTH * 4);
-    SDL_RenderCopyEx(state.renderer, state.texture, NULL, NULL, 0.0, NULL, SDL_FLIP_NONE);
-    SDL_RenderPresent(state.renderer);
-}
-
-static void render_entities()
-{
-    for (int i = 0; i < MAP_SIZE * MAP_SIZE; i++) {
-        if (MAPDATA[i] == 2) {
-            int mapX = i % MAP_SIZE;
-            int mapY = i / MAP_SIZE;
-
-            float spriteX = mapX + 0.5f - state.pos.x;
-            float spriteY = mapY + 0.5f - state.pos.y;
-
-            if (!is_visible(mapX, mapY)) {
-                continue;
-            }
-
-            float invDet = 1.0f / (state.plane.x * state.dir.y - state.dir.x * state.plane.y);
-            float transformX = invDet * (state.dir.y * spriteX - state.dir.x * spriteY);
-            float transformY = invDet * (-state.plane.y * spriteX + state.plane.x * spriteY);
-
-            if (transformY <= 0)
-                continue;
-
-            int spriteScreenX = (int)(((float)SCREEN_WIDTH / 2) * (1 + transformX / transformY));
-            int spriteHeight = abs((int)((float)SCREEN_HEIGHT / transformY));
-            int drawStartY = -((float)spriteHeight / 2) + ((float)SCREEN_HEIGHT / 2) + state.pitch;
-            drawStartY = std::max(drawStartY, 0);
-            int drawEndY = ((float)spriteHeight / 2) + ((float)SCREEN_HEIGHT / 2) + state.pitch;
-            drawEndY = std::min(drawEndY, SCREEN_HEIGHT - 1);
-
-            int spriteWidth = abs((int)(SCREEN_HEIGHT / transformY));
-            int drawStartX = -spriteWidth / 2 + spriteScreenX;
-            drawStartX = std::max(drawStartX, 0);
-            int drawEndX = spriteWidth / 2 + spriteScreenX;
-            drawEndX = std::min(drawEndX, SCREEN_WIDTH - 1);
-
-            int texWidth = state.tex_width[2];
-            int texHeight = state.tex_height[2];
-
-            for (int x = drawStartX; x < drawEndX; x++) {
-                int texX = (int)((x - ((float)-spriteWidth / 2 + spriteScreenX)) * texWidth / (float)spriteWidth);
-                if (texX < 0)
-                    texX = 0;
-                if (texX >= texWidth)
-                    texX = texWidth - 1;
-
-                for (int y = drawStartY; y < drawEndY; y++) {
-                    float realSpriteHeight = SCREEN_HEIGHT / transformY;
-                    float texPos = ((y - SCREEN_HEIGHT / 2.0f) + (realSpriteHeight / 2.0f) - state.pitch) * texHeight / realSpriteHeight;
-                    int texY = (int)texPos;
-                    if (texY < 0)
-                        texY = 0;
-                    if (texY >= texHeight)
-                        texY = texHeight - 1;
-
-                    float spriteDist = transformY;
-                    if (spriteDist < 0.05f) {
-                        continue;
-                    }
-
-                    RGBA color = get_texture_pixel(2, texX, texY);
-                    color = apply_fog(color, spriteDist);
-                    color = apply_tonemap(color);
-
-                    if (color.a > 0) {
-                        uint32_t bgColor = state.pixels[y * SCREEN_WIDTH + x];
-                        uint8_t bgR = bgColor & 0xFF;
-                        uint8_t bgG = (bgColor >> 8) & 0xFF;
-                        uint8_t bgB = (bgColor >> 16) & 0xFF;
-
-                        float alpha = color.a / 255.0f;
-
-                        uint8_t outR = (uint8_t)(color.r * alpha + bgR * (1.0f - alpha));
-                        uint8_t outG = (uint8_t)(color.g * alpha + bgG * (1.0f - alpha));
-                        uint8_t outB = (uint8_t)(color.b * alpha + bgB * (1.0f - alpha));
-
-                        state.pixels[y * SCREEN_WIDTH + x] = (outB << 16) | (outG << 8) | outR;
-                    }
-                }
-            }
-        }
-    }
-}
-
-static void render_sky(int skyHeight, float viewAngle)
-{
-    const int texWidth = state.tex_width[4];
-    const int texHeight = state.tex_height[4];
-    const int baseSkyHeight = SCREEN_HEIGHT / 2;
-    const float texPerPixel = 1.0f / SCREEN_WIDTH;
-
-    for (int screenY = 0; screenY < skyHeight; screenY++) {
-        int texY_unclamped = screenY - state.pitch;
-        if (texY_unclamped < 0)
-            texY_unclamped = 0;
-        else if (texY_unclamped >= baseSkyHeight)
-            texY_unclamped = baseSkyHeight - 1;
-
-        int texY = (texY_unclamped * texHeight) / baseSkyHeight;
-
-        for (int x = 0; x < SCREEN_WIDTH; x++) {
-            float texU = viewAngle - ((float)x * texPerPixel);
-            if (texU < 0.0f)
-                texU += 1.0f;
-            else if (texU >= 1.0f)
-                texU -= 1.0f;
-
-            int texX = (int)(texU * texWidth);
-
-            RGBA color = get_texture_pixel(4, texX, texY);
-            uint32_t pixel = (color.b << 16) | (color.g << 8) | color.r;
-
-            state.pixels[screenY * SCREEN_WIDTH + x] = pixel;
-        }
-    }
-}
-
-static void render_floor(int horizon)
-{
-    for (int y = horizon; y < SCREEN_HEIGHT; y++) {
-        int p = y - horizon;
-        if (p == 0)
-            p = 1;
-
-        float rowDist = (0.5f * SCREEN_HEIGHT) / p;
-
-        float floorX = state.pos.x + rowDist * (state.dir.x - state.plane.x);
-        float floorY = state.pos.y + rowDist * (state.dir.y - state.plane.y);
-
-        float floorStepX = 2.0f * rowDist * state.plane.x / SCREEN_WIDTH;
-        float floorStepY = 2.0f * rowDist * state.plane.y / SCREEN_WIDTH;
-
-        for (int x = 0; x < SCREEN_WIDTH; x++) {
-            int texWidth = state.tex_width[1];
-            int texHeight = state.tex_height[1];
-
-            int texX = ((int)(floorX * texWidth)) % texWidth;
-            if (texX < 0)
-                texX += texWidth;
-
-            int texY = ((int)(floorY * texHeight)) % texHeight;
-            if (texY < 0)
-                texY += texHeight;
-
-            RGBA color = get_texture_pixel(1, texX, texY);
-            color = apply_tonemap(color);
-            color = apply_fog(color, rowDist);
-            color = apply_dynamic_lights(color, floorX, floorY);
-
-            state.pixels[y * SCREEN_WIDTH + x] = (color.b << 16) | (color.g << 8) | color.r;
-
-            floorX += floorStepX;
-            floorY += floorStepY;
-        }
-    }
-}
-
-static void render_other()
-{
-    const int baseSkyHeight = SCREEN_HEIGHT / 2;
-    int horizon = baseSkyHeight + state.pitch;
-    if (horizon < 0)
-        horizon = 0;
-    if (horizon > SCREEN_HEIGHT)
-        horizon = SCREEN_HEIGHT;
-
-    float yaw = atan2f(state.dir.y, state.dir.x);
-    float viewAngle = yaw / (2.0f * M_PI);
-    if (viewAngle < 0.0f)
-        viewAngle += 1.0f;
-
-    render_sky(horizon, viewAngle);
-    render_floor(horizon);
-}
-
-static void render_walls()
-{
-    for (int x = 0; x < SCREEN_WIDTH; ++x) {
-        int cameraX_fixed = ((2 * x) << 16) / SCREEN_WIDTH - (1 << 16);
-
-        float rayDirX = state.dir.x + ((state.plane.x * cameraX_fixed) / 65536.0f);
-        float rayDirY = state.dir.y + ((state.plane.y * cameraX_fixed) / 65536.0f);
-
-        int mapX = (int)state.pos.x;
-        int mapY = (int)state.pos.y;
-
-        float deltaDistX = (rayDirX == 0) ? 1e30f : fabsf(1.0f / rayDirX);
-        float deltaDistY = (rayDirY == 0) ? 1e30f : fabsf(1.0f / rayDirY);
-
-        float sideDistX, sideDistY;
-        int stepX = (rayDirX < 0) ? -1 : 1;
-        int stepY = (rayDirY < 0) ? -1 : 1;
-
-        sideDistX = (rayDirX < 0)
-            ? (state.pos.x - mapX) * deltaDistX
-            : (mapX + 1.0f - state.pos.x) * deltaDistX;
-
-        sideDistY = (rayDirY < 0)
-            ? (state.pos.y - mapY) * deltaDistY
-            : (mapY + 1.0f - state.pos.y) * deltaDistY;
-
-        int hit = 0, side = 0;
-        while (!hit) {
-            if (sideDistX < sideDistY) {
-                sideDistX += deltaDistX;
-                mapX += stepX;
-                side = 0;
-            } else {
-                sideDistY += deltaDistY;
-                mapY += stepY;
-                side = 1;
-            }
-
-            if (mapX < 0 || mapX >= (int)MAP_SIZE || mapY < 0 || mapY >= (int)MAP_SIZE)
-                break;
-
-            int tile = MAPDATA[mapY * MAP_SIZE + mapX];
-            if (tile && tile != 3 && tile != 2)
-                hit = 1;
-        }
-
-        if (!hit)
-            continue;
-
-        float perpWallDist = (side == 0)
-            ? (sideDistX - deltaDistX)
-            : (sideDistY - deltaDistY);
-
-        if (perpWallDist <= 0.01f)
-            perpWallDist = 0.01f;
-
-        int lineHeight = (int)(SCREEN_HEIGHT / perpWallDist);
-        int drawStart = (SCREEN_HEIGHT >> 1) - (lineHeight >> 1) + state.pitch;
-        int drawEnd = drawStart + lineHeight;
-
-        if (drawStart < 0)
-            drawStart = 0;
-        if (drawEnd >= SCREEN_HEIGHT)
-            drawEnd = SCREEN_HEIGHT - 1;
-
-        float wallHit = (side == 0)
-            ? state.pos.y + perpWallDist * rayDirY
-            : state.pos.x + perpWallDist * rayDirX;
-        wallHit -= (int)wallHit;
-
-        int texId = MAPDATA[mapY * MAP_SIZE + mapX] - 1;
-        int texW = state.tex_width[texId];
-        int texH = state.tex_height[texId];
-
-        int texX = (int)(wallHit * texW);
-        if ((side == 0 && rayDirX > 0) || (side == 1 && rayDirY < 0))
-            texX = texW - texX - 1;
-
-        float step = (float)texH / lineHeight;
-        float texPos = (drawStart - SCREEN_HEIGHT / 2.0f + lineHeight / 2.0f - state.pitch) * step;
-
-        for (int y = drawStart; y <= drawEnd; ++y) {
-            int texY = (int)texPos;
-            texPos += step;
-
-            texY = (texY < 0) ? 0 : ((texY >= texH) ? texH - 1 : texY);
-
-            RGBA color = get_texture_pixel(texId, texX, texY);
-            color = apply_tonemap(color);
-            color = apply_fog(color, perpWallDist);
-            color = apply_dynamic_lights(color, state.pos.x + rayDirX * perpWallDist, state.pos.y + rayDirY * perpWallDist);
-            if (side == 1) {
-                color.r >>= 1;
-                color.g >>= 1;
-                color.b >>= 1;
-            }
-
-            state.pixels[y * SCREEN_WIDTH + x] = (color.b << 16) | (color.g << 8) | color.r;
-        }
-    }
-}
-
-static void render_weapon()
-{
-    SDL_Surface* weaponTexture = state.textures[5];
-    if (!weaponTexture || !weaponTexture->pixels) {
-        return;
-    }
-
-    int weaponWidth = state.tex_width[5];
-    int weaponHeight = state.tex_height[5];
-
-    float desiredScreenRatio = 0.3f;
-
-    float scale = (SCREEN_WIDTH * desiredScreenRatio) / weaponWidth;
-
-    if (scale < 0.5f)
-        scale = 0.5f;
-    if (scale > 2.5f)
-        scale = 2.5f;
-
-    int newWeaponWidth = (int)(weaponWidth * scale);
-    int newWeaponHeight = (int)(weaponHeight * scale);
-
-    int xOffset = (SCREEN_WIDTH - newWeaponWidth) / 2;
-    int yOffset = SCREEN_HEIGHT - newWeaponHeight;
-
-    uint32_t* weaponPixels = (uint32_t*)weaponTexture->pixels;
-
-    for (int y = 0; y < newWeaponHeight; y++) {
-        for (int x = 0; x < newWeaponWidth; x++) {
-            int origX = (int)(x / scale);
-            int origY = (int)(y / scale);
-
-            if (origX < 0 || origX >= weaponWidth || origY < 0 || origY >= weaponHeight)
-                continue;
-
-            uint32_t color = weaponPixels[origY * weaponWidth + origX];
-
-            uint8_t a = (color >> 24) & 0xFF;
-            if (a == 0)
-                continue;
-
-            uint8_t r = (color >> 16) & 0xFF;
-            uint8_t g = (color >> 8) & 0xFF;
-            uint8_t b = color & 0xFF;
-
-            RGBA weaponColor = { b, g, r, a };
-            weaponColor = apply_tonemap(weaponColor);
-            weaponColor = apply_dynamic_lights(weaponColor, state.pos.x, state.pos.y);
-
-            int pixelX = x + xOffset;
-            int pixelY = y + yOffset;
-
-            if (pixelX < 0 || pixelX >= SCREEN_WIDTH || pixelY < 0 || pixelY >= SCREEN_HEIGHT)
-                continue;
-
-            state.pixels[pixelY * SCREEN_WIDTH + pixelX] = (weaponColor.b << 16) | (weaponColor.g << 8) | weaponColor.r;
-        }
-    }
-}
-
-static void draw_line(int x0, int y0, int x1, int y1, RGBA color)
-{
-    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
-    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
-    int err = dx + dy, e2;
-
-    while (1) {
-        if (x0 >= 0 && x0 < SCREEN_WIDTH && y0 >= 0 && y0 < SCREEN_HEIGHT) {
-            uint32_t* dst_pixel = &state.pixels[y0 * SCREEN_WIDTH + x0];
-            uint32_t dst_color = *dst_pixel;
-
-            uint8_t dst_r = (dst_color >> 16) & 0xFF;
-            uint8_t dst_g = (dst_color >> 8) & 0xFF;
-            uint8_t dst_b = dst_color & 0xFF;
-
-            float alpha = color.a / 255.0f;
-
-            uint8_t out_r = (uint8_t)(color.r * alpha + dst_r * (1.0f - alpha));
-            uint8_t out_g = (uint8_t)(color.g * alpha + dst_g * (1.0f - alpha));
-            uint8_t out_b = (uint8_t)(color.b * alpha + dst_b * (1.0f - alpha));
-
-            *dst_pixel = (out_r << 16) | (out_g << 8) | out_b;
-        }
-        if (x0 == x1 && y0 == y1)
-            break;
-        e2 = 2 * err;
-        if (e2 >= dy) {
-            err += dy;
-            x0 += sx;
-        }
-        if (e2 <= dx) {
-            err += dx;
-            y0 += sy;
-        }
-    }
-}
-
-static void render_bullet_trail()
-{
-    if (bulletTrail.size() < 2)
-        return;
-
-    float invDet = 1.0f / (state.plane.x * state.dir.y - state.dir.x * state.plane.y);
-
-    for (size_t i = 1; i < bulletTrail.size(); i++) {
-        auto& pos1 = bulletTrail[i - 1];
-        auto& pos2 = bulletTrail[i];
-
-        float spriteX1 = pos1.x - state.pos.x;
-        float spriteY1 = pos1.y - state.pos.y;
-
-        float spriteX2 = pos2.x - state.pos.x;
-        float spriteY2 = pos2.y - state.pos.y;
-
-        float transformX1 = invDet * (state.dir.y * spriteX1 - state.dir.x * spriteY1);
-        float transformY1 = invDet * (-state.plane.y * spriteX1 + state.plane.x * spriteY1);
-
-        float transformX2 = invDet * (state.dir.y * spriteX2 - state.dir.x * spriteY2);
-        float transformY2 = invDet * (-state.plane.y * spriteX2 + state.plane.x * spriteY2);
-
-        if (transformY1 <= 0 || transformY2 <= 0)
-            continue;
-
-        int screenX1 = (int)(((float)SCREEN_WIDTH / 2) * (1 + transformX1 / transformY1));
-        int screenX2 = (int)(((float)SCREEN_WIDTH / 2) * (1 + transformX2 / transformY2));
-
-        int screenY1 = (int)((float)SCREEN_HEIGHT / 2 + state.pitch);
-        int screenY2 = (int)((float)SCREEN_HEIGHT / 2 + state.pitch);
-
-        RGBA baseColor = { 0, 255, 0, 255 };
-
-        RGBA color1 = apply_fog(baseColor, transformY1);
-        RGBA color2 = apply_fog(baseColor, transformY2);
-
-        RGBA lineColor;
-        lineColor.r = (color1.r + color2.r) / 2;
-        lineColor.g = (color1.g + color2.g) / 2;
-        lineColor.b = (color1.b + color2.b) / 2;
-        lineColor.a = (color1.a + color2.a) / 2;
-
-        draw_line(screenX1, screenY1, screenX2, screenY2, lineColor);
-    }
-}
-
-void render(float deltaTime)
-{
-    memset(state.pixels, 0, SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t));
-
-    update_dynamic_lights(deltaTime);
-
-    render_other();
-    render_walls();
-    render_entities();
-    render_bullet_trail();
-    render_weapon();
-
-    // apply_glitch();
-    // apply_dither();
-    onerender();
-}
+﻿#include "pch.h"
+
+RGBA skyColor = { 255, 255, 255, 255 };
+#define FOG_DENSITY 0.2f
+
+// Fog as a channel multiplier in [0, 256], falling off linearly to black.
+static inline int fog_mul(float distance)
+{
+    return (int)((1.0f - clamp(distance * FOG_DENSITY, 0.0f, 1.0f)) * 256.0f);
+}
+
+static void update_dynamic_lights(float deltaTime)
+{
+    for (DLight& light : dynamicLights) {
+        light.time += deltaTime;
+
+        const char flickerPattern[] = "mmamammmmammamamaaamammma";
+        int patternLength = sizeof(flickerPattern) - 1;
+        int patternIndex = (int)(light.time * 10) % patternLength;
+
+        switch (light.pattern) {
+        case CONSTANT:
+            break;
+        case PULSE:
+            light.intensity = 0.5f + 0.5f * sin(light.time * 2.0f);
+            break;
+        case FLICKER:
+            if (flickerPattern[patternIndex] == 'm') {
+                light.intensity = 1.0f;
+            } else {
+                light.intensity = 0.0f;
+            }
+            break;
+        }
+    }
+}
+
+// Lights that can reach a visible floor or wall point this frame, as indices
+// into dynamicLights in the order they were added.
+static std::vector<int> frameLights;
+static std::vector<int> lightQuery;
+// Farthest visible floor or wall point from the player, set by trace_walls().
+static float viewReach = 0.0f;
+
+// The frame's lights binned by the map cells their radius covers, over the
+// box the lights span, so a point only sums the lights of its own cell. A
+// cell keeps at most LIGHTS_PER_CELL of them, lowest index first: the map's
+// own lights before projectiles, and older projectiles before newer ones.
+constexpr int LIGHTS_PER_CELL = 8;
+static std::vector<int> cellLightStart;
+static std::vector<int> cellLights;
+static std::vector<int> cellLightFill;
+static int lightGridX = 0, lightGridY = 0, lightGridW = 0, lightGridH = 0;
+
+// Runs a radius query into a reusable buffer, growing it when it was too
+// small for the result.
+static int query_spatial(std::vector<int>& buf, float x, float y, float radius, int kindMask)
+{
+    int found = spatial_query_radius(x, y, radius, kindMask, buf.data(), (int)buf.size());
+    if (found > (int)buf.size()) {
+        buf.resize(found);
+        found = spatial_query_radius(x, y, radius, kindMask, buf.data(), (int)buf.size());
+    }
+    return found;
+}
+
+// Cells a light's radius box covers. Any point strictly inside the radius
+// lies in one of them.
+static void light_cells(const DLight& light, int& x0, int& y0, int& x1, int& y1)
+{
+    x0 = (int)floorf(light.x - light.radius);
+    y0 = (int)floorf(light.y - light.radius);
+    x1 = (int)floorf(light.x + light.radius);
+    y1 = (int)floorf(light.y + light.radius);
+}
+
+static void cull_lights()
+{
+    frameLights.clear();
+    int found = query_spatial(lightQuery, state.pos.x, state.pos.y, viewReach, SPATIAL_MASK(SPATIAL_LIGHT));
+    for (int i = 0; i < found; i++) {
+        int id = spatial.entries[lightQuery[i]].id;
+        if (id < (int)dynamicLights.size())
+            frameLights.push_back(id);
+    }
+    std::sort(frameLights.begin(), frameLights.end());
+
+    lightGridW = lightGridH = 0;
+    if (frameLights.empty())
+        return;
+    int minX, minY, maxX, maxY;
+    light_cells(dynamicLights[frameLights[0]], minX, minY, maxX, maxY);
+    for (int li : frameLights) {
+        int x0, y0, x1, y1;
+        light_cells(dynamicLights[li], x0, y0, x1, y1);
+        minX = std::min(minX, x0);
+        minY = std::min(minY, y0);
+        maxX = std::max(maxX, x1);
+        maxY = std::max(maxY, y1);
+    }
+    lightGridX = minX;
+    lightGridY = minY;
+    lightGridW = maxX - minX + 1;
+    lightGridH = maxY - minY + 1;
+
+    // Counted, capped, then filled in light order, so each cell holds the
+    // first lights that reach it.
+    cellLightStart.assign(lightGridW * lightGridH + 1, 0);
+    for (int li : frameLights) {
+        int x0, y0, x1, y1;
+        light_cells(dynamicLights[li], x0, y0, x1, y1);
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                int& count = cellLightStart[(y - lightGridY) * lightGridW + (x - lightGridX) + 1];
+                count = std::min(count + 1, LIGHTS_PER_CELL);
+            }
+        }
+    }
+    for (int c = 0; c < lightGridW * lightGridH; c++)
+        cellLightStart[c + 1] += cellLightStart[c];
+    cellLights.resize(cellLightStart.back());
+    cellLightFill.assign(cellLightStart.begin(), cellLightStart.end() - 1);
+    for (int li : frameLights) {
+        int x0, y0, x1, y1;
+        light_cells(dynamicLights[li], x0, y0, x1, y1);
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                int c = (y - lightGridY) * lightGridW + (x - lightGridX);
+                if (cellLightFill[c] < cellLightStart[c + 1])
+                    cellLights[cellLightFill[c]++] = li;
+            }
+        }
+    }
+}
+
+// Light the frame's dynamic lights add at a point, each channel capped at
+// 255.
+static Pixel light_add(float pixelX, float pixelY)
+{
+    int cx = (int)floorf(pixelX) - lightGridX;
+    int cy = (int)floorf(pixelY) - lightGridY;
+    if (cx < 0 || cy < 0 || cx >= lightGridW || cy >= lightGridH)
+        return pixel_rgb(0, 0, 0);
+    int c = cy * lightGridW + cx;
+
+    float addR = 0.0f, addG = 0.0f, addB = 0.0f;
+    for (int n = cellLightStart[c]; n < cellLightStart[c + 1]; n++) {
+        const DLight& light = dynamicLights[cellLights[n]];
+        float dx = pixelX - light.x;
+        float dy = pixelY - light.y;
+        float dist2 = dx * dx + dy * dy;
+        float radius2 = light.radius * light.radius;
+
+        if (dist2 < radius2) {
+            float influence = ((radius2 - dist2) * (radius2 - dist2)) / radius2;
+            addR += (light.color.r * influence) / radius2;
+            addG += (light.color.g * influence) / radius2;
+            addB += (light.color.b * influence) / radius2;
+        }
+    }
+    return pixel_rgb((int)std::min(addR, 255.0f), (int)std::min(addG, 255.0f), (int)std::min(addB, 255.0f));
+}
+
+// Registry handles of the textures drawn outside the wall pass, resolved
+// once in init_renderer().
+static TextureHandle floorTexture = TEXTURE_NONE;
+static TextureHandle enemyTexture = TEXTURE_NONE;
+static TextureHandle skyTexture = TEXTURE_NONE;
+static TextureHandle weaponTexture = TEXTURE_NONE;
+static uint32_t texturesSeen = 0;
+
+// Pixels brighter than a dim threshold are pulled toward the sky colour,
+// more so the darker the sky. Refreshed once per frame since skyColor is
+// constant for the whole frame.
+static int toneMix = 0;
+static Pixel toneSky = 0;
+
+static void setup_tonemap()
+{
+    float skyBrightness = (skyColor.r + skyColor.g + skyColor.b) / 3.0f;
+    float influenceFactor = 0.5f * (1.0f - (skyBrightness / 255.0f));
+    int k = (int)(influenceFactor * 256.0f + 0.5f);
+
+    toneMix = k;
+    toneSky = pixel_rgb(skyColor);
+}
+
+static inline Pixel tonemap(Pixel p)
+{
+    if (pixel_r(p) + pixel_g(p) + pixel_b(p) < 60)
+        return p;
+    return pixel_lerp(p, toneSky, toneMix);
+}
+
+// Shading for palette-indexed textures: the screen pixel for every palette
+// entry at every fog level, with the tonemap applied, for front and side
+// walls. Rebuilt when the palette or the tonemap changes.
+constexpr int COLORMAP_LIGHTS = 32;
+static Pixel colormap[2][COLORMAP_LIGHTS][PALETTE_COLORS];
+static int colormapMix = -1;
+
+static int indexedTextures = USE_INDEXED_TEXTURES;
+static const IndexedImage* wallIndexed[TEXTURE_TILES];
+
+static inline int fog_light(int fogMul)
+{
+    return (fogMul * (COLORMAP_LIGHTS - 1) + 128) >> 8;
+}
+
+static void setup_colormap()
+{
+    if (colormapMix == toneMix)
+        return;
+    colormapMix = toneMix;
+
+    for (int light = 0; light < COLORMAP_LIGHTS; light++) {
+        int fogMul = (light * 256 + (COLORMAP_LIGHTS - 1) / 2) / (COLORMAP_LIGHTS - 1);
+        for (int i = 0; i < PALETTE_COLORS; i++) {
+            Pixel p = pixel_scale(tonemap(palette[i] & PIXEL_RGB_MASK), fogMul);
+            colormap[0][light][i] = p;
+            colormap[1][light][i] = pixel_half(p);
+        }
+    }
+}
+
+// Converts the wall and floor textures to one shared palette. Sprites and
+// the weapon blend by alpha and keep drawing from the 32-bit images.
+static void index_textures()
+{
+    std::vector<const TextureImage*> images;
+    for (int tile = 0; tile < TEXTURE_TILES; tile++) {
+        if (wallTextures[tile])
+            images.push_back(wallTextures[tile]);
+    }
+    if (texture_image(floorTexture))
+        images.push_back(texture_image(floorTexture));
+
+    if (!build_palette(images.data(), (int)images.size())) {
+        indexedTextures = 0;
+        return;
+    }
+    for (int tile = 0; tile < TEXTURE_TILES; tile++)
+        wallIndexed[tile] = wallTextures[tile] ? indexed_image(wallTextures[tile]) : NULL;
+    colormapMix = -1;
+}
+
+// After a reload only the swapped images are converted, against the palette
+// already built; a new median cut would stall the frame for tens of
+// milliseconds.
+static void refresh_indexed_textures()
+{
+    for (int tile = 0; tile < TEXTURE_TILES; tile++) {
+        if (wallTextures[tile])
+            index_image(wallTextures[tile]);
+    }
+    if (texture_image(floorTexture))
+        index_image(texture_image(floorTexture));
+    for (int tile = 0; tile < TEXTURE_TILES; tile++)
+        wallIndexed[tile] = wallTextures[tile] ? indexed_image(wallTextures[tile]) : NULL;
+}
+
+// Everything in the wall shading chain that is constant along one column:
+// fog depends only on perpWallDist, and the dynamic lights are sampled at the
+// column's hit point.
+struct ColumnShade {
+    int fogMul;
+    Pixel light;
+    int side;
+};
+
+static ColumnShade column_shade(float distance, float hitX, float hitY, int side)
+{
+    ColumnShade cs;
+    cs.fogMul = fog_mul(distance);
+    cs.light = light_add(hitX, hitY);
+    cs.side = side;
+    return cs;
+}
+
+static inline Pixel shade_texel(Pixel texel, const ColumnShade& cs)
+{
+    Pixel p = pixel_add_sat(pixel_scale(tonemap(texel & PIXEL_RGB_MASK), cs.fogMul), cs.light);
+    return cs.side ? pixel_half(p) : p;
+}
+
+// Draws count pixels down one screen column starting at dst. texPos and
+// texStep are 16.16 texel rows. When the wall is magnified every texel
+// covers several screen rows, so it is shaded once and filled as a run.
+static void blit_wall_column(Pixel* dst, int count, const Pixel* texColumn, int texStride,
+                             int texH, int texPos, int texStep, const ColumnShade& cs)
+{
+    if (texStep <= 0)
+        return;
+
+    int y = 0;
+    if (texStep < (1 << 16)) {
+        while (y < count) {
+            int texY = texPos >> 16;
+            texY = (texY < 0) ? 0 : ((texY >= texH) ? texH - 1 : texY);
+
+            int run = count - y;
+            if (texY < texH - 1) {
+                int untilNext = ((texY + 1) << 16) - texPos;
+                run = std::min(run, (untilNext + texStep - 1) / texStep);
+            }
+
+            Pixel pixel = shade_texel(texColumn[texY * texStride], cs);
+            for (int i = 0; i < run; i++) {
+                *dst = pixel;
+                dst += SCREEN_WIDTH;
+            }
+
+            y += run;
+            texPos += run * texStep;
+        }
+    } else {
+        for (; y < count; y++) {
+            int texY = texPos >> 16;
+            texY = (texY < 0) ? 0 : ((texY >= texH) ? texH - 1 : texY);
+            texPos += texStep;
+
+            *dst = shade_texel(texColumn[texY * texStride], cs);
+            dst += SCREEN_WIDTH;
+        }
+    }
+}
+
+// blit_wall_column() for a column of palette indices. shades is the
+// colormap row for the column's fog level; columns touched by a dynamic
+// light pass null and shade the palette colour in full instead.
+static void blit_indexed_column(Pixel* dst, int count, const uint8_t* texColumn, int texH,
+                                int texPos, int texStep, const Pixel* shades, const ColumnShade& cs)
+{
+    if (texStep <= 0)
+        return;
+
+    int y = 0;
+    while (y < count) {
+        int texY = texPos >> 16;
+        texY = (texY < 0) ? 0 : ((texY >= texH) ? texH - 1 : texY);
+
+        int run = 1;
+        if (texStep < (1 << 16)) {
+            run = count - y;
+            if (texY < texH - 1) {
+                int untilNext = ((texY + 1) << 16) - texPos;
+                run = std::min(run, (untilNext + texStep - 1) / texStep);
+            }
+        }
+
+        uint8_t index = texColumn[texY];
+        Pixel pixel = shades ? shades[index] : shade_texel(palette[index], cs);
+        for (int i = 0; i < run; i++) {
+            *dst = pixel;
+            dst += SCREEN_WIDTH;
+        }
+
+        y += run;
+        texPos += run * texStep;
+    }
+}
+
+static void onerender()
+{
+    if (!state.renderer)
+        return;
+
+    SDL_UpdateTexture(state.texture, NULL, state.pixels, SCREEN_WIDTH * 4);
+    SDL_RenderCopyEx(state.renderer, state.texture, NULL, NULL, 0.0, NULL, SDL_FLIP_NONE);
+    SDL_RenderPresent(state.renderer);
+}
+
+static WallHit wallHits[SCREEN_WIDTH];
+static int wallTop[SCREEN_WIDTH];
+static int wallBottom[SCREEN_WIDTH];
+
+// First row of each column from which the weapon's opaque pixels reach the
+// bottom of the screen. Nothing drawn there before render_weapon() survives.
+static int weaponTop[SCREEN_WIDTH];
+
+// Highest row covered by either a wall or the weapon in any column.
+static int minCoveredTop = SCREEN_HEIGHT;
+
+static inline int is_occluded(int x, int y)
+{
+    return (y >= wallTop[x] && y <= wallBottom[x]) || y >= weaponTop[x];
+}
+
+struct Sprite {
+    float x, y;
+    float distSq;
+    // Projectile slot + 1 for projectiles, which are drawn as glowing
+    // squares instead of the enemy texture; 0 otherwise.
+    int projectile;
+};
+
+// Line-of-sight queries for the sprite pass, reused every frame.
+static std::vector<Ray> spriteRays;
+static std::vector<RayHit> spriteHits;
+static std::vector<Sprite> spriteCandidates;
+static std::vector<Sprite> sprites;
+static std::vector<int> spriteQuery;
+
+static void add_sprite_candidate(int viewCell, float x, float y, float maxDistSq, int projectile)
+{
+    if (!pvs_visible(viewCell, (int)y * MAP_SIZE + (int)x))
+        return;
+
+    float deltaX = x - state.pos.x;
+    float deltaY = y - state.pos.y;
+    float distSq = deltaX * deltaX + deltaY * deltaY;
+    if (distSq > maxDistSq || distSq == 0.0f)
+        return;
+
+    float dist = sqrtf(distSq);
+    spriteRays.push_back({ state.pos.x, state.pos.y, deltaX / dist, deltaY / dist, dist });
+    spriteCandidates.push_back({ x, y, distSq, projectile });
+}
+
+// Collects the objects and actors within view range from the spatial grid,
+// drops those the visibility set rules out, traces the line of sight to the
+// rest in one batch and keeps the visible ones sorted back to front.
+static void find_visible_sprites()
+{
+    const float maxViewDist = 15.0f;
+
+    spriteRays.clear();
+    spriteCandidates.clear();
+
+    int found = query_spatial(spriteQuery, state.pos.x, state.pos.y, maxViewDist,
+                              SPATIAL_MASK(SPATIAL_OBJECT) | SPATIAL_MASK(SPATIAL_ACTOR) | SPATIAL_MASK(SPATIAL_PROJECTILE));
+    int viewCell = (int)state.pos.y * MAP_SIZE + (int)state.pos.x;
+    for (int i = 0; i < found; i++) {
+        const SpatialEntry& e = spatial.entries[spriteQuery[i]];
+        add_sprite_candidate(viewCell, e.x, e.y, maxViewDist * maxViewDist, e.kind == SPATIAL_PROJECTILE ? e.id + 1 : 0);
+    }
+
+    spriteHits.resize(spriteRays.size());
+    trace_rays(spriteRays.data(), (int)spriteRays.size(), RAY_STOP_WALLS, spriteHits.data());
+
+    sprites.clear();
+    for (size_t s = 0; s < spriteCandidates.size(); s++) {
+        if (!spriteHits[s].hit)
+            sprites.push_back(spriteCandidates[s]);
+    }
+    std::sort(sprites.begin(), sprites.end(),
+              [](const Sprite& a, const Sprite& b) { return a.distSq > b.distSq; });
+}
+
+// Projectiles are emissive: a flat square in their light colour, no fog.
+static uint64_t draw_projectile(int slot, float transformX, float transformY)
+{
+    const ProjectileInfo& info = projectileInfo[projectiles.type[slot]];
+    int screenX = (int)(((float)SCREEN_WIDTH / 2) * (1 + transformX / transformY));
+    int screenY = (int)((float)SCREEN_HEIGHT / 2 + state.pitch);
+    int half = std::max(1, (int)(SCREEN_HEIGHT * info.radius / transformY));
+
+    int x0 = std::max(screenX - half, 0), x1 = std::min(screenX + half, SCREEN_WIDTH);
+    int y0 = std::max(screenY - half, 0), y1 = std::min(screenY + half, SCREEN_HEIGHT);
+    Pixel color = pixel_rgb(info.lightColor);
+
+    uint64_t written = 0;
+    for (int x = x0; x < x1; x++) {
+        int columnEnd = std::min(y1, weaponTop[x]);
+        for (int y = y0; y < columnEnd; y++)
+            state.pixels[y * SCREEN_WIDTH + x] = color;
+        written += std::max(0, columnEnd - y0);
+    }
+    return written;
+}
+
+static void render_entities()
+{
+    uint64_t written = 0;
+    const TextureImage* enemy = texture_image(enemyTexture);
+
+    find_visible_sprites();
+
+    for (const Sprite& sprite : sprites) {
+        float spriteX = sprite.x - state.pos.x;
+        float spriteY = sprite.y - state.pos.y;
+
+        float invDet = camera.invDet;
+        float transformX = invDet * (state.dir.y * spriteX - state.dir.x * spriteY);
+        float transformY = invDet * (-state.plane.y * spriteX + state.plane.x * spriteY);
+
+        if (transformY <= 0)
+            continue;
+
+        if (sprite.projectile) {
+            written += draw_projectile(sprite.projectile - 1, transformX, transformY);
+            continue;
+        }
+        if (!enemy || transformY < 0.05f)
+            continue;
+
+        int spriteScreenX = (int)(((float)SCREEN_WIDTH / 2) * (1 + transformX / transformY));
+        int spriteHeight = abs((int)((float)SCREEN_HEIGHT / transformY));
+        int drawStartY = -((float)spriteHeight / 2) + ((float)SCREEN_HEIGHT / 2) + state.pitch;
+        drawStartY = std::max(drawStartY, 0);
+        int drawEndY = ((float)spriteHeight / 2) + ((float)SCREEN_HEIGHT / 2) + state.pitch;
+        drawEndY = std::min(drawEndY, SCREEN_HEIGHT - 1);
+
+        int spriteWidth = abs((int)(SCREEN_HEIGHT / transformY));
+        int drawStartX = -spriteWidth / 2 + spriteScreenX;
+        drawStartX = std::max(drawStartX, 0);
+        int drawEndX = spriteWidth / 2 + spriteScreenX;
+        drawEndX = std::min(drawEndX, SCREEN_WIDTH - 1);
+
+        int texWidth = enemy->mips[0].width;
+        int texHeight = enemy->mips[0].height;
+        const Pixel* texels = enemy->mips[0].rows;
+        int fogMul = fog_mul(transformY);
+
+        for (int x = drawStartX; x < drawEndX; x++) {
+            int texX = (int)((x - ((float)-spriteWidth / 2 + spriteScreenX)) * texWidth / (float)spriteWidth);
+            if (texX < 0)
+                texX = 0;
+            if (texX >= texWidth)
+                texX = texWidth - 1;
+
+            int columnEndY = std::min(drawEndY, weaponTop[x]);
+            for (int y = drawStartY; y < columnEndY; y++) {
+                float realSpriteHeight = SCREEN_HEIGHT / transformY;
+                float texPos = ((y - SCREEN_HEIGHT / 2.0f) + (realSpriteHeight / 2.0f) - state.pitch) * texHeight / realSpriteHeight;
+                int texY = (int)texPos;
+                if (texY < 0)
+                    texY = 0;
+                if (texY >= texHeight)
+                    texY = texHeight - 1;
+
+                Pixel texel = texels[texY * texWidth + texX];
+                if (pixel_a(texel) == 0)
+                    continue;
+
+                Pixel color = tonemap(pixel_scale(texel & PIXEL_RGB_MASK, fogMul));
+                Pixel& dst = state.pixels[y * SCREEN_WIDTH + x];
+                dst = pixel_lerp(dst, color, pixel_alpha_weight(texel));
+                written++;
+            }
+        }
+    }
+
+    profile_pixels(PROF_ENTITIES, written);
+}
+
+// Screen height of the wall a column hit, from whichever distance the cast
+// worked in. Walls more than SCREEN_HEIGHT away still cover one row, which
+// keeps the texture step in render_walls() finite.
+static int wall_line_height(const WallHit& wh)
+{
+    if (USE_FIXED_RAYCAST) {
+        int perpWallDist = std::max(wh.perpWallDistFixed, FIXED_ONE / 100);
+        return std::max(1, (int)(((int64_t)SCREEN_HEIGHT << FIXED_SHIFT) / perpWallDist));
+    }
+
+    float perpWallDist = wh.perpWallDist;
+    if (perpWallDist <= 0.01f)
+        perpWallDist = 0.01f;
+    return std::max(1, (int)(SCREEN_HEIGHT / perpWallDist));
+}
+
+// Casts every column and records the rows its wall will cover, so the
+// background passes can skip pixels that render_walls() overwrites anyway.
+// Columns without a wall get an empty span (top > bottom).
+static void trace_walls()
+{
+    cast_walls(camera, wallHits, USE_PACKET_RAYCAST, USE_FIXED_RAYCAST);
+
+    // Floor seen through a column without a wall reaches out to the row just
+    // below the horizon.
+    float floorReach = camera.rowDist[std::min(camera.horizon, SCREEN_HEIGHT - 1)];
+
+    minCoveredTop = SCREEN_HEIGHT;
+    viewReach = 0.0f;
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        minCoveredTop = std::min(minCoveredTop, weaponTop[x]);
+        wallTop[x] = SCREEN_HEIGHT;
+        wallBottom[x] = -1;
+
+        const WallHit& wh = wallHits[x];
+        int hasWall = wh.hit && wallTextures[MAPDATA[wh.mapY * MAP_SIZE + wh.mapX]];
+        float rayLength = sqrtf(wh.rayDirX * wh.rayDirX + wh.rayDirY * wh.rayDirY);
+        viewReach = std::max(viewReach, (hasWall ? wh.perpWallDist : floorReach) * rayLength);
+        if (!hasWall)
+            continue;
+
+        int lineHeight = wall_line_height(wh);
+        int drawStart = (SCREEN_HEIGHT >> 1) - (lineHeight >> 1) + state.pitch;
+        int drawEnd = drawStart + lineHeight;
+
+        if (drawStart < 0)
+            drawStart = 0;
+        if (drawEnd >= SCREEN_HEIGHT)
+            drawEnd = SCREEN_HEIGHT - 1;
+
+        if (drawStart <= drawEnd) {
+            wallTop[x] = drawStart;
+            wallBottom[x] = drawEnd;
+            minCoveredTop = std::min(minCoveredTop, drawStart);
+        }
+    }
+}
+
+// The sky texture pre-scaled to SCREEN_HEIGHT / 2 rows and one full turn of
+// SCREEN_WIDTH columns. Columns are stored right to left, so the slice seen
+// at any view angle is a contiguous (wrapping) run of each row.
+static Pixel skyPanorama[SCREEN_HEIGHT / 2][SCREEN_WIDTH];
+
+static void build_sky_panorama()
+{
+    const TextureImage* sky = texture_image(skyTexture);
+    const int baseSkyHeight = SCREEN_HEIGHT / 2;
+
+    if (!sky) {
+        memset(skyPanorama, 0, sizeof(skyPanorama));
+        return;
+    }
+
+    const int texWidth = sky->mips[0].width;
+    const int texHeight = sky->mips[0].height;
+    const Pixel* texels = sky->mips[0].rows;
+
+    for (int row = 0; row < baseSkyHeight; row++) {
+        int texY = (row * texHeight) / baseSkyHeight;
+
+        for (int j = 0; j < SCREEN_WIDTH; j++) {
+            int texX = (int)((float)((SCREEN_WIDTH - j) % SCREEN_WIDTH) / SCREEN_WIDTH * texWidth);
+            skyPanorama[row][j] = texels[texY * texWidth + texX] & PIXEL_RGB_MASK;
+        }
+    }
+}
+
+// Copies screen columns [x0, x1) of one sky row; column x shows panorama
+// column (x - offset) mod SCREEN_WIDTH.
+static inline void copy_sky_span(Pixel* dst, const Pixel* src, int x0, int x1, int offset)
+{
+    int j = (x0 - offset) % SCREEN_WIDTH;
+    if (j < 0)
+        j += SCREEN_WIDTH;
+
+    int count = x1 - x0;
+    int first = std::min(count, SCREEN_WIDTH - j);
+    memcpy(dst + x0, src + j, first * sizeof(Pixel));
+    if (count > first)
+        memcpy(dst + x0 + first, src, (count - first) * sizeof(Pixel));
+}
+
+static void render_sky(int skyHeight, float viewAngle)
+{
+    const int baseSkyHeight = SCREEN_HEIGHT / 2;
+    const int offset = (int)(viewAngle * SCREEN_WIDTH + 0.5f);
+    uint64_t written = 0;
+
+    for (int screenY = 0; screenY < skyHeight; screenY++) {
+        int row = screenY - state.pitch;
+        if (row < 0)
+            row = 0;
+        else if (row >= baseSkyHeight)
+            row = baseSkyHeight - 1;
+
+        Pixel* dst = &state.pixels[screenY * SCREEN_WIDTH];
+        const Pixel* src = skyPanorama[row];
+
+        if (screenY < minCoveredTop) {
+            copy_sky_span(dst, src, 0, SCREEN_WIDTH, offset);
+            written += SCREEN_WIDTH;
+            continue;
+        }
+
+        int x = 0;
+        while (x < SCREEN_WIDTH) {
+            while (x < SCREEN_WIDTH && is_occluded(x, screenY))
+                x++;
+            int spanStart = x;
+            while (x < SCREEN_WIDTH && !is_occluded(x, screenY))
+                x++;
+            if (x > spanStart) {
+                copy_sky_span(dst, src, spanStart, x, offset);
+                written += x - spanStart;
+            }
+        }
+    }
+
+    profile_pixels(PROF_SKY, written);
+}
+
+static void render_floor(int horizon)
+{
+    const TextureImage* floor = texture_image(floorTexture);
+    if (!floor)
+        return;
+    const int texWidth = floor->mips[0].width;
+    const int texHeight = floor->mips[0].height;
+    const Pixel* texels = floor->mips[0].rows;
+    const IndexedImage* indexed = indexedTextures ? indexed_image(floor) : NULL;
+    uint64_t written = 0;
+
+    for (int y = horizon; y < SCREEN_HEIGHT; y++) {
+        float rowDist = camera.rowDist[y];
+        int fogMul = fog_mul(rowDist);
+        const Pixel* shades = colormap[0][fog_light(fogMul)];
+
+        float rowX = state.pos.x + rowDist * (state.dir.x - state.plane.x);
+        float rowY = state.pos.y + rowDist * (state.dir.y - state.plane.y);
+
+        float floorStepX = 2.0f * rowDist * state.plane.x / SCREEN_WIDTH;
+        float floorStepY = 2.0f * rowDist * state.plane.y / SCREEN_WIDTH;
+
+        int x = 0;
+        while (x < SCREEN_WIDTH) {
+            while (x < SCREEN_WIDTH && is_occluded(x, y))
+                x++;
+            int spanStart = x;
+            while (x < SCREEN_WIDTH && !is_occluded(x, y))
+                x++;
+
+            float floorX = rowX + spanStart * floorStepX;
+            float floorY = rowY + spanStart * floorStepY;
+
+            for (int i = spanStart; i < x; i++) {
+                int texX = ((int)(floorX * texWidth)) % texWidth;
+                if (texX < 0)
+                    texX += texWidth;
+
+                int texY = ((int)(floorY * texHeight)) % texHeight;
+                if (texY < 0)
+                    texY += texHeight;
+
+                Pixel pixel;
+                if (indexed)
+                    pixel = shades[indexed->rows[texY * texWidth + texX]];
+                else
+                    pixel = pixel_scale(tonemap(texels[texY * texWidth + texX] & PIXEL_RGB_MASK), fogMul);
+                if (!frameLights.empty())
+                    pixel = pixel_add_sat(pixel, light_add(floorX, floorY));
+                state.pixels[y * SCREEN_WIDTH + i] = pixel;
+
+                floorX += floorStepX;
+                floorY += floorStepY;
+            }
+            written += x - spanStart;
+        }
+    }
+
+    profile_pixels(PROF_FLOOR, written);
+}
+
+static void render_other()
+{
+    profile_begin(PROF_SKY);
+    render_sky(camera.horizon, camera.viewAngle);
+    profile_end(PROF_SKY);
+
+    profile_begin(PROF_FLOOR);
+    render_floor(camera.horizon);
+    profile_end(PROF_FLOOR);
+}
+
+static void render_walls()
+{
+    uint64_t written = 0;
+
+    for (int x = 0; x < SCREEN_WIDTH; ++x) {
+        const WallHit& wh = wallHits[x];
+        if (!wh.hit || wallTop[x] > wallBottom[x])
+            continue;
+
+        float rayDirX = wh.rayDirX;
+        float rayDirY = wh.rayDirY;
+        int mapX = wh.mapX;
+        int mapY = wh.mapY;
+        int side = wh.side;
+
+        float perpWallDist = wh.perpWallDist;
+        if (perpWallDist <= 0.01f)
+            perpWallDist = 0.01f;
+
+        int lineHeight = wall_line_height(wh);
+        int drawStart = wallTop[x];
+        int drawEnd = std::min(wallBottom[x], weaponTop[x] - 1);
+        if (drawEnd < drawStart)
+            continue;
+
+        const TextureMip& tex = wallTextures[MAPDATA[mapY * MAP_SIZE + mapX]]->mips[0];
+        int texW = tex.width;
+        int texH = tex.height;
+        int texStep = (texH << 16) / lineHeight;
+
+        int texX, texPos;
+        if (USE_FIXED_RAYCAST) {
+            int dist = std::max(wh.perpWallDistFixed, FIXED_ONE / 100);
+            int wallHit = (side == 0)
+                ? to_fixed(state.pos.y) + (int)(((int64_t)dist * wh.rayDirYFixed) >> FIXED_SHIFT)
+                : to_fixed(state.pos.x) + (int)(((int64_t)dist * wh.rayDirXFixed) >> FIXED_SHIFT);
+            texX = (int)(((int64_t)(wallHit & (FIXED_ONE - 1)) * texW) >> FIXED_SHIFT);
+            if ((side == 0 && wh.rayDirXFixed > 0) || (side == 1 && wh.rayDirYFixed < 0))
+                texX = texW - texX - 1;
+            // Twice the rows from the centre of the wall, to keep the halves
+            // of the float form exact.
+            int rows2 = 2 * drawStart - SCREEN_HEIGHT + lineHeight - 2 * state.pitch;
+            texPos = (int)((int64_t)rows2 * texStep / 2);
+        } else {
+            float wallHit = (side == 0)
+                ? state.pos.y + perpWallDist * rayDirY
+                : state.pos.x + perpWallDist * rayDirX;
+            wallHit -= (int)wallHit;
+
+            texX = (int)(wallHit * texW);
+            if ((side == 0 && rayDirX > 0) || (side == 1 && rayDirY < 0))
+                texX = texW - texX - 1;
+            texPos = (int)((drawStart - SCREEN_HEIGHT / 2.0f + lineHeight / 2.0f - state.pitch) * texStep);
+        }
+
+        ColumnShade cs = column_shade(perpWallDist,
+                                      state.pos.x + rayDirX * perpWallDist,
+                                      state.pos.y + rayDirY * perpWallDist,
+                                      side);
+
+        const IndexedImage* indexed = indexedTextures ? wallIndexed[MAPDATA[mapY * MAP_SIZE + mapX]] : NULL;
+        if (indexed) {
+            const Pixel* shades = NULL;
+            if (cs.light == 0)
+                shades = colormap[side][fog_light(cs.fogMul)];
+            blit_indexed_column(&state.pixels[drawStart * SCREEN_WIDTH + x], drawEnd - drawStart + 1,
+                                indexed->columns + texX * texH, texH, texPos, texStep, shades, cs);
+            written += drawEnd - drawStart + 1;
+            continue;
+        }
+
+        const Pixel* texColumn = tex.columns + texX * texH;
+        blit_wall_column(&state.pixels[drawStart * SCREEN_WIDTH + x], drawEnd - drawStart + 1,
+                         texColumn, 1, texH, texPos, texStep, cs);
+        written += drawEnd - drawStart + 1;
+    }
+
+    profile_pixels(PROF_WALLS, written);
+}
+
+struct WeaponLayout {
+    const TextureMip* tex;
+    float scale;
+    int width, height;
+    int xOffset, yOffset;
+};
+
+static WeaponLayout weapon_layout(const TextureImage* weapon)
+{
+    WeaponLayout wl;
+    float desiredScreenRatio = 0.3f;
+
+    wl.tex = &weapon->mips[0];
+    wl.scale = (SCREEN_WIDTH * desiredScreenRatio) / wl.tex->width;
+
+    if (wl.scale < 0.5f)
+        wl.scale = 0.5f;
+    if (wl.scale > 2.5f)
+        wl.scale = 2.5f;
+
+    wl.width = (int)(wl.tex->width * wl.scale);
+    wl.height = (int)(wl.tex->height * wl.scale);
+    wl.xOffset = (SCREEN_WIDTH - wl.width) / 2;
+    wl.yOffset = SCREEN_HEIGHT - wl.height;
+    return wl;
+}
+
+static inline Pixel weapon_texel(const WeaponLayout& wl, int x, int y)
+{
+    int origX = (int)(x / wl.scale);
+    int origY = (int)(y / wl.scale);
+
+    if (origX < 0 || origX >= wl.tex->width || origY < 0 || origY >= wl.tex->height)
+        return 0;
+
+    return wl.tex->rows[origY * wl.tex->width + origX];
+}
+
+// The weapon never moves on screen, so its opaque footprint is measured once:
+// for every column, how far up from the bottom edge it is solid.
+static void build_weapon_mask()
+{
+    for (int x = 0; x < SCREEN_WIDTH; x++)
+        weaponTop[x] = SCREEN_HEIGHT;
+
+    const TextureImage* weapon = texture_image(weaponTexture);
+    if (!weapon)
+        return;
+
+    WeaponLayout wl = weapon_layout(weapon);
+    if (wl.yOffset + wl.height != SCREEN_HEIGHT)
+        return;
+
+    for (int x = 0; x < wl.width; x++) {
+        int pixelX = x + wl.xOffset;
+        if (pixelX < 0 || pixelX >= SCREEN_WIDTH)
+            continue;
+
+        for (int y = wl.height - 1; y >= 0; y--) {
+            int pixelY = y + wl.yOffset;
+            if (pixelY < 0 || pixel_a(weapon_texel(wl, x, y)) == 0)
+                break;
+            weaponTop[pixelX] = pixelY;
+        }
+    }
+}
+
+static void render_weapon()
+{
+    const TextureImage* weapon = texture_image(weaponTexture);
+    if (!weapon) {
+        return;
+    }
+
+    WeaponLayout wl = weapon_layout(weapon);
+    uint64_t written = 0;
+    // The weapon is lit where the player stands.
+    Pixel light = light_add(state.pos.x, state.pos.y);
+
+    for (int y = 0; y < wl.height; y++) {
+        for (int x = 0; x < wl.width; x++) {
+            Pixel texel = weapon_texel(wl, x, y);
+            if (pixel_a(texel) == 0)
+                continue;
+
+            int pixelX = x + wl.xOffset;
+            int pixelY = y + wl.yOffset;
+
+            if (pixelX < 0 || pixelX >= SCREEN_WIDTH || pixelY < 0 || pixelY >= SCREEN_HEIGHT)
+                continue;
+
+            state.pixels[pixelY * SCREEN_WIDTH + pixelX] = pixel_add_sat(tonemap(texel & PIXEL_RGB_MASK), light);
+            written++;
+        }
+    }
+
+    profile_pixels(PROF_WEAPON, written);
+}
+
+// Blends color over the frame by its alpha.
+static void draw_line(int x0, int y0, int x1, int y1, Pixel color)
+{
+    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy, e2;
+
+    while (1) {
+        if (x0 >= 0 && x0 < SCREEN_WIDTH && y0 >= 0 && y0 < weaponTop[x0]) {
+            Pixel& dst = state.pixels[y0 * SCREEN_WIDTH + x0];
+            dst = pixel_lerp(dst, color & PIXEL_RGB_MASK, pixel_alpha_weight(color));
+            profile_pixels(PROF_TRAIL, 1);
+        }
+        if (x0 == x1 && y0 == y1)
+            break;
+        e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+static void render_bullet_trail()
+{
+    if (!bulletTrail.active)
+        return;
+
+    float invDet = camera.invDet;
+
+    // Drawn in unit-length pieces so the fog still fades along the trail.
+    float trailX = bulletTrail.to.x - bulletTrail.from.x;
+    float trailY = bulletTrail.to.y - bulletTrail.from.y;
+    int segments = std::max(1, (int)ceilf(sqrtf(trailX * trailX + trailY * trailY)));
+
+    for (int i = 1; i <= segments; i++) {
+        float t1 = (float)(i - 1) / segments;
+        float t2 = (float)i / segments;
+        v3 pos1 = { bulletTrail.from.x + trailX * t1, bulletTrail.from.y + trailY * t1, 0 };
+        v3 pos2 = { bulletTrail.from.x + trailX * t2, bulletTrail.from.y + trailY * t2, 0 };
+
+        float spriteX1 = pos1.x - state.pos.x;
+        float spriteY1 = pos1.y - state.pos.y;
+
+        float spriteX2 = pos2.x - state.pos.x;
+        float spriteY2 = pos2.y - state.pos.y;
+
+        float transformX1 = invDet * (state.dir.y * spriteX1 - state.dir.x * spriteY1);
+        float transformY1 = invDet * (-state.plane.y * spriteX1 + state.plane.x * spriteY1);
+
+        float transformX2 = invDet * (state.dir.y * spriteX2 - state.dir.x * spriteY2);
+        float transformY2 = invDet * (-state.plane.y * spriteX2 + state.plane.x * spriteY2);
+
+        if (transformY1 <= 0 || transformY2 <= 0)
+            continue;
+
+        int screenX1 = (int)(((float)SCREEN_WIDTH / 2) * (1 + transformX1 / transformY1));
+        int screenX2 = (int)(((float)SCREEN_WIDTH / 2) * (1 + transformX2 / transformY2));
+
+        int screenY1 = (int)((float)SCREEN_HEIGHT / 2 + state.pitch);
+        int screenY2 = (int)((float)SCREEN_HEIGHT / 2 + state.pitch);
+
+        const Pixel baseColor = pixel_rgb(0, 255, 0);
+        const Pixel opaque = pixel_rgba(0, 0, 0, 255);
+
+        Pixel color1 = pixel_scale(baseColor, fog_mul(transformY1));
+        Pixel color2 = pixel_scale(baseColor, fog_mul(transformY2));
+        Pixel lineColor = pixel_lerp(color1, color2, 128) | opaque;
+
+        draw_line(screenX1, screenY1, screenX2, screenY2, lineColor);
+    }
+}
+
+void init_renderer()
+{
+    floorTexture = texture_handle("floor");
+    enemyTexture = texture_handle("enemy");
+    skyTexture = texture_handle("sky");
+    weaponTexture = texture_handle("weapon");
+    build_sky_panorama();
+    build_weapon_mask();
+    if (indexedTextures)
+        index_textures();
+    texturesSeen = texture_generation();
+}
+
+void set_indexed_textures(int enabled)
+{
+    int was = indexedTextures;
+    indexedTextures = enabled;
+    if (enabled && !was)
+        index_textures();
+}
+
+// Walls go first and record their column spans; the sky and floor then only
+// fill what is left uncovered, and nothing is drawn under the opaque part of
+// the weapon. Together the passes write every pixel, so the framebuffer is
+// not cleared beforehand.
+void render(float deltaTime)
+{
+    // The panorama, the weapon mask and the indexed copies are built from
+    // textures that may have been reloaded.
+    if (texture_generation() != texturesSeen) {
+        build_sky_panorama();
+        build_weapon_mask();
+        if (indexedTextures)
+            refresh_indexed_textures();
+        texturesSeen = texture_generation();
+    }
+    update_dynamic_lights(deltaTime);
+    setup_tonemap();
+    if (indexedTextures)
+        setup_colormap();
+    setup_camera();
+
+    profile_begin(PROF_WALLS);
+    trace_walls();
+    cull_lights();
+    render_walls();
+    profile_end(PROF_WALLS);
+
+    render_other();
+
+    profile_begin(PROF_ENTITIES);
+    render_entities();
+    profile_end(PROF_ENTITIES);
+
+    profile_begin(PROF_TRAIL);
+    render_bullet_trail();
+    profile_end(PROF_TRAIL);
+
+    profile_begin(PROF_WEAPON);
+    render_weapon();
+    profile_end(PROF_WEAPON);
+
+    profile_begin(PROF_POST);
+    post_process(state.pixels, SCREEN_WIDTH, SCREEN_HEIGHT);
+    profile_end(PROF_POST);
+
+    profile_begin(PROF_PRESENT);
+    onerender();
+    profile_end(PROF_PRESENT);
+    profile_frame_end();
+}
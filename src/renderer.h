@@ -1,6 +1,10 @@
-#ifndef RENDERER_H
-#define RENDERER_H
-
-void render(float deltaTime);
-
+#ifndef RENDERER_H
+#define RENDERER_H
+
+void init_renderer();
+void render(float deltaTime);
+// Switches the wall and floor passes between the 32-bit textures and the
+// palette-indexed copies. Starts as USE_INDEXED_TEXTURES.
+void set_indexed_textures(int enabled);
+
 #endif
\ No newline at end of file
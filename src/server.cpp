@@ -0,0 +1,445 @@
+#include "pch.h"
+
+#include <chrono>
+
+Server server;
+
+// Entities are binned into square sectors every tick so a client only looks
+// at the ones near it.
+static const int INTEREST_SECTOR = 4;
+static int sectorCount;
+static std::vector<int> sectorStart;
+static std::vector<int> sectorItems;
+static std::vector<int> candidates;
+static std::vector<Ray> interestRays;
+static std::vector<RayHit> interestHits;
+static std::vector<NetEntity> visible;
+
+static double now_ms()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void send_welcome(int id)
+{
+    std::vector<uint8_t> out;
+    net_put_u8(out, NET_MSG_WELCOME);
+    net_put_u8(out, (uint8_t)id);
+    net_put_u32(out, server.mapChecksum);
+    net_put_u32(out, server.tick);
+    net_send(server.sock, server.clients[id].addr, out.data(), (int)out.size());
+}
+
+static int find_client(const NetAddress& addr)
+{
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        if (server.clients[i].active && server.clients[i].addr == addr)
+            return i;
+    }
+    return -1;
+}
+
+static void connect_client(const NetAddress& addr, NetReader& r)
+{
+    if (net_get_u32(r) != NET_PROTOCOL_MAGIC || net_get_u32(r) != NET_PROTOCOL_VERSION || r.overflow)
+        return;
+
+    // A repeated connect means our welcome was lost.
+    int id = find_client(addr);
+    if (id >= 0) {
+        send_welcome(id);
+        return;
+    }
+
+    for (id = 0; id < SERVER_MAX_CLIENTS && server.clients[id].active; id++);
+    if (id == SERVER_MAX_CLIENTS) {
+        uint8_t reject = NET_MSG_REJECT;
+        net_send(server.sock, addr, &reject, 1);
+        return;
+    }
+
+    ServerClient& c = server.clients[id];
+    c.active = 1;
+    c.addr = addr;
+    c.pos = server.spawns[id % server.spawns.size()];
+    c.dir = server.spawnDir;
+    c.plane = server.spawnPlane;
+    c.pitch = 0.0f;
+    c.fireHeld = c.altFireHeld = 0;
+    c.input = InputFrame();
+    c.ackTick = 0;
+    c.lastHeard = server.tick;
+    for (NetSnapshot& s : c.history) {
+        s.tick = 0;
+        s.entities.clear();
+    }
+    c.bytesSent = 0;
+    c.snapshotsSent = 0;
+    c.deltaSnapshots = 0;
+    c.entitiesSent = 0;
+    send_welcome(id);
+}
+
+static void read_input(ServerClient& c, NetReader& r)
+{
+    uint32_t ack = net_get_u32(r);
+    uint16_t buttons = net_get_u16(r);
+    int mouseX = (int16_t)net_get_u16(r);
+    int mouseY = (int16_t)net_get_u16(r);
+    if (r.overflow)
+        return;
+
+    c.lastHeard = server.tick;
+    if (ack > c.ackTick && ack <= server.tick)
+        c.ackTick = ack;
+    c.input.buttons = buttons;
+    c.input.mouseX = (int16_t)std::max(-32768, std::min(32767, c.input.mouseX + mouseX));
+    c.input.mouseY = (int16_t)std::max(-32768, std::min(32767, c.input.mouseY + mouseY));
+}
+
+static void receive_packets()
+{
+    uint8_t packet[NET_MAX_PACKET];
+    NetAddress from;
+    int size;
+    while ((size = net_receive(server.sock, &from, packet, sizeof(packet))) > 0) {
+        NetReader r = { packet, size, 0, 0 };
+        int type = net_get_u8(r);
+        if (type == NET_MSG_CONNECT) {
+            connect_client(from, r);
+            continue;
+        }
+
+        int id = find_client(from);
+        if (id < 0)
+            continue;
+        if (type == NET_MSG_INPUT)
+            read_input(server.clients[id], r);
+        else if (type == NET_MSG_DISCONNECT)
+            server.clients[id].active = 0;
+    }
+}
+
+static void swap_player(ServerClient& c)
+{
+    std::swap(state.pos, c.pos);
+    std::swap(state.dir, c.dir);
+    std::swap(state.plane, c.plane);
+    std::swap(state.pitch, c.pitch);
+    std::swap(leftMouseButtonPressed, c.fireHeld);
+    std::swap(rightMouseButtonPressed, c.altFireHeld);
+}
+
+static void simulate_players()
+{
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        ServerClient& c = server.clients[i];
+        if (!c.active)
+            continue;
+        if (server.tick - c.lastHeard > SERVER_TIMEOUT_TICKS) {
+            c.active = 0;
+            continue;
+        }
+
+        InputFrame in = c.input;
+        in.frameMs = (uint16_t)(1000 / SERVER_TICK_RATE);
+        swap_player(c);
+        update_player(in);
+        swap_player(c);
+        c.input.mouseX = c.input.mouseY = 0;
+    }
+}
+
+// Finds tiles that changed this tick by comparing MAPDATA with last tick's
+// copy a block at a time; whole unchanged blocks are skipped by memcmp.
+static void collect_map_changes()
+{
+    const int block = 64;
+    int cells = MAP_SIZE * MAP_SIZE;
+    for (int start = 0; start < cells; start += block) {
+        int len = std::min(block, cells - start);
+        if (memcmp(&MAPDATA[start], &server.shadowMap[start], len) == 0)
+            continue;
+        for (int i = start; i < start + len; i++) {
+            if (MAPDATA[i] != server.shadowMap[i]) {
+                server.changes.push_back({ server.tick, i, MAPDATA[i] });
+                server.shadowMap[i] = MAPDATA[i];
+            }
+        }
+    }
+}
+
+static NetEntity make_entity(int id, int kind, float x, float y, float dirX, float dirY, float pitch)
+{
+    NetEntity e;
+    e.id = (uint16_t)id;
+    e.kind = (uint8_t)kind;
+    e.x = (int32_t)lroundf(x * NET_POS_SCALE);
+    e.y = (int32_t)lroundf(y * NET_POS_SCALE);
+    e.angle = (uint16_t)(int32_t)lroundf(atan2f(dirY, dirX) * (65536.0f / (2.0f * (float)M_PI)));
+    e.pitch = (int16_t)lroundf(pitch);
+    return e;
+}
+
+static void gather_entities()
+{
+    std::vector<NetEntity>& out = server.entities;
+    out.clear();
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        const ServerClient& c = server.clients[i];
+        if (c.active)
+            out.push_back(make_entity(i, NET_ENTITY_PLAYER, c.pos.x, c.pos.y, c.dir.x, c.dir.y, c.pitch));
+    }
+
+    size_t first = out.size();
+    const ProjectilePool& p = projectiles;
+    for (int k = 0; k < p.liveCount; k++) {
+        int slot = p.live[k];
+        out.push_back(make_entity(SERVER_MAX_CLIENTS + slot, NET_ENTITY_PROJECTILE,
+                                  p.x[slot], p.y[slot], p.dirX[slot], p.dirY[slot], 0.0f));
+    }
+    std::sort(out.begin() + first, out.end(), [](const NetEntity& a, const NetEntity& b) { return a.id < b.id; });
+}
+
+static int sector_of(int32_t pos)
+{
+    int sector = (pos >> 8) / INTEREST_SECTOR;
+    return std::max(0, std::min(sectorCount - 1, sector));
+}
+
+static void bin_entities()
+{
+    const std::vector<NetEntity>& entities = server.entities;
+    sectorCount = (MAP_SIZE + INTEREST_SECTOR - 1) / INTEREST_SECTOR;
+    sectorStart.assign(sectorCount * sectorCount + 1, 0);
+    sectorItems.resize(entities.size());
+
+    for (const NetEntity& e : entities)
+        sectorStart[sector_of(e.y) * sectorCount + sector_of(e.x) + 1]++;
+    for (int i = 0; i < sectorCount * sectorCount; i++)
+        sectorStart[i + 1] += sectorStart[i];
+    for (size_t i = 0; i < entities.size(); i++) {
+        const NetEntity& e = entities[i];
+        int sector = sector_of(e.y) * sectorCount + sector_of(e.x);
+        sectorItems[sectorStart[sector]++] = (int)i;
+    }
+    for (int i = sectorCount * sectorCount; i > 0; i--)
+        sectorStart[i] = sectorStart[i - 1];
+    sectorStart[0] = 0;
+}
+
+// The entities client id can see: its own player, and everything within
+// SERVER_INTEREST_RADIUS whose cell is in the visibility set of the
+// client's cell. Without a set for the map the lines of sight are traced in
+// one batch with the same DDA the renderer culls sprites with.
+static const std::vector<NetEntity>& select_entities(const ServerClient& c, int id)
+{
+    if (!server.useInterest)
+        return server.entities;
+
+    const float radius = SERVER_INTEREST_RADIUS;
+    const float toCells = 1.0f / NET_POS_SCALE;
+    int x0 = sector_of((int32_t)((c.pos.x - radius) * NET_POS_SCALE));
+    int x1 = sector_of((int32_t)((c.pos.x + radius) * NET_POS_SCALE));
+    int y0 = sector_of((int32_t)((c.pos.y - radius) * NET_POS_SCALE));
+    int y1 = sector_of((int32_t)((c.pos.y + radius) * NET_POS_SCALE));
+
+    int usePvs = pvs.size == MAP_SIZE && pvs.complete;
+    int viewCell = (int)c.pos.y * MAP_SIZE + (int)c.pos.x;
+    candidates.clear();
+    interestRays.clear();
+    visible.clear();
+    for (int sy = y0; sy <= y1; sy++) {
+        for (int i = sectorStart[sy * sectorCount + x0]; i < sectorStart[sy * sectorCount + x1 + 1]; i++) {
+            int index = sectorItems[i];
+            const NetEntity& e = server.entities[index];
+            if (e.id == id) {
+                candidates.push_back(index);
+                if (!usePvs)
+                    interestRays.push_back({ c.pos.x, c.pos.y, 1.0f, 0.0f, 0.0f });
+                continue;
+            }
+
+            float dx = e.x * toCells - c.pos.x;
+            float dy = e.y * toCells - c.pos.y;
+            float distSq = dx * dx + dy * dy;
+            if (distSq > radius * radius)
+                continue;
+            if (usePvs) {
+                if (pvs_visible(viewCell, (e.y >> 8) * MAP_SIZE + (e.x >> 8)))
+                    candidates.push_back(index);
+                continue;
+            }
+            float dist = sqrtf(distSq);
+            if (dist > 0.0f)
+                interestRays.push_back({ c.pos.x, c.pos.y, dx / dist, dy / dist, dist });
+            else
+                interestRays.push_back({ c.pos.x, c.pos.y, 1.0f, 0.0f, 0.0f });
+            candidates.push_back(index);
+        }
+    }
+
+    if (!usePvs) {
+        interestHits.resize(interestRays.size());
+        trace_rays(interestRays.data(), (int)interestRays.size(), RAY_STOP_WALLS, interestHits.data());
+        size_t kept = 0;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            if (!interestHits[i].hit)
+                candidates[kept++] = candidates[i];
+        }
+        candidates.resize(kept);
+    }
+
+    // Entities are sorted by id, so sorting indices keeps the delta merge
+    // working.
+    std::sort(candidates.begin(), candidates.end());
+    for (int index : candidates)
+        visible.push_back(server.entities[index]);
+    return visible;
+}
+
+static void send_snapshot(ServerClient& c, const std::vector<NetEntity>& entities)
+{
+    static const std::vector<NetEntity> empty;
+    static std::vector<uint8_t> out;
+
+    const NetSnapshot* base = NULL;
+    if (server.useDelta && c.ackTick) {
+        const NetSnapshot& h = c.history[c.ackTick % NET_SNAPSHOT_HISTORY];
+        if (h.tick == c.ackTick)
+            base = &h;
+    }
+    uint32_t baseTick = base ? base->tick : 0;
+
+    out.clear();
+    net_put_u8(out, NET_MSG_SNAPSHOT);
+    net_put_u32(out, server.tick);
+    net_put_u32(out, baseTick);
+
+    // Tile values are absolute, so resending a change the client already
+    // has is harmless.
+    auto firstChange = std::upper_bound(server.changes.begin(), server.changes.end(), baseTick,
+                                        [](uint32_t t, const MapChange& m) { return t < m.tick; });
+    net_put_varint(out, (uint32_t)(server.changes.end() - firstChange));
+    for (auto it = firstChange; it != server.changes.end(); ++it) {
+        net_put_varint(out, (uint32_t)it->cell);
+        net_put_u8(out, it->tile);
+    }
+
+    net_write_entities(out, base ? base->entities : empty, entities);
+
+    NetSnapshot& slot = c.history[server.tick % NET_SNAPSHOT_HISTORY];
+    slot.tick = server.tick;
+    slot.entities = entities;
+
+    if ((int)out.size() > NET_MAX_PACKET) {
+        std::cerr << "snapshot of " << out.size() << " bytes is too large to send" << std::endl;
+        return;
+    }
+    net_send(server.sock, c.addr, out.data(), (int)out.size());
+    c.bytesSent += out.size();
+    c.snapshotsSent++;
+    c.entitiesSent += entities.size();
+    if (base)
+        c.deltaSnapshots++;
+}
+
+int server_start(uint16_t port)
+{
+    server_stop();
+    server.sock = net_open(port);
+    if (server.sock == NET_INVALID_SOCKET)
+        return 0;
+
+    server.running = 1;
+    server.tick = 0;
+    server.useDelta = 1;
+    server.useInterest = 1;
+    for (ServerClient& c : server.clients)
+        c.active = 0;
+
+    server.spawns.clear();
+    for (int i = 0; i < MAP_SIZE * MAP_SIZE; i++) {
+        if (MAPDATA[i] == 3)
+            server.spawns.push_back({ i % MAP_SIZE + 0.5f, i / MAP_SIZE + 0.5f, 0.0f });
+    }
+    if (server.spawns.empty())
+        server.spawns.push_back(state.pos);
+    server.spawnDir = state.dir;
+    server.spawnPlane = state.plane;
+    server.mapChecksum = map_checksum(MAPDATA, MAP_SIZE);
+    server.shadowMap.assign(MAPDATA, MAPDATA + MAP_SIZE * MAP_SIZE);
+    server.changes.clear();
+    server.totalTickMs = 0.0;
+    server.maxTickMs = 0.0;
+
+    clear_actors();
+    clear_projectiles();
+    return 1;
+}
+
+void server_tick()
+{
+    double start = now_ms();
+    server.tick++;
+
+    receive_packets();
+
+    float savedDelta = state.deltaTime;
+    state.deltaTime = SERVER_TICK;
+    simulate_players();
+    update_projectiles(SERVER_TICK);
+    state.deltaTime = savedDelta;
+
+    collect_map_changes();
+    gather_entities();
+    if (server.useInterest)
+        bin_entities();
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        ServerClient& c = server.clients[i];
+        if (c.active)
+            send_snapshot(c, select_entities(c, i));
+    }
+
+    double ms = now_ms() - start;
+    server.totalTickMs += ms;
+    server.maxTickMs = std::max(server.maxTickMs, ms);
+}
+
+void server_stop()
+{
+    if (!server.running)
+        return;
+    net_close(server.sock);
+    server.running = 0;
+}
+
+int server_client_count()
+{
+    int count = 0;
+    for (const ServerClient& c : server.clients)
+        count += c.active;
+    return count;
+}
+
+uint16_t server_port()
+{
+    return server.running ? net_local_port(server.sock) : 0;
+}
+
+int server_check_client(const NetClient* c)
+{
+    if (c->id < 0)
+        return 1;
+
+    int mismatches = 0;
+    const NetSnapshot& got = client_snapshot(c);
+    if (got.tick == server.tick && memcmp(c->map.data(), MAPDATA, c->map.size()) != 0)
+        mismatches++;
+
+    const NetSnapshot& sent = server.clients[c->id].history[got.tick % NET_SNAPSHOT_HISTORY];
+    if (sent.tick != got.tick || sent.entities != got.entities)
+        mismatches++;
+    return mismatches;
+}
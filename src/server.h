@@ -0,0 +1,80 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "client.h"
+#include "input.h"
+#include "net.h"
+#include "utils.h"
+
+constexpr int SERVER_TICK_RATE = 30;
+constexpr float SERVER_TICK = 1.0f / SERVER_TICK_RATE;
+constexpr int SERVER_MAX_CLIENTS = 64;
+// Clients that stay silent this long are dropped.
+constexpr int SERVER_TIMEOUT_TICKS = SERVER_TICK_RATE * 5;
+// Entities farther away than this are never sent; the renderer draws
+// sprites out to 15 cells and a client can move a little between snapshots.
+constexpr float SERVER_INTEREST_RADIUS = 16.0f;
+
+struct ServerClient {
+    int active;
+    NetAddress addr;
+    v3 pos, dir, plane;
+    float pitch;
+    int fireHeld, altFireHeld;
+    // Buttons from the newest input packet, mouse summed over all of them.
+    InputFrame input;
+    // Newest snapshot the client confirmed; deltas are built against it.
+    uint32_t ackTick;
+    uint32_t lastHeard;
+    NetSnapshot history[NET_SNAPSHOT_HISTORY];
+    uint64_t bytesSent;
+    uint32_t snapshotsSent;
+    uint32_t deltaSnapshots;
+    uint64_t entitiesSent;
+};
+
+// The authoritative world. Players are simulated with the same
+// update_player() the game uses by swapping each client's pose into state.
+struct Server {
+    int running;
+    NetSocket sock;
+    uint32_t tick;
+    // 0 sends every snapshot in full, for comparing bandwidth.
+    int useDelta;
+    // 0 sends every entity to every client instead of only those it can see.
+    int useInterest;
+    ServerClient clients[SERVER_MAX_CLIENTS];
+    // Clients are spread over the spawn tiles in turn.
+    std::vector<v3> spawns;
+    v3 spawnDir, spawnPlane;
+    uint32_t mapChecksum;
+    // MAPDATA as of the previous tick, diffed to find destroyed tiles.
+    std::vector<uint8_t> shadowMap;
+    // Every tile change since the start, in tick order.
+    std::vector<MapChange> changes;
+    std::vector<NetEntity> entities;
+    double totalTickMs;
+    double maxTickMs;
+};
+
+extern Server server;
+
+// Starts serving the map currently in MAPDATA on port, or on a free port
+// when it is 0. Actors are not replicated and are cleared.
+int server_start(uint16_t port);
+// Reads client packets, advances the world by SERVER_TICK and sends every
+// client a snapshot.
+void server_tick();
+void server_stop();
+int server_client_count();
+uint16_t server_port();
+
+// Counts the ways a loopback client's view differs from what the server
+// sent it for the same tick, and from the server's map once it has the
+// final tick. 0 means the client reconstructed everything exactly.
+int server_check_client(const NetClient* c);
+
+#endif
\ No newline at end of file
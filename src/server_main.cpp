@@ -0,0 +1,114 @@
+#include "pch.h"
+
+#include <chrono>
+#include <thread>
+
+int main(int argc, char* argv[])
+{
+    int port = NET_DEFAULT_PORT;
+    int botCount = 0;
+    int ticks = 0;
+    int fast = 0;
+    int useDelta = 1;
+    int useInterest = 1;
+    float loss = 0.0f;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--bots") == 0 && i + 1 < argc) {
+            botCount = std::max(0, std::min(SERVER_MAX_CLIENTS, atoi(argv[++i])));
+        }
+        else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            ticks = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            loss = (float)atof(argv[++i]) / 100.0f;
+        }
+        else if (strcmp(argv[i], "--fast") == 0) {
+            fast = 1;
+        }
+        else if (strcmp(argv[i], "--full") == 0) {
+            useDelta = 0;
+        }
+        else if (strcmp(argv[i], "--everything") == 0) {
+            useInterest = 0;
+        }
+        else {
+            std::cerr << "usage: sq1_server [--port n] [--ticks n] [--bots n [--loss percent]] [--fast] [--full] [--everything]" << std::endl;
+            return 1;
+        }
+    }
+
+    state.pos = { 0.0f, 0.0f, 0 };
+    state.dir = { -1.0f, 0.0f, 0 };
+    state.plane = { 0.0f, 0.66f, 0 };
+
+    if (!net_init()) return 1;
+    if (!load_map("map.txt")) return 1;
+    if (!jobs_init(0)) return 1;
+    std::vector<uint8_t> diskMap(MAPDATA, MAPDATA + MAP_SIZE * MAP_SIZE);
+    if (!server_start((uint16_t)port)) return 1;
+    server.useDelta = useDelta;
+    server.useInterest = useInterest;
+    printf("server: port %d, %d Hz, map %dx%d\n", port, SERVER_TICK_RATE, MAP_SIZE, MAP_SIZE);
+
+    std::vector<ClientBot> bots(botCount);
+    for (int i = 0; i < botCount; i++) {
+        bots[i].seed = 0x9e3779b9u * (i + 1);
+        bots[i].client.dropRate = loss;
+        if (!client_connect(&bots[i].client, (uint16_t)port, diskMap.data(), MAP_SIZE)) return 1;
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto nextTick = clock::now();
+    for (int t = 0; ticks == 0 || t < ticks; t++) {
+        for (ClientBot& b : bots) {
+            client_receive(&b.client);
+            client_send_input(&b.client, client_bot_input(&b, 1000 / SERVER_TICK_RATE));
+        }
+        server_tick();
+
+        if (!fast) {
+            nextTick += std::chrono::microseconds(1000000 / SERVER_TICK_RATE);
+            std::this_thread::sleep_until(nextTick);
+        }
+    }
+
+    int mismatches = 0, connected = 0;
+    uint64_t bytes = 0, received = 0, entities = 0;
+    uint32_t snapshots = 0, deltas = 0, dropped = 0, missingBase = 0;
+    for (ClientBot& b : bots) {
+        client_receive(&b.client);
+        if (b.client.id < 0)
+            continue;
+        const ServerClient& sc = server.clients[b.client.id];
+        connected++;
+        bytes += sc.bytesSent;
+        snapshots += sc.snapshotsSent;
+        deltas += sc.deltaSnapshots;
+        entities += sc.entitiesSent;
+        received += b.client.bytesReceived;
+        dropped += b.client.dropped;
+        missingBase += b.client.missingBase;
+        mismatches += server_check_client(&b.client);
+    }
+
+    printf("server: %u ticks, %.4f ms per tick on average, %.4f ms max, %d tile changes\n",
+           server.tick, server.totalTickMs / std::max(1u, server.tick), server.maxTickMs, (int)server.changes.size());
+    if (connected) {
+        double perSnapshot = (double)bytes / std::max(1u, snapshots);
+        printf("server: %d clients, %.1f entities and %.1f bytes per snapshot, %.2f kbit/s per client, %.1f%% deltas\n",
+               connected, (double)entities / std::max(1u, snapshots), perSnapshot,
+               perSnapshot * SERVER_TICK_RATE * 8.0 / 1000.0, 100.0 * deltas / std::max(1u, snapshots));
+        printf("clients: %llu bytes received, %u snapshots dropped, %u without a baseline, %d mismatches\n",
+               (unsigned long long)received, dropped, missingBase, mismatches);
+    }
+
+    for (ClientBot& b : bots)
+        client_disconnect(&b.client);
+    server_stop();
+    jobs_shutdown();
+    net_shutdown();
+    return mismatches == 0 && connected == botCount ? 0 : 1;
+}
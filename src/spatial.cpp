@@ -0,0 +1,200 @@
+#include "pch.h"
+
+SpatialHash spatial;
+
+void spatial_begin()
+{
+    spatial.pending.clear();
+    for (int k = 0; k < SPATIAL_KIND_COUNT; k++)
+        spatial.maxRadius[k] = 0.0f;
+}
+
+void spatial_insert(int kind, int id, float x, float y, float radius)
+{
+    spatial.pending.push_back({ x, y, radius, id, kind });
+    spatial.maxRadius[kind] = std::max(spatial.maxRadius[kind], radius);
+}
+
+static inline int cell_coord(float v, int size)
+{
+    int c = (int)floorf(v);
+    return std::max(0, std::min(size - 1, c));
+}
+
+void spatial_build()
+{
+    SpatialHash& h = spatial;
+    int cells = MAP_SIZE * MAP_SIZE;
+    int count = (int)h.pending.size();
+
+    h.size = MAP_SIZE;
+    h.cellStart.assign(cells + 1, 0);
+    h.cellOf.resize(count);
+    h.entries.resize(count);
+
+    for (int i = 0; i < count; i++) {
+        const SpatialEntry& e = h.pending[i];
+        int cell = cell_coord(e.y, h.size) * h.size + cell_coord(e.x, h.size);
+        h.cellOf[i] = cell;
+        h.cellStart[cell + 1]++;
+    }
+    for (int c = 0; c < cells; c++)
+        h.cellStart[c + 1] += h.cellStart[c];
+
+    // Scatter in insertion order, using cellStart[c] as the write cursor of
+    // bucket c; afterwards it holds the end of c, so shift it back by one.
+    for (int i = 0; i < count; i++)
+        h.entries[h.cellStart[h.cellOf[i]]++] = h.pending[i];
+    for (int c = cells; c > 0; c--)
+        h.cellStart[c] = h.cellStart[c - 1];
+    h.cellStart[0] = 0;
+}
+
+void rebuild_spatial()
+{
+    spatial_begin();
+
+    for (int i = 0; i < MAP_SIZE * MAP_SIZE; i++) {
+        if (MAPDATA[i] == 2)
+            spatial_insert(SPATIAL_OBJECT, i, (i % MAP_SIZE) + 0.5f, (i / MAP_SIZE) + 0.5f, 0.5f);
+    }
+    for (int i = 0; i < actors.count; i++)
+        spatial_insert(SPATIAL_ACTOR, i, actors.x[i], actors.y[i], ACTOR_RADIUS);
+    for (int k = 0; k < projectiles.liveCount; k++) {
+        int slot = projectiles.live[k];
+        spatial_insert(SPATIAL_PROJECTILE, slot, projectiles.x[slot], projectiles.y[slot],
+                       projectileInfo[projectiles.type[slot]].radius);
+    }
+    for (size_t i = 0; i < dynamicLights.size(); i++)
+        spatial_insert(SPATIAL_LIGHT, (int)i, dynamicLights[i].x, dynamicLights[i].y, dynamicLights[i].radius);
+
+    spatial_build();
+}
+
+static float mask_radius(int kindMask)
+{
+    float r = 0.0f;
+    for (int k = 0; k < SPATIAL_KIND_COUNT; k++) {
+        if (kindMask & SPATIAL_MASK(k))
+            r = std::max(r, spatial.maxRadius[k]);
+    }
+    return r;
+}
+
+int spatial_query_radius(float x, float y, float radius, int kindMask, int* out, int maxOut)
+{
+    const SpatialHash& h = spatial;
+    if (h.size == 0)
+        return 0;
+
+    float pad = radius + mask_radius(kindMask);
+    int x0 = cell_coord(x - pad, h.size), x1 = cell_coord(x + pad, h.size);
+    int y0 = cell_coord(y - pad, h.size), y1 = cell_coord(y + pad, h.size);
+
+    // Buckets of one grid row are stored back to back, so each row of the
+    // query rectangle is a single contiguous run of entries.
+    const int* cellStart = h.cellStart.data();
+    const SpatialEntry* entries = h.entries.data();
+    int found = 0;
+    for (int cy = y0; cy <= y1; cy++) {
+        int first = cellStart[cy * h.size + x0];
+        int last = cellStart[cy * h.size + x1 + 1];
+        for (int i = first; i < last; i++) {
+            const SpatialEntry& e = entries[i];
+            if (!(kindMask & SPATIAL_MASK(e.kind)))
+                continue;
+
+            float dx = e.x - x;
+            float dy = e.y - y;
+            float reach = radius + e.radius;
+            if (dx * dx + dy * dy > reach * reach)
+                continue;
+
+            if (found < maxOut)
+                out[found] = i;
+            found++;
+        }
+    }
+    return found;
+}
+
+// Distance along the ray at which it enters the circle, or -1 if it misses.
+static inline float ray_circle(const Ray& ray, const SpatialEntry& e)
+{
+    float ox = e.x - ray.x;
+    float oy = e.y - ray.y;
+    float along = ox * ray.dirX + oy * ray.dirY;
+    float side = ox * ray.dirY - oy * ray.dirX;
+    float r2 = e.radius * e.radius;
+    if (side * side > r2)
+        return -1.0f;
+
+    float half = sqrtf(r2 - side * side);
+    if (along + half < 0.0f)
+        return -1.0f;
+    return std::max(along - half, 0.0f);
+}
+
+// Walks the cells the ray passes through. An entry can reach at most
+// ceil(maxRadius) cells away from its bucket, so each step also checks that
+// ring; the walk ends once the next cell starts beyond the best hit.
+int spatial_raycast(const Ray& ray, int kindMask, float* distance)
+{
+    const SpatialHash& h = spatial;
+    if (h.size == 0)
+        return -1;
+
+    float pad = mask_radius(kindMask);
+    int ring = (int)ceilf(pad);
+
+    int mapX = (int)floorf(ray.x);
+    int mapY = (int)floorf(ray.y);
+    float deltaDistX = (ray.dirX == 0) ? 1e30f : fabsf(1.0f / ray.dirX);
+    float deltaDistY = (ray.dirY == 0) ? 1e30f : fabsf(1.0f / ray.dirY);
+    int stepX = (ray.dirX < 0) ? -1 : 1;
+    int stepY = (ray.dirY < 0) ? -1 : 1;
+    float sideDistX = (ray.dirX < 0) ? (ray.x - mapX) * deltaDistX : (mapX + 1.0f - ray.x) * deltaDistX;
+    float sideDistY = (ray.dirY < 0) ? (ray.y - mapY) * deltaDistY : (mapY + 1.0f - ray.y) * deltaDistY;
+
+    int best = -1;
+    float bestDist = ray.maxDist;
+    float cellEnter = 0.0f;
+
+    while (cellEnter - pad <= bestDist) {
+        if (mapX < -ring || mapX >= h.size + ring || mapY < -ring || mapY >= h.size + ring)
+            break;
+
+        for (int cy = std::max(0, mapY - ring); cy <= std::min(h.size - 1, mapY + ring); cy++) {
+            for (int cx = std::max(0, mapX - ring); cx <= std::min(h.size - 1, mapX + ring); cx++) {
+                int cell = cy * h.size + cx;
+                for (int i = h.cellStart[cell]; i < h.cellStart[cell + 1]; i++) {
+                    const SpatialEntry& e = h.entries[i];
+                    if (!(kindMask & SPATIAL_MASK(e.kind)))
+                        continue;
+
+                    float t = ray_circle(ray, e);
+                    if (t >= 0.0f && (t < bestDist || (t == bestDist && best >= 0 && i < best))) {
+                        bestDist = t;
+                        best = i;
+                    }
+                }
+            }
+        }
+
+        if (sideDistX < sideDistY) {
+            cellEnter = sideDistX;
+            sideDistX += deltaDistX;
+            mapX += stepX;
+        }
+        else {
+            cellEnter = sideDistY;
+            sideDistY += deltaDistY;
+            mapY += stepY;
+        }
+    }
+
+    if (best >= 0 && distance)
+        *distance = bestDist;
+    return best;
+}
+
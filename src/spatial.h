@@ -0,0 +1,60 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include <cstdint>
+#include <vector>
+
+#include "raycast.h"
+
+enum SpatialKind {
+    SPATIAL_OBJECT,
+    SPATIAL_ACTOR,
+    SPATIAL_LIGHT,
+    SPATIAL_PROJECTILE,
+    SPATIAL_KIND_COUNT
+};
+
+#define SPATIAL_MASK(kind) (1 << (kind))
+
+// A snapshot of one dynamic object. id is the object's index in its own
+// container (cell index for map objects, actor index, light index, ...).
+struct SpatialEntry {
+    float x, y;
+    float radius;
+    int id;
+    int kind;
+};
+
+// Uniform grid over the map, one bucket per map cell. Entries are bucketed
+// by their centre with a counting sort, so each bucket is a contiguous range
+// of entries and a rebuild is linear in the number of objects.
+struct SpatialHash {
+    int size = 0;
+    std::vector<int> cellStart;
+    std::vector<SpatialEntry> entries;
+    // Largest radius inserted per kind; queries widen their cell range by it.
+    float maxRadius[SPATIAL_KIND_COUNT] = { 0 };
+
+    std::vector<SpatialEntry> pending;
+    std::vector<int> cellOf;
+};
+
+extern SpatialHash spatial;
+
+void spatial_begin();
+void spatial_insert(int kind, int id, float x, float y, float radius);
+void spatial_build();
+
+// Inserts the map objects, actors, projectiles and lights and builds the grid.
+void rebuild_spatial();
+
+// Entries of the kinds in kindMask whose body overlaps the circle. Writes up
+// to maxOut entry indices to out and returns the total number found, so a
+// caller whose buffer was too small can grow it and ask again.
+int spatial_query_radius(float x, float y, float radius, int kindMask, int* out, int maxOut);
+
+// Nearest entry of the kinds in kindMask whose body the ray crosses within
+// ray.maxDist, or -1. The ray direction must be normalized.
+int spatial_raycast(const Ray& ray, int kindMask, float* distance);
+
+#endif
\ No newline at end of file
@@ -1,66 +1,417 @@
-#include "pch.h"
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
-RGBA get_texture_pixel(int tex_id, int x, int y)
-{
-    if (tex_id < 0 || tex_id >= count_t || !state.textures[tex_id]) {
-        return { 255, 0, 255, 255 };
-    }
-
-    SDL_Surface* texture = state.textures[tex_id];
-    if (!texture->pixels) {
-        return { 255, 0, 0, 255 };
-    }
-
-    int texW = state.tex_width[tex_id];
-    int texH = state.tex_height[tex_id];
-
-    if (texW <= 0 || texH <= 0) {
-        return { 255, 255, 0, 255 };
-    }
-
-    int texX = ((x % texW) + texW) % texW;
-    int texY = ((y % texH) + texH) % texH;
-
-    uint32_t* pixels = (uint32_t*)texture->pixels;
-    uint32_t pixel = pixels[texY * texW + texX];
-
-    return {
-        static_cast<uint8_t>(pixel & 0xFF),
-        static_cast<uint8_t>((pixel >> 8) & 0xFF),
-        static_cast<uint8_t>((pixel >> 16) & 0xFF),
-        static_cast<uint8_t>((pixel >> 24) & 0xFF)
-    };
-}
-
-int load_textures()
-{
-    const char* texture_files[count_t] = { "wall1.png", "floor.png", "enemy.png", "wall1.png", "sky.png", "weapon.png" };
-
-    for (int i = 0; i < count_t; i++) {
-        int width, height, channels;
-        uint8_t* pixels = stbi_load(texture_files[i], &width, &height, &channels, 4);
-        if (!pixels) {
-            std::cerr << "err loading: " << texture_files[i] << " " << stbi_failure_reason() << std::endl;
-            return 0;
-        }
-
-        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ABGR8888);
-        if (!surface) {
-            std::cerr << "err creating surface: " << SDL_GetError() << std::endl;
-            stbi_image_free(pixels);
-            return 0;
-        }
-
-        memcpy(surface->pixels, pixels, width * height * 4);
-        stbi_image_free(pixels);
-
-        state.textures[i] = surface;
-        state.tex_width[i] = width;
-        state.tex_height[i] = height;
-    }
-
-    return 1;
-}
+#include "pch.h"
+
+#include <chrono>
+
+// stb_image allocates through these, so the buffer it returns is already
+// aligned and is handed to the surface as is.
+static void* texture_alloc(size_t size);
+static void* texture_realloc(void* p, size_t oldSize, size_t newSize);
+static void texture_free(void* p);
+
+#define STBI_MALLOC(sz) texture_alloc(sz)
+#define STBI_REALLOC_SIZED(p, oldsz, newsz) texture_realloc(p, oldsz, newsz)
+#define STBI_FREE(p) texture_free(p)
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+struct TextureFile {
+    const char* path;
+    TextureImage image;
+    int ok;
+    double ms;
+};
+
+struct TextureEntry {
+    std::string name;
+    // Index into files and images.
+    int file;
+};
+
+const TextureImage* wallTextures[TEXTURE_TILES];
+
+static std::vector<TextureEntry> registry;
+static std::map<std::string, TextureHandle> handles;
+static std::vector<std::string> files;
+// One per file, allocated when the manifest loads and filled in place
+// afterwards, so pointers to them survive loading and reloading.
+static std::vector<TextureImage> images;
+static TextureHandle wallHandles[TEXTURE_TILES];
+static uint32_t generation = 0;
+
+static void* texture_alloc(size_t size)
+{
+    // The byte before the returned pointer holds the distance back to the
+    // malloc'd block, 1 to TEXTURE_ALIGN.
+    uint8_t* raw = (uint8_t*)malloc(size + TEXTURE_ALIGN);
+    if (!raw)
+        return NULL;
+    uint8_t* p = (uint8_t*)(((uintptr_t)raw + TEXTURE_ALIGN) & ~(uintptr_t)(TEXTURE_ALIGN - 1));
+    p[-1] = (uint8_t)(p - raw);
+    return p;
+}
+
+static void texture_free(void* p)
+{
+    if (p)
+        free((uint8_t*)p - ((uint8_t*)p)[-1]);
+}
+
+static void* texture_realloc(void* p, size_t oldSize, size_t newSize)
+{
+    void* q = texture_alloc(newSize);
+    if (q && p)
+        memcpy(q, p, std::min(oldSize, newSize));
+    if (q)
+        texture_free(p);
+    return q;
+}
+
+int load_texture_manifest(const char* path)
+{
+    free_textures();
+    registry.clear();
+    handles.clear();
+    files.clear();
+    images.clear();
+    for (int t = 0; t < TEXTURE_TILES; t++)
+        wallHandles[t] = TEXTURE_NONE;
+
+    std::ifstream file;
+    std::istringstream packed;
+    std::istream* in = &file;
+    if (const PackEntry* e = pack_find(path, PACK_TEXT)) {
+        packed.str(std::string((const char*)pack_data(e->offset), e->size));
+        in = &packed;
+    }
+    else {
+        file.open(path);
+        if (!file.is_open()) {
+            std::cerr << "err loading texture manifest " << path << std::endl;
+            return 0;
+        }
+    }
+
+    // Wall lines may name textures declared further down, so they are
+    // resolved once everything is read.
+    std::vector<std::pair<int, std::string>> walls;
+    std::string line;
+    for (int lineNo = 1; std::getline(*in, line); lineNo++) {
+        std::istringstream fields(line);
+        std::string kind, a, b;
+        fields >> kind;
+        if (kind.empty() || kind[0] == '#')
+            continue;
+        fields >> a >> b;
+        if (kind == "texture" && !b.empty() && !handles.count(a)) {
+            size_t f = std::find(files.begin(), files.end(), b) - files.begin();
+            if (f == files.size())
+                files.push_back(b);
+            handles[a] = (TextureHandle)registry.size();
+            registry.push_back({ a, (int)f });
+        }
+        else if (kind == "wall" && !b.empty() && atoi(a.c_str()) > 0 && atoi(a.c_str()) < TEXTURE_TILES) {
+            walls.push_back({ atoi(a.c_str()), b });
+        }
+        else {
+            std::cerr << "err in texture manifest " << path << " line " << lineNo << ": " << line << std::endl;
+            return 0;
+        }
+    }
+
+    for (const auto& w : walls) {
+        wallHandles[w.first] = texture_handle(w.second.c_str());
+        if (wallHandles[w.first] == TEXTURE_NONE)
+            return 0;
+    }
+
+    TextureImage empty;
+    memset(&empty, 0, sizeof(empty));
+    images.assign(files.size(), empty);
+    return 1;
+}
+
+int texture_count()
+{
+    return (int)registry.size();
+}
+
+const char* texture_name(TextureHandle h)
+{
+    return registry[h].name.c_str();
+}
+
+const char* texture_file(TextureHandle h)
+{
+    return files[registry[h].file].c_str();
+}
+
+const std::vector<std::string>& texture_files()
+{
+    return files;
+}
+
+int texture_uses_file(const char* file)
+{
+    return std::find(files.begin(), files.end(), file) != files.end();
+}
+
+TextureHandle texture_handle(const char* name)
+{
+    auto it = handles.find(name);
+    if (it == handles.end()) {
+        std::cerr << "err: no texture named " << name << std::endl;
+        return TEXTURE_NONE;
+    }
+    return it->second;
+}
+
+const TextureImage* texture_image(TextureHandle h)
+{
+    if (h < 0 || h >= (int)registry.size())
+        return NULL;
+    const TextureImage* image = &images[registry[h].file];
+    return image->surface ? image : NULL;
+}
+
+const TextureMip* texture_mip(TextureHandle h, int level)
+{
+    const TextureImage* image = texture_image(h);
+    if (!image)
+        return NULL;
+    return &image->mips[std::clamp(level, 0, image->levels - 1)];
+}
+
+uint32_t texture_generation()
+{
+    return generation;
+}
+
+int texture_level_count(int w, int h)
+{
+    int levels = 1;
+    while (levels < PACK_MAX_LEVELS && (std::max(w, h) >> levels) > 0)
+        levels++;
+    return levels;
+}
+
+void downsample_texture(const uint32_t* src, int w, int h, uint32_t* dst)
+{
+    int dw = std::max(1, w >> 1), dh = std::max(1, h >> 1);
+    for (int y = 0; y < dh; y++) {
+        const uint32_t* row0 = src + std::min(2 * y, h - 1) * w;
+        const uint32_t* row1 = src + std::min(2 * y + 1, h - 1) * w;
+        for (int x = 0; x < dw; x++) {
+            int x0 = std::min(2 * x, w - 1), x1 = std::min(2 * x + 1, w - 1);
+            uint32_t a = row0[x0], b = row0[x1], c = row1[x0], d = row1[x1];
+            uint32_t out = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                uint32_t sum = ((a >> shift) & 0xff) + ((b >> shift) & 0xff) +
+                               ((c >> shift) & 0xff) + ((d >> shift) & 0xff);
+                out |= ((sum + 2) >> 2) << shift;
+            }
+            dst[y * dw + x] = out;
+        }
+    }
+}
+
+void transpose_texture(const uint32_t* src, int w, int h, uint32_t* dst)
+{
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++)
+            dst[x * h + y] = src[y * w + x];
+    }
+}
+
+static size_t aligned_size(size_t bytes)
+{
+    return (bytes + TEXTURE_ALIGN - 1) & ~(size_t)(TEXTURE_ALIGN - 1);
+}
+
+// Same levels as the packer writes, built behind the decoded image.
+static int build_chain(TextureImage* image, int width, int height)
+{
+    image->levels = texture_level_count(width, height);
+    size_t total = 0;
+    for (int l = 0; l < image->levels; l++) {
+        size_t bytes = aligned_size((size_t)std::max(1, width >> l) * std::max(1, height >> l) * 4);
+        total += (l == 0) ? bytes : 2 * bytes;
+    }
+    image->chain = (uint8_t*)texture_alloc(total);
+    if (!image->chain)
+        return 0;
+
+    uint8_t* next = image->chain;
+    for (int l = 0; l < image->levels; l++) {
+        TextureMip& m = image->mips[l];
+        m.width = std::max(1, width >> l);
+        m.height = std::max(1, height >> l);
+        size_t bytes = aligned_size((size_t)m.width * m.height * 4);
+        if (l == 0) {
+            m.rows = (const uint32_t*)image->pixels;
+        }
+        else {
+            const TextureMip& up = image->mips[l - 1];
+            downsample_texture(up.rows, up.width, up.height, (uint32_t*)next);
+            m.rows = (const uint32_t*)next;
+            next += bytes;
+        }
+        transpose_texture(m.rows, m.width, m.height, (uint32_t*)next);
+        m.columns = (const uint32_t*)next;
+        next += bytes;
+    }
+    return 1;
+}
+
+static SDL_Surface* wrap_pixels(const uint32_t* pixels, int width, int height)
+{
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom((void*)pixels, width, height, 32,
+                                                              width * 4, SDL_PIXELFORMAT_ABGR8888);
+    if (!surface)
+        std::cerr << "err creating surface: " << SDL_GetError() << std::endl;
+    return surface;
+}
+
+int decode_texture(const char* path, TextureImage* out)
+{
+    memset(out, 0, sizeof(*out));
+    int width, height, channels;
+    out->pixels = stbi_load(path, &width, &height, &channels, 4);
+    if (!out->pixels) {
+        // The failure reason is per thread.
+        std::cerr << "err loading: " << path << " " << stbi_failure_reason() << std::endl;
+        return 0;
+    }
+    if (!build_chain(out, width, height)) {
+        std::cerr << "err loading: " << path << " out of memory" << std::endl;
+        free_texture_image(out);
+        return 0;
+    }
+    out->surface = wrap_pixels(out->mips[0].rows, width, height);
+    if (!out->surface) {
+        free_texture_image(out);
+        return 0;
+    }
+    return 1;
+}
+
+void free_texture_image(TextureImage* image)
+{
+    if (image->surface)
+        SDL_FreeSurface(image->surface);
+    texture_free(image->pixels);
+    texture_free(image->chain);
+    memset(image, 0, sizeof(*image));
+}
+
+static void decode_textures(int begin, int end, void* ctx)
+{
+    TextureFile* files = (TextureFile*)ctx;
+    for (int i = begin; i < end; i++) {
+        TextureFile& f = files[i];
+        auto t0 = std::chrono::steady_clock::now();
+        f.ok = decode_texture(f.path, &f.image);
+        f.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    }
+}
+
+static void set_wall_textures()
+{
+    for (int t = 0; t < TEXTURE_TILES; t++)
+        wallTextures[t] = texture_image(wallHandles[t]);
+    generation++;
+}
+
+int load_texture_files()
+{
+    free_textures();
+    auto t0 = std::chrono::steady_clock::now();
+
+    // Each distinct path is decoded once, all of them at the same time.
+    std::vector<TextureFile> work(files.size());
+    for (size_t f = 0; f < files.size(); f++) {
+        memset(&work[f], 0, sizeof(work[f]));
+        work[f].path = files[f].c_str();
+    }
+    parallel_for((int)work.size(), 1, decode_textures, work.data());
+
+    int ok = 1;
+    for (const TextureFile& f : work)
+        ok &= f.ok;
+    for (size_t f = 0; f < work.size(); f++) {
+        if (ok)
+            images[f] = work[f].image;
+        else
+            free_texture_image(&work[f].image);
+    }
+    if (!ok)
+        return 0;
+    set_wall_textures();
+
+    for (const TextureFile& f : work)
+        printf("texture %-12s %4dx%-4d %6.2f ms\n", f.path, f.image.mips[0].width, f.image.mips[0].height, f.ms);
+    printf("textures: %d files for %d textures in %.2f ms on %d threads\n", (int)files.size(), texture_count(),
+           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count(),
+           jobs_thread_count());
+    return 1;
+}
+
+int load_texture_pack()
+{
+    free_textures();
+    auto t0 = std::chrono::steady_clock::now();
+
+    // Nothing to decode: the images only get pointers into the mapping.
+    for (size_t f = 0; f < files.size(); f++) {
+        const PackEntry* e = pack_find(files[f].c_str(), PACK_TEXTURE);
+        if (!e) {
+            std::cerr << "err loading: " << files[f] << " is not in the pack" << std::endl;
+            free_textures();
+            return 0;
+        }
+
+        TextureImage& img = images[f];
+        img.levels = (int)e->levels;
+        for (int l = 0; l < img.levels; l++) {
+            img.mips[l].rows = (const uint32_t*)pack_data(e->rowOffset[l]);
+            img.mips[l].columns = (const uint32_t*)pack_data(e->columnOffset[l]);
+            img.mips[l].width = std::max(1, (int)e->width >> l);
+            img.mips[l].height = std::max(1, (int)e->height >> l);
+        }
+        img.surface = wrap_pixels(img.mips[0].rows, img.mips[0].width, img.mips[0].height);
+        if (!img.surface) {
+            free_textures();
+            return 0;
+        }
+    }
+    set_wall_textures();
+
+    printf("textures: %d files for %d textures mapped from the pack in %.3f ms\n", (int)files.size(), texture_count(),
+           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+    return 1;
+}
+
+int load_textures()
+{
+    if (!load_texture_manifest(TEXTURE_MANIFEST))
+        return 0;
+    if (pack_is_open() && load_texture_pack())
+        return 1;
+    return load_texture_files();
+}
+
+int swap_texture(const char* path, TextureImage* image)
+{
+    size_t f = std::find(files.begin(), files.end(), path) - files.begin();
+    if (f == files.size() || !images[f].surface)
+        return 0;
+    std::swap(images[f], *image);
+    set_wall_textures();
+    return 1;
+}
+
+void free_textures()
+{
+    for (TextureImage& img : images)
+        free_texture_image(&img);
+    set_wall_textures();
+}
@@ -1,9 +1,89 @@
-#ifndef TEXTURES_H
-#define TEXTURES_H
-
-#include "utils.h"
-
-RGBA get_texture_pixel(int tex_id, int x, int y);
-int load_textures();
-
+#ifndef TEXTURES_H
+#define TEXTURES_H
+
+#include <string>
+#include <vector>
+
+#include "pack.h"
+#include "pixel.h"
+
+// Texture pixel buffers start on a cache line boundary.
+constexpr int TEXTURE_ALIGN = 64;
+
+// One mip level, stored both by rows and by columns. Walls are drawn a
+// column at a time and read the column copy, where texels are adjacent.
+struct TextureMip {
+    const Pixel* rows;
+    const Pixel* columns;
+    int width, height;
+};
+
+struct SDL_Surface;
+
+// A surface and its mip chain. Decoded images own their pixels and chain
+// buffers; packed ones leave both null and point into the mapped archive.
+struct TextureImage {
+    SDL_Surface* surface;
+    uint8_t* pixels;
+    uint8_t* chain;
+    int levels;
+    TextureMip mips[PACK_MAX_LEVELS];
+};
+
+typedef int TextureHandle;
+constexpr TextureHandle TEXTURE_NONE = -1;
+constexpr const char* TEXTURE_MANIFEST = "textures.txt";
+// Tile values a wall texture can be assigned to.
+constexpr int TEXTURE_TILES = 256;
+
+// Image each wall tile is drawn with, null for tiles that have none. Set
+// from the manifest's wall lines when the textures load.
+extern const TextureImage* wallTextures[TEXTURE_TILES];
+
+// Reads the texture manifest, from the open pack if it holds a copy.
+// Lines are "texture <name> <file>" and "wall <tile> <name>". Replaces the
+// registry, so earlier handles and images are gone.
+int load_texture_manifest(const char* path);
+int texture_count();
+const char* texture_name(TextureHandle h);
+const char* texture_file(TextureHandle h);
+// Distinct image files in the registry, in manifest order.
+const std::vector<std::string>& texture_files();
+int texture_uses_file(const char* file);
+
+// Handles stay valid until the manifest is loaded again. Callers resolve
+// them once and keep them; TEXTURE_NONE if name is not registered.
+TextureHandle texture_handle(const char* name);
+// Null until the textures are loaded. The image is replaced in place on a
+// reload, so the pointer itself stays good for the same span as handles.
+const TextureImage* texture_image(TextureHandle h);
+// Level 0 is the full image; levels past the last one return the last.
+const TextureMip* texture_mip(TextureHandle h, int level);
+// Changes whenever an image's contents are replaced, for code that keeps
+// data derived from them.
+uint32_t texture_generation();
+
+// Levels down to 1x1, capped at PACK_MAX_LEVELS.
+int texture_level_count(int w, int h);
+// 2x2 box filter into a max(1, w/2) x max(1, h/2) image.
+void downsample_texture(const uint32_t* src, int w, int h, uint32_t* dst);
+void transpose_texture(const uint32_t* src, int w, int h, uint32_t* dst);
+
+// Loads the manifest, then the images from the mapped pack when one is
+// open and from the loose files otherwise.
+int load_textures();
+// Decodes every file in the registry on the job pool. Prints the decode
+// time of each one.
+int load_texture_files();
+int load_texture_pack();
+void free_textures();
+
+// Decodes one file with its mip chain. Touches no shared state, so it can
+// run on any thread.
+int decode_texture(const char* path, TextureImage* out);
+void free_texture_image(TextureImage* image);
+// Replaces the image decoded from path and hands back the old one, for the
+// caller to free. Returns 0 if no texture uses path.
+int swap_texture(const char* path, TextureImage* image);
+
 #endif
\ No newline at end of file